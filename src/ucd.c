@@ -5,6 +5,7 @@
  * @date 2014
  */
 
+#include <float.h>
 #include "ucd_private.h"
 
 
@@ -91,67 +92,880 @@ int ucd_cell_type_number(const char* str)
 }
 
 
+void _ucd_binary_layout(const ucd_context* c, ucd_binary_layout* layout)
+{
+    long offset;
+    int num_rows, num_data, esize, i;
+
+    esize = _ucd_encoding_size(c->encoding);
+
+    offset = sizeof(char) + 6 * sizeof(int); /* header */
+    layout->cells = offset;
+    offset += 4 * c->num_cells * sizeof(int); /* cell information */
+    layout->nlist = offset;
+    offset += c->num_nlist * sizeof(int); /* node list of cells */
+    layout->coords = offset;
+    offset += 3 * c->num_nodes * sizeof(float); /* node coordinates */
+
+    for (i = 0; i < 2; ++i) {
+        num_rows = i == 0 ? c->num_nodes : c->num_cells;
+        num_data = i == 0 ? c->num_ndata : c->num_cdata;
+        layout->header[i] = offset;
+        if (num_data > 0) {
+            offset += 2 * UCD_TEXT_FIELD_SIZE * sizeof(char); /* labels and units */
+            offset += sizeof(int) + num_data * sizeof(int); /* component size */
+        }
+        layout->minmax[i] = offset;
+        offset += 2 * num_data * sizeof(float); /* minimum and maximum */
+        layout->body[i] = offset;
+        offset += (long)num_data * num_rows * esize; /* data body */
+        layout->active[i] = offset;
+        offset += num_data * sizeof(int); /* active list */
+    }
+
+    layout->end = offset;
+}
+
+
 int ucd_binary_filesize(ucd_context* c)
 {
-    int size;
+    ucd_binary_layout layout;
+
+    _ucd_binary_layout(c, &layout);
 
-    size = sizeof(char) + 6 * sizeof(int); /* header */
-    size += 4 * c->num_cells * sizeof(int); /* cell information */
-    size += c->num_nlist * sizeof(int); /* node list of cells */
-    size += 3 * c->num_nodes * sizeof(float); /* node coordinates */
+    return (int)layout.end;
+}
 
-    if (c->num_ndata > 0) {
-        size += 2 * UCD_TEXT_FIELD_SIZE * sizeof(char); /* labels and units */
-        size += sizeof(int) + c->num_ndata * sizeof(int); /* component size */
-        size += 2 * c->num_ndata * sizeof(float); /* minimum and maximum */
-        size += c->num_ndata * c->num_nodes * sizeof(float); /* data body */
-        size += c->num_ndata * sizeof(int); /* active list */
+
+int ucd_simple_alloc(ucd_content* ucd,
+        int num_nodes, int num_cells, int ld_nlist)
+{
+    return _ucd_simple_alloc_ex(ucd, NULL, num_nodes, num_cells, ld_nlist);
+}
+
+
+/* coordinates are gathered through node lists, so they are random */
+int _ucd_simple_alloc_ex(ucd_content* ucd, ucd_context* c,
+        int num_nodes, int num_cells, int ld_nlist)
+{
+    size_t n, m;
+
+    n = num_nodes;
+    m = num_cells;
+    ucd->num_nodes = num_nodes;
+    ucd->num_cells = num_cells;
+    ucd->ld_nlist = ld_nlist;
+    ucd->node_id = _ucd_alloc(c, n * sizeof(*ucd->node_id),
+            UCD_ADVICE_SEQUENTIAL);
+    ucd->node_x = _ucd_alloc(c, n * sizeof(*ucd->node_x), UCD_ADVICE_RANDOM);
+    ucd->node_y = _ucd_alloc(c, n * sizeof(*ucd->node_y), UCD_ADVICE_RANDOM);
+    ucd->node_z = _ucd_alloc(c, n * sizeof(*ucd->node_z), UCD_ADVICE_RANDOM);
+    ucd->cell_id = _ucd_alloc(c, m * sizeof(*ucd->cell_id),
+            UCD_ADVICE_SEQUENTIAL);
+    ucd->cell_mat_id = _ucd_alloc(c, m * sizeof(*ucd->cell_mat_id),
+            UCD_ADVICE_SEQUENTIAL);
+    ucd->cell_type = _ucd_alloc(c, m * sizeof(*ucd->cell_type),
+            UCD_ADVICE_SEQUENTIAL);
+    ucd->cell_nlist = _ucd_alloc(c, ld_nlist * m * sizeof(*ucd->cell_nlist),
+            UCD_ADVICE_SEQUENTIAL);
+    ucd->ndata = NULL;
+    ucd->cdata = NULL;
+
+    if (num_nodes > 0 && (ucd->node_id == NULL || ucd->node_x == NULL
+                || ucd->node_y == NULL || ucd->node_z == NULL)) {
+        fprintf(stderr, "%s: cannot allocate nodes\n", __func__);
+        ucd_simple_free(ucd);
+        return EXIT_FAILURE;
+    }
+    if (num_cells > 0 && (ucd->cell_id == NULL || ucd->cell_mat_id == NULL
+                || ucd->cell_type == NULL || ucd->cell_nlist == NULL)) {
+        fprintf(stderr, "%s: cannot allocate cells\n", __func__);
+        ucd_simple_free(ucd);
+        return EXIT_FAILURE;
     }
+    return EXIT_SUCCESS;
+}
+
+
+void ucd_simple_free(ucd_content* ucd)
+{
+    _ucd_free(ucd->node_id);
+    _ucd_free(ucd->node_x);
+    _ucd_free(ucd->node_y);
+    _ucd_free(ucd->node_z);
+    _ucd_free(ucd->cell_id);
+    _ucd_free(ucd->cell_mat_id);
+    _ucd_free(ucd->cell_type);
+    _ucd_free(ucd->cell_nlist);
+
+    ucd_data_free(ucd->ndata);
+    ucd_data_free(ucd->cdata);
+}
+
+
+ucd_data* ucd_data_alloc(int num_rows, int num_data)
+{
+    return _ucd_data_alloc_ex(NULL, num_rows, num_data);
+}
+
+
+ucd_data* _ucd_data_alloc_ex(ucd_context* c, int num_rows, int num_data)
+{
+    ucd_data* d;
+    size_t n;
 
-    if (c->num_cdata > 0) {
-        size += 2 * UCD_TEXT_FIELD_SIZE * sizeof(char);
-        size += sizeof(int) + c->num_cdata * sizeof(int);
-        size += 2 * c->num_cdata * sizeof(float);
-        size += c->num_cdata * c->num_cells * sizeof(float);
-        size += c->num_cdata * sizeof(int);
+    d = malloc(sizeof(*d));
+    if (d == NULL) {
+        fprintf(stderr, "%s: cannot allocate data\n", __func__);
+        return NULL;
     }
+    memset(d, 0, sizeof(*d));
+
+    d->num_rows = num_rows;
+    d->num_data = num_data;
+    d->components = malloc(num_data * sizeof(*d->components));
+    d->minima = malloc(num_data * sizeof(*d->minima));
+    d->maxima = malloc(num_data * sizeof(*d->maxima));
+    n = num_rows;
+    d->row_id = _ucd_alloc(c, n * sizeof(*d->row_id), UCD_ADVICE_SEQUENTIAL);
+    d->data = _ucd_alloc(c, n * num_data * sizeof(*d->data),
+            UCD_ADVICE_SEQUENTIAL);
 
-    return size;
+    if (d->components == NULL || d->minima == NULL || d->maxima == NULL
+            || (num_rows > 0 && (d->row_id == NULL || d->data == NULL))) {
+        fprintf(stderr, "%s: cannot allocate data\n", __func__);
+        ucd_data_free(d);
+        return NULL;
+    }
+    return d;
 }
 
 
-void ucd_simple_free(ucd_content* ucd)
+void ucd_data_free(ucd_data* d)
+{
+    if (d == NULL)
+        return;
+
+    free(d->components);
+    free(d->minima);
+    free(d->maxima);
+    _ucd_free(d->row_id);
+    _ucd_free(d->data);
+    free(d);
+}
+
+
+void ucd_data_update_minmax(ucd_data* d)
+{
+    int j;
+
+    for (j = 0; j < d->num_data; ++j) {
+        _ucd_data_column_minmax(d, j, &d->minima[j], &d->maxima[j]);
+    }
+}
+
+
+void _ucd_data_column_minmax(const ucd_data* d, int col,
+        float* minimum, float* maximum)
+{
+    int ld, i;
+    const float* p;
+    float lo, hi;
+
+    p = ucd_data_column(d, col, &ld);
+    lo = +FLT_MAX;
+    hi = -FLT_MAX;
+    for (i = 0; i < d->num_rows; ++i) {
+        if (p[ld * i] < lo) {
+            lo = p[ld * i];
+        }
+        if (p[ld * i] > hi) {
+            hi = p[ld * i];
+        }
+    }
+    *minimum = lo;
+    *maximum = hi;
+}
+
+
+void ucd_data_copy_header(ucd_data* dst, const ucd_data* src)
 {
-    free(ucd->node_id);
-    free(ucd->node_x);
-    free(ucd->node_y);
-    free(ucd->node_z);
-    free(ucd->cell_id);
-    free(ucd->cell_mat_id);
-    free(ucd->cell_type);
-    free(ucd->cell_nlist);
+    dst->num_comp = src->num_comp;
+    memcpy(dst->components, src->components,
+            src->num_data * sizeof(*src->components));
+    memcpy(dst->labels, src->labels, sizeof(dst->labels));
+    memcpy(dst->units, src->units, sizeof(dst->units));
+}
+
 
-    if (ucd->ndata != NULL) {
-        free(ucd->ndata->components);
-        free(ucd->ndata->minima);
-        free(ucd->ndata->maxima);
-        free(ucd->ndata->row_id);
-        free(ucd->ndata->data);
-        free(ucd->ndata);
+float* ucd_data_component(const ucd_data* d, int comp, int* ld)
+{
+    int base, i;
+
+    base = 0;
+    for (i = 0; i < comp; ++i) {
+        base += d->components[i];
     }
 
-    if (ucd->cdata != NULL) {
-        free(ucd->cdata->components);
-        free(ucd->cdata->minima);
-        free(ucd->cdata->maxima);
-        free(ucd->cdata->row_id);
-        free(ucd->cdata->data);
-        free(ucd->cdata);
+    if (d->layout == UCD_LAYOUT_COMPONENT) {
+        *ld = d->components[comp];
+        return &d->data[d->num_rows * base];
+    } else {
+        *ld = d->num_data;
+        return &d->data[base];
     }
 }
 
 
+float* ucd_data_column(const ucd_data* d, int col, int* ld)
+{
+    int base, i;
+
+    if (d->layout != UCD_LAYOUT_COMPONENT) {
+        *ld = d->num_data;
+        return &d->data[col];
+    }
+
+    base = 0;
+    for (i = 0; i < d->num_comp && base + d->components[i] <= col; ++i) {
+        base += d->components[i];
+    }
+    *ld = d->components[i];
+    return &d->data[d->num_rows * base + col - base];
+}
+
+
+int ucd_data_find_component(const ucd_data* d, const char* label)
+{
+    const char* anchor;
+    int i;
+
+    anchor = d->labels;
+    for (i = 0; i < d->num_comp; ++i) {
+        if (strcmp(anchor, label) == 0) {
+            return i;
+        }
+        anchor += strlen(anchor) + 1;
+    }
+    return -1;
+}
+
+
+static int _ucd_text_length(const char* text, int count)
+{
+    const char* anchor;
+    int i;
+
+    anchor = text;
+    for (i = 0; i < count; ++i) {
+        anchor += strlen(anchor) + 1;
+    }
+    return (int)(anchor - text);
+}
+
+
+float* ucd_data_append_component(ucd_data* d, int size,
+        const char* label, const char* unit, int* ld)
+{
+    ucd_data src;
+    int len_l, len_u, num_data, i;
+    void* p[3];
+
+    len_l = _ucd_text_length(d->labels, d->num_comp);
+    len_u = _ucd_text_length(d->units, d->num_comp);
+    if (len_l + (int)strlen(label) + 1 >= UCD_TEXT_FIELD_SIZE
+            || len_u + (int)strlen(unit) + 1 >= UCD_TEXT_FIELD_SIZE) {
+        fprintf(stderr, "%s: too long labels or units\n", __func__);
+        return NULL;
+    }
+
+    num_data = d->num_data + size;
+    p[0] = realloc(d->components, num_data * sizeof(*d->components));
+    p[1] = realloc(d->minima, num_data * sizeof(*d->minima));
+    p[2] = realloc(d->maxima, num_data * sizeof(*d->maxima));
+    if (p[0] != NULL) d->components = p[0];
+    if (p[1] != NULL) d->minima = p[1];
+    if (p[2] != NULL) d->maxima = p[2];
+    if (p[0] == NULL || p[1] == NULL || p[2] == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return NULL;
+    }
+
+    if (d->layout == UCD_LAYOUT_COMPONENT) {
+        /* a new block at the end */
+        p[0] = _ucd_realloc(d->data,
+                (size_t)d->num_rows * d->num_data * sizeof(*d->data),
+                (size_t)d->num_rows * num_data * sizeof(*d->data));
+        if (p[0] == NULL && d->num_rows > 0) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return NULL;
+        }
+        d->data = p[0];
+    } else {
+        /* widen each row */
+        src = *d;
+        d->data = _ucd_alloc_like(src.data,
+                (size_t)d->num_rows * num_data * sizeof(*d->data));
+        if (d->data == NULL && d->num_rows > 0) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            d->data = src.data;
+            return NULL;
+        }
+        d->num_data = num_data;
+        for (i = 0; i < d->num_rows; ++i) {
+            _ucd_data_copy_row(d, i, &src, i);
+        }
+        _ucd_free(src.data);
+    }
+
+    strcpy(&d->labels[len_l], label);
+    strcpy(&d->units[len_u], unit);
+    d->components[d->num_comp] = size;
+    d->num_comp += 1;
+    d->num_data = num_data;
+
+    return ucd_data_component(d, d->num_comp - 1, ld);
+}
+
+
+int ucd_data_append(ucd_data* d, const ucd_data* src)
+{
+    const char *label, *unit;
+    const float* from;
+    float* to;
+    int ld_from, ld, base, i, j, k;
+
+    if (d->num_rows != src->num_rows) {
+        fprintf(stderr, "%s: numbers of rows are different\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    label = src->labels;
+    unit = src->units;
+    base = 0;
+    for (k = 0; k < src->num_comp; ++k) {
+        to = ucd_data_append_component(d, src->components[k],
+                label, unit, &ld);
+        if (to == NULL) {
+            return EXIT_FAILURE;
+        }
+        from = ucd_data_component(src, k, &ld_from);
+        for (i = 0; i < d->num_rows; ++i) {
+            for (j = 0; j < src->components[k]; ++j) {
+                to[ld * i + j] = from[ld_from * i + j];
+            }
+        }
+        for (j = 0; j < src->components[k]; ++j) {
+            d->minima[d->num_data - src->components[k] + j]
+                = src->minima[base + j];
+            d->maxima[d->num_data - src->components[k] + j]
+                = src->maxima[base + j];
+        }
+        base += src->components[k];
+        label += strlen(label) + 1;
+        unit += strlen(unit) + 1;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_data_set_layout(ucd_data* d, int layout)
+{
+    ucd_data src;
+    float* data;
+    int i;
+
+    if (layout != UCD_LAYOUT_ROW && layout != UCD_LAYOUT_COMPONENT) {
+        fprintf(stderr, "%s: layout %d is invalid\n", __func__, layout);
+        return EXIT_FAILURE;
+    }
+    if ((d->layout == UCD_LAYOUT_COMPONENT)
+            == (layout == UCD_LAYOUT_COMPONENT)) {
+        d->layout = layout;
+        return EXIT_SUCCESS;
+    }
+
+    data = _ucd_alloc_like(d->data,
+            (size_t)d->num_rows * d->num_data * sizeof(*data));
+    if (data == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    src = *d;
+    d->layout = layout;
+    d->data = data;
+    for (i = 0; i < d->num_rows; ++i) {
+        _ucd_data_copy_row(d, i, &src, i);
+    }
+    _ucd_free(src.data);
+
+    return EXIT_SUCCESS;
+}
+
+
+void _ucd_data_copy_row(ucd_data* dst, int dst_row,
+        const ucd_data* src, int src_row)
+{
+    int ld_dst, ld_src, i;
+    float *p_dst, *p_src;
+
+    if (dst->layout != UCD_LAYOUT_COMPONENT
+            && src->layout != UCD_LAYOUT_COMPONENT) {
+        memcpy(&dst->data[dst->num_data * dst_row],
+                &src->data[src->num_data * src_row],
+                src->num_data * sizeof(*src->data));
+        return;
+    }
+
+    for (i = 0; i < src->num_comp; ++i) {
+        p_dst = ucd_data_component(dst, i, &ld_dst);
+        p_src = ucd_data_component(src, i, &ld_src);
+        memcpy(&p_dst[ld_dst * dst_row], &p_src[ld_src * src_row],
+                src->components[i] * sizeof(*src->data));
+    }
+}
+
+
+static int _ucd_compare_node_id(const void* a, const void* b)
+{
+    int ka = *(const int*)a;
+    int kb = *(const int*)b;
+    return (ka > kb) - (ka < kb);
+}
+
+
+int _ucd_node_index_build(ucd_node_index* index, const ucd_content* ucd)
+{
+    int max_id, i;
+
+    index->min_id = 0;
+    index->num_ids = 0;
+    index->num_nodes = ucd->num_nodes;
+    index->table = NULL;
+    if (ucd->num_nodes == 0) {
+        index->table = malloc(sizeof(int));
+        return index->table == NULL;
+    }
+
+    index->min_id = max_id = ucd->node_id[0];
+    for (i = 1; i < ucd->num_nodes; ++i) {
+        if (ucd->node_id[i] < index->min_id) {
+            index->min_id = ucd->node_id[i];
+        }
+        if (ucd->node_id[i] > max_id) {
+            max_id = ucd->node_id[i];
+        }
+    }
+
+    if ((double)max_id - index->min_id < 2.0 * ucd->num_nodes) {
+        index->num_ids = max_id - index->min_id + 1;
+        index->table = malloc(index->num_ids * sizeof(int));
+        if (index->table == NULL) {
+            fprintf(stderr, "%s: cannot allocate node index\n", __func__);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < index->num_ids; ++i) {
+            index->table[i] = -1;
+        }
+        for (i = 0; i < ucd->num_nodes; ++i) {
+            index->table[ucd->node_id[i] - index->min_id] = i;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    /* pairs of ID and index sorted by IDs */
+    index->table = malloc(2 * (size_t)ucd->num_nodes * sizeof(int));
+    if (index->table == NULL) {
+        fprintf(stderr, "%s: cannot allocate node index\n", __func__);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        index->table[2 * i] = ucd->node_id[i];
+        index->table[2 * i + 1] = i;
+    }
+    qsort(index->table, ucd->num_nodes, 2 * sizeof(int),
+            _ucd_compare_node_id);
+    return EXIT_SUCCESS;
+}
+
+
+void _ucd_node_index_free(ucd_node_index* index)
+{
+    free(index->table);
+    index->table = NULL;
+}
+
+
+int _ucd_node_find(const ucd_node_index* index, int id)
+{
+    const int* found;
+    int k;
+
+    if (index->num_ids > 0) {
+        k = id - index->min_id;
+        return k >= 0 && k < index->num_ids ? index->table[k] : -1;
+    }
+    found = bsearch(&id, index->table, index->num_nodes, 2 * sizeof(int),
+            _ucd_compare_node_id);
+    return found != NULL ? found[1] : -1;
+}
+
+
+void ucd_options_init(ucd_options* o)
+{
+    memset(o, 0, sizeof(*o));
+    o->encoding = UCD_ENCODING_FLOAT32;
+    o->layout = UCD_LAYOUT_ROW;
+    o->progress = NULL;
+    o->progress_arg = NULL;
+}
+
+
+void _ucd_context_open(ucd_context* c, const ucd_options* o)
+{
+    ucd_options defaults;
+
+    if (o == NULL) {
+        ucd_options_init(&defaults);
+        o = &defaults;
+    }
+    c->encoding = o->encoding;
+    c->layout = o->layout == UCD_LAYOUT_COMPONENT
+        ? UCD_LAYOUT_COMPONENT : UCD_LAYOUT_ROW;
+    c->chunk_rows = o->chunk_rows;
+    c->checksum = o->checksum;
+    c->memory_budget = o->memory_budget;
+    c->progress = o->progress;
+    c->progress_arg = o->progress_arg;
+
+    c->_fp = NULL;
+    c->_minima = NULL;
+    c->_maxima = NULL;
+    c->_rows = NULL;
+    c->_is_writer = 0;
+    c->_allocated = 0;
+    c->_owner = NULL;
+    c->_crc_log = NULL;
+    _ucd_progress_reset(c);
+}
+
+
+int _ucd_has_progress(const ucd_context* c)
+{
+    if (c->_owner != NULL) {
+        c = c->_owner;
+    }
+    return c->progress != NULL;
+}
+
+
+void _ucd_progress_reset(ucd_context* c)
+{
+    c->_progress_bytes = 0;
+    c->_progress_rows = 0;
+    c->_cancelled = 0;
+}
+
+
+int _ucd_progress(ucd_context* c, long bytes, long rows)
+{
+    int cancelled;
+
+    if (c->_owner != NULL) {
+        c = c->_owner;
+    }
+    if (c->progress == NULL) {
+        return c->_cancelled;
+    }
+#ifdef _OPENMP
+#pragma omp critical(_ucd_progress)
+#endif
+    {
+        if (!c->_cancelled) {
+            c->_progress_bytes += bytes;
+            c->_progress_rows += rows;
+            c->_cancelled = c->progress(c->progress_arg,
+                    c->_progress_bytes, c->_progress_rows) != 0;
+        }
+        cancelled = c->_cancelled;
+    }
+    return cancelled;
+}
+
+
+int _ucd_progress_rows(ucd_context* c, long* pos, long done, long total,
+        int columns)
+{
+    long last, rows;
+
+    if ((done % UCD_PROGRESS_ROWS != 0 && done != total)
+            || !_ucd_has_progress(c)) {
+        return EXIT_SUCCESS;
+    }
+    rows = done % UCD_PROGRESS_ROWS != 0 ? done % UCD_PROGRESS_ROWS
+        : UCD_PROGRESS_ROWS;
+    last = *pos;
+    *pos = ftell(c->_fp);
+    return _ucd_progress(c, *pos - last, rows * columns);
+}
+
+
+int _ucd_progress_fread(ucd_context* c, void* data,
+        size_t row_size, long num_rows, int columns)
+{
+    char* p;
+    long n;
+
+    if (!_ucd_has_progress(c)) {
+        _ucd_checksum_fread(c, data, row_size, num_rows);
+        return EXIT_SUCCESS;
+    }
+    p = data;
+    for (; num_rows > 0; num_rows -= n, p += n * row_size) {
+        n = num_rows < UCD_PROGRESS_ROWS ? num_rows : UCD_PROGRESS_ROWS;
+        _ucd_checksum_fread(c, p, row_size, n);
+        if (_ucd_progress(c, (long)(n * row_size), n * columns)) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int _ucd_progress_fwrite(ucd_context* c, const void* data,
+        size_t row_size, long num_rows, int columns)
+{
+    const char* p;
+    long n;
+
+    if (!_ucd_has_progress(c)) {
+        if (_ucd_checksum_fwrite(c, data, row_size, num_rows)
+                != (size_t)num_rows) {
+            fprintf(stderr, "%s: cannot write\n", __func__);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    p = data;
+    for (; num_rows > 0; num_rows -= n, p += n * row_size) {
+        n = num_rows < UCD_PROGRESS_ROWS ? num_rows : UCD_PROGRESS_ROWS;
+        if (_ucd_checksum_fwrite(c, p, row_size, n) != (size_t)n) {
+            fprintf(stderr, "%s: cannot write\n", __func__);
+            return EXIT_FAILURE;
+        }
+        if (_ucd_progress(c, (long)(n * row_size), n * columns)) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
 int ucd_close(ucd_context* c)
 {
-    return fclose(c->_fp);
+    int has_error;
+
+    has_error = EXIT_SUCCESS;
+    if (c->_is_writer && c->is_binary && c->checksum) {
+        has_error = _ucd_checksum_write(c);
+    }
+
+    _ucd_checksum_untrack(c);
+
+    free(c->_minima);
+    free(c->_maxima);
+    c->_minima = NULL;
+    c->_maxima = NULL;
+    _ucd_rows_free(c);
+
+    return fclose(c->_fp) || has_error;
+}
+
+
+int _ucd_encoding_size(int encoding)
+{
+    switch (encoding) {
+    case UCD_ENCODING_FLOAT16:
+    case UCD_ENCODING_UINT16:
+        return 2;
+    case UCD_ENCODING_UINT8:
+        return 1;
+    default:
+        return (int)sizeof(float);
+    }
+}
+
+
+static unsigned short _ucd_float_to_half(float value)
+{
+    union {
+        float f;
+        unsigned int u;
+    } v;
+    unsigned int sign, exp, mant, h, shift, rem;
+
+    v.f = value;
+    sign = (v.u >> 16) & 0x8000u;
+    exp = (v.u >> 23) & 0xffu;
+    mant = v.u & 0x7fffffu;
+
+    if (exp == 0xffu) {
+        /* infinity or NaN */
+        return (unsigned short)(sign | 0x7c00u | (mant != 0 ? 0x200u : 0));
+    }
+    if (exp > 142) {
+        /* overflow */
+        return (unsigned short)(sign | 0x7c00u);
+    }
+    if (exp < 113) {
+        /* subnormal or underflow */
+        if (exp < 103) {
+            return (unsigned short)sign;
+        }
+        mant |= 0x800000u;
+        shift = 126 - exp;
+        h = mant >> shift;
+        rem = mant & ((1u << shift) - 1);
+        if (rem > (1u << (shift - 1)) || (rem == (1u << (shift - 1)) && (h & 1))) {
+            ++h;
+        }
+        return (unsigned short)(sign | h);
+    }
+
+    /* round to nearest even (a carry may make it infinity) */
+    h = ((exp - 112) << 10) | (mant >> 13);
+    rem = mant & 0x1fffu;
+    if (rem > 0x1000u || (rem == 0x1000u && (h & 1))) {
+        ++h;
+    }
+    return (unsigned short)(sign | h);
+}
+
+
+static float _ucd_half_to_float(unsigned short half)
+{
+    union {
+        float f;
+        unsigned int u;
+    } v;
+    unsigned int sign, exp, mant;
+
+    sign = (unsigned int)(half & 0x8000u) << 16;
+    exp = (half >> 10) & 0x1fu;
+    mant = half & 0x3ffu;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            v.u = sign;
+        } else {
+            /* subnormal */
+            exp = 113;
+            while (!(mant & 0x400u)) {
+                mant <<= 1;
+                --exp;
+            }
+            v.u = sign | (exp << 23) | ((mant & 0x3ffu) << 13);
+        }
+    } else if (exp == 31) {
+        v.u = sign | 0x7f800000u | (mant << 13);
+    } else {
+        v.u = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    return v.f;
+}
+
+
+int _ucd_range_is_finite(float minimum, float maximum)
+{
+    double width;
+
+    /* the difference of floats is exact in double */
+    width = (double)maximum - minimum;
+    return width >= 0 && width <= FLT_MAX;
+}
+
+
+void _ucd_encode(int encoding, const float* src, int ld_src,
+        int num_rows, int num_cols,
+        const float* minima, const float* maxima, void* dst)
+{
+    unsigned short* d16 = dst;
+    unsigned char* d8 = dst;
+    float* d32 = dst;
+    float scale, v;
+    int i, j;
+
+    for (j = 0; j < num_cols; ++j) {
+        switch (encoding) {
+        case UCD_ENCODING_FLOAT16:
+            for (i = 0; i < num_rows; ++i) {
+                d16[num_cols * i + j] = _ucd_float_to_half(src[ld_src * i + j]);
+            }
+            break;
+        case UCD_ENCODING_UINT16:
+            scale = maxima[j] > minima[j]
+                ? 65535.0f / (maxima[j] - minima[j]) : 0.0f;
+            for (i = 0; i < num_rows; ++i) {
+                v = (src[ld_src * i + j] - minima[j]) * scale + 0.5f;
+                v = !(v > 0.0f) ? 0.0f : v > 65535.0f ? 65535.0f : v;
+                d16[num_cols * i + j] = (unsigned short)v;
+            }
+            break;
+        case UCD_ENCODING_UINT8:
+            scale = maxima[j] > minima[j]
+                ? 255.0f / (maxima[j] - minima[j]) : 0.0f;
+            for (i = 0; i < num_rows; ++i) {
+                v = (src[ld_src * i + j] - minima[j]) * scale + 0.5f;
+                v = !(v > 0.0f) ? 0.0f : v > 255.0f ? 255.0f : v;
+                d8[num_cols * i + j] = (unsigned char)v;
+            }
+            break;
+        default:
+            for (i = 0; i < num_rows; ++i) {
+                d32[num_cols * i + j] = src[ld_src * i + j];
+            }
+            break;
+        }
+    }
+}
+
+
+void _ucd_decode(int encoding, const void* src,
+        int num_rows, int num_cols,
+        const float* minima, const float* maxima, float* dst, int ld_dst)
+{
+    const unsigned short* s16 = src;
+    const unsigned char* s8 = src;
+    const float* s32 = src;
+    float scale;
+    int i, j;
+
+    for (j = 0; j < num_cols; ++j) {
+        switch (encoding) {
+        case UCD_ENCODING_FLOAT16:
+            for (i = 0; i < num_rows; ++i) {
+                dst[ld_dst * i + j] = _ucd_half_to_float(s16[num_cols * i + j]);
+            }
+            break;
+        case UCD_ENCODING_UINT16:
+            scale = (maxima[j] - minima[j]) / 65535.0f;
+            for (i = 0; i < num_rows; ++i) {
+                dst[ld_dst * i + j] = minima[j] + s16[num_cols * i + j] * scale;
+            }
+            break;
+        case UCD_ENCODING_UINT8:
+            scale = (maxima[j] - minima[j]) / 255.0f;
+            for (i = 0; i < num_rows; ++i) {
+                dst[ld_dst * i + j] = minima[j] + s8[num_cols * i + j] * scale;
+            }
+            break;
+        default:
+            for (i = 0; i < num_rows; ++i) {
+                dst[ld_dst * i + j] = s32[num_cols * i + j];
+            }
+            break;
+        }
+    }
 }
@@ -18,12 +18,148 @@
 #pragma warning(pop)
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @name Data encodings
+ * Encodings of node and cell data in binary format.  Except for
+ * #UCD_ENCODING_FLOAT32, they are an extension of the UCD binary format
+ * which other applications cannot read.  Quantized data are stored as
+ * integers mapped linearly from minimum to maximum of each data, so data
+ * with infinity, or with a range wider than the largest float, are
+ * rejected.
+ * @{
+ */
+#define UCD_ENCODING_FLOAT32 0 /**< 32-bit float (classic format) */
+#define UCD_ENCODING_FLOAT16 1 /**< 16-bit half precision float */
+#define UCD_ENCODING_UINT16  2 /**< 16-bit quantized integer */
+#define UCD_ENCODING_UINT8   3 /**< 8-bit quantized integer */
+/** @} */
+
+/**
+ * @name Data layouts
+ * Layouts of ucd_data#data.
+ * @{
+ */
+/** Rows are contiguous, i.e. (i, j) is at [i * num_data + j]. */
+#define UCD_LAYOUT_ROW       0
+/**
+ * Components are contiguous as the binary format stores them.
+ * Each component occupies #ucd_data::num_rows times its size, and
+ * (i, j) of a component is at [i * size + j] in the block.
+ */
+#define UCD_LAYOUT_COMPONENT 1
+/** @} */
+
+/**
+ * @name Chunked sections
+ * Sections of the chunked container for ucd_read_chunk_map().
+ * @{
+ */
+#define UCD_CHUNK_COORDS     0 /**< x, y and z of nodes */
+#define UCD_CHUNK_NDATA      1 /**< node data */
+#define UCD_CHUNK_CDATA      2 /**< cell data */
+/** @} */
+
+/**
+ * @name Averaging weights
+ * Weights of cells for ucd_cell_to_node().
+ * @{
+ */
+#define UCD_AVERAGE_COUNT    0 /**< cells are weighted equally */
+#define UCD_AVERAGE_MEASURE  1 /**< volume, area or length of cells */
+/** @} */
+
+/**
+ * @name Predicate targets
+ * Targets of ucd_predicate#target.
+ * @{
+ */
+#define UCD_PREDICATE_NDATA     0 /**< a column of node data */
+#define UCD_PREDICATE_CDATA     1 /**< a column of cell data */
+#define UCD_PREDICATE_MAT_ID    2 /**< material ID of cells */
+#define UCD_PREDICATE_CELL_TYPE 3 /**< cell type number */
+#define UCD_PREDICATE_X         4 /**< x coordinate of nodes */
+#define UCD_PREDICATE_Y         5 /**< y coordinate of nodes */
+#define UCD_PREDICATE_Z         6 /**< z coordinate of nodes */
+/** @} */
+
+/**
+ * @struct ucd_options
+ * @brief Options of extensions for reading and writing files.
+ *
+ * It should be initialized by ucd_options_init(), which sets the classic
+ * format (32-bit float, row layout, no chunks, no checksums and no
+ * budget), and be passed to ucd_reader_open_ex() or ucd_writer_open_ex().
+ * Functions without options use the defaults, so contexts of them need
+ * no initialization.
+ */
+typedef struct {
+    /**
+     * Encoding of node and cell data to write in binary format.
+     * It is one of UCD_ENCODING_* values.
+     */
+    int encoding;
+
+    /**
+     * Layout of data made by ucd_simple_reader_ex().
+     * It is one of UCD_LAYOUT_* values.
+     */
+    int layout;
+
+    /**
+     * The number of rows per chunk of the chunked container.
+     *
+     * If it is positive, a binary file is written in the chunked
+     * container, where coordinates and each column of data are split into
+     * chunks with their minima and maxima.  Other applications cannot read
+     * it.
+     */
+    int chunk_rows;
+
+    /**
+     * If it is not zero when writing, a trailer of CRC32C of sections is
+     * appended in ucd_close(), which other applications ignore.
+     */
+    int checksum;
+
+    /**
+     * The budget in bytes of arrays allocated by ucd_simple_reader_ex().
+     *
+     * If it is not zero, arrays beyond the budget are placed in mappings
+     * of temporary files in @c TMPDIR, which are paged to the disk with
+     * hints of sequential or random access.  Arrays are taken into the
+     * budget in the order of nodes, cells, node data and cell data.
+     * Mappings are not available on Windows.  ucd_lazy_open() reads
+     * arrays from the source file on demand instead.
+     */
+    size_t memory_budget;
+
+    /**
+     * A callback of progress, or NULL.
+     *
+     * It is called after each block of rows read or written through the
+     * context with @c progress_arg, and bytes and rows processed so far.
+     * Rows of cells, each axis of coordinates and each column of data are
+     * counted.  If it returns nonzero, the operation is cancelled:
+     * ucd_simple_reader_ex() frees the content and ucd_simple_writer_ex()
+     * removes the file.  It may be called by other threads than the
+     * caller, but never at the same time.
+     */
+    int (*progress)(void* arg, long bytes, long rows);
+
+    /** The first argument of #progress. */
+    void* progress_arg;
+} ucd_options;
+
 /**
  * @struct ucd_context
  * @brief ...
  *
  */
-typedef struct {
+typedef struct ucd_context {
     /**
      * An indicator which represents the UCD file format.
      *
@@ -51,11 +187,80 @@ typedef struct {
      */
     int num_nlist;
 
+    /**
+     * Encoding of node and cell data in binary format.
+     *
+     * It is one of UCD_ENCODING_* values.  It is set from ucd_options in
+     * ucd_writer_open_ex(), and overwritten by the file in
+     * ucd_reader_open_ex().
+     */
+    int encoding;
+
+    /** @private */
+    int layout;
+
+    /**
+     * The number of rows per chunk, or zero if it is not the chunked
+     * container.  It is set as #encoding.
+     */
+    int chunk_rows;
+
+    /**
+     * An indicator of checksums of sections in binary format.  It is set
+     * as #encoding, where a file has checksums if it has the trailer.
+     */
+    int checksum;
+
+    /** @private */
+    size_t memory_budget;
+
+    /** @private */
+    int (*progress)(void* arg, long bytes, long rows);
+
+    /** @private */
+    void* progress_arg;
+
     /** @private */
     FILE* _fp;
 
     /** @private */
     int _nc;
+
+    /** @private */
+    int _col;
+
+    /** @private */
+    int _row;
+
+    /** @private */
+    float* _minima;
+
+    /** @private */
+    float* _maxima;
+
+    /** @private */
+    struct ucd_rows_buffer* _rows;
+
+    /** @private */
+    int _is_writer;
+
+    /** @private */
+    size_t _allocated;
+
+    /** @private */
+    long _progress_bytes;
+
+    /** @private */
+    long _progress_rows;
+
+    /** @private */
+    int _cancelled;
+
+    /** @private */
+    struct ucd_context* _owner;
+
+    /** @private */
+    struct ucd_crc_log* _crc_log;
 } ucd_context;
 
 
@@ -106,11 +311,19 @@ typedef struct {
      */
     int* row_id;
 
+    /**
+     * Layout of #data.
+     * It is one of UCD_LAYOUT_* values.  Other values are taken as
+     * #UCD_LAYOUT_ROW, so data made without ucd_data_alloc() are in rows.
+     */
+    int layout;
+
     /**
      * A data array.
-     * It is column-major matrix which the size is #num_rows (as row)
-     * times #num_data (as column).  If you access to (i, j) components,
-     * please describe [i * num_data + j].
+     * It is a matrix which the size is #num_rows (as row) times #num_data
+     * (as column).  If #layout is #UCD_LAYOUT_ROW and you access to (i, j)
+     * components, please describe [i * num_data + j].  Otherwise use
+     * ucd_data_component() or ucd_data_column().
      * */
     float* data;
 } ucd_data;
@@ -187,6 +400,313 @@ typedef struct {
     ucd_data* cdata;
 } ucd_content;
 
+/**
+ * @struct ucd_merger
+ * @brief A state to merge contents with deduplication of coincident nodes.
+ *
+ */
+typedef struct {
+    /** A pointer to merged content. */
+    ucd_content* ucd;
+
+    /** Nodes within the distance are merged into one. */
+    float tolerance;
+
+    /** @private */
+    int _max_nodes;
+
+    /** @private */
+    int _max_cells;
+
+    /** @private */
+    int _num_buckets;
+
+    /** @private */
+    int* _bucket;
+
+    /** @private */
+    int* _next;
+} ucd_merger;
+
+/**
+ * @struct ucd_cursor
+ * @brief An independent reader of a binary file.
+ *
+ * Cursors share a context opened by ucd_reader_open() only to know the
+ * numbers, and each has its own file handle and components of node and
+ * cell data read at open.  So threads with their own cursors can read any
+ * part of the file at the same time.
+ */
+typedef struct {
+    /** A pointer to the shared context, which is not modified. */
+    const ucd_context* context;
+
+    /** @private */
+    FILE* _fp;
+
+    /** @private */
+    int _num_comp[2];
+
+    /** @private */
+    int* _components[2];
+
+    /** @private */
+    struct ucd_crc_log* _crc_log;
+} ucd_cursor;
+
+/**
+ * @struct ucd_lazy
+ * @brief A content of which arrays are read from a file on first access.
+ *
+ * Only numbers and headers of data are read when it is opened, and nodes,
+ * cells and components of data are read when they are requested.  Parts
+ * which are not requested are never read.  It is not thread-safe.
+ */
+typedef struct {
+    /**
+     * The content.  Arrays of nodes and cells are NULL until
+     * ucd_lazy_nodes() and ucd_lazy_cells().  Data of components which are
+     * not loaded by ucd_lazy_component() are undefined.
+     */
+    ucd_content ucd;
+
+    /** The context which tells the format of the file. */
+    ucd_context context;
+
+    /** @private */
+    ucd_cursor _cursor;
+
+    /** @private */
+    int _loaded;
+
+    /** @private */
+    char* _components;
+} ucd_lazy;
+
+/**
+ * @struct ucd_chunk
+ * @brief A chunk of a column in the chunked container.
+ */
+typedef struct {
+    /** The first row of the chunk. */
+    int first_row;
+
+    /** The number of rows of the chunk. */
+    int num_rows;
+
+    /** Encoding of values.  It is one of UCD_ENCODING_* values. */
+    int codec;
+
+    /**
+     * Size in bytes of encoded values.
+     * It is zero if all values are the same as #minimum.
+     */
+    int size;
+
+    /** Minimum value of the chunk other than NaN. */
+    float minimum;
+
+    /** Maximum value of the chunk other than NaN. */
+    float maximum;
+
+    /** Offset in bytes of values from the beginning of the file. */
+    long offset;
+
+    /** Nonzero if some values are NaN, which are out of the range. */
+    int has_nan;
+} ucd_chunk;
+
+/**
+ * @struct ucd_predicate
+ * @brief A range condition to select cells.
+ *
+ * Predicates on nodes (node data and coordinates) select cells by any or
+ * all of their nodes.
+ */
+typedef struct {
+    /** One of UCD_PREDICATE_* values. */
+    int target;
+
+    /** Label of a component of node or cell data. */
+    const char* label;
+
+    /** Column (0-based) in the component of node or cell data. */
+    int column;
+
+    /** Lower bound of values (inclusive). */
+    float lower;
+
+    /** Upper bound of values (inclusive). */
+    float upper;
+} ucd_predicate;
+
+/**
+ * @struct ucd_adjacency
+ * @brief Adjacency of nodes and cells in compressed sparse rows.
+ *
+ * Nodes and cells are referred by indices (0-based) of arrays of
+ * #ucd_content, not by IDs.
+ */
+typedef struct {
+    /** The number of nodes. */
+    int num_nodes;
+
+    /** The number of cells. */
+    int num_cells;
+
+    /**
+     * Offsets of cells of nodes.
+     * Cells of node @c i are from <tt>node_cells[node_offset[i]]</tt> to
+     * <tt>node_cells[node_offset[i+1]-1]</tt> in ascending order.
+     * The size is #num_nodes + 1.
+     */
+    int* node_offset;
+
+    /** Cells of nodes. */
+    int* node_cells;
+
+    /**
+     * Offsets of faces of cells.
+     * Faces of cell @c i are from <tt>cell_offset[i]</tt> to
+     * <tt>cell_offset[i+1]-1</tt>, and the order of faces follows
+     * ucd_cell_num_faces().  The size is #num_cells + 1.
+     */
+    int* cell_offset;
+
+    /**
+     * Neighbor cells across faces, or -1 on the boundary.
+     * The size is <tt>cell_offset[num_cells]</tt>.
+     */
+    int* cell_cells;
+} ucd_adjacency;
+
+/**
+ * @struct ucd_buckets
+ * @brief Cells grouped by types with node lists of fixed widths.
+ *
+ * Cells of each type are in a bucket in the original order, so kernels
+ * can run over a bucket without branches on types, and results in the
+ * bucketed order are put back by ucd_buckets_scatter().
+ */
+typedef struct {
+    /** The number of cells. */
+    int num_cells;
+
+    /**
+     * Offsets of buckets.
+     * Cells of type @c t are from <tt>offset[t]</tt> to
+     * <tt>offset[t+1]-1</tt> in the bucketed order.
+     */
+    int offset[9];
+
+    /**
+     * Node lists of buckets.
+     * Node IDs of the @c k th cell of type @c t are from
+     * <tt>nlist[t][n*k]</tt> to <tt>nlist[t][n*k+n-1]</tt>, where @c n is
+     * ucd_cell_nlist_size() of @c t.  They share an array which begins
+     * at <tt>nlist[0]</tt>.
+     */
+    int* nlist[8];
+
+    /**
+     * Original indices (0-based) of cells in the bucketed order.
+     * The size is #num_cells.
+     */
+    int* order;
+} ucd_buckets;
+
+/**
+ * @struct ucd_series
+ * @brief A file of node and cell data of time steps on the same mesh.
+ *
+ * Steps are stored as residuals against the previous step, and a step
+ * at every #keyframe_interval is stored by itself.  So a step can be read
+ * by decoding steps from the previous keyframe.
+ */
+typedef struct {
+    /** The number of steps. */
+    int num_steps;
+
+    /** The interval of keyframes in steps. */
+    int keyframe_interval;
+
+    /** The number of rows of node data. */
+    int num_nodes;
+
+    /** The number of rows of cell data. */
+    int num_cells;
+
+    /** The number of columns of node data. */
+    int num_ndata;
+
+    /** The number of columns of cell data. */
+    int num_cdata;
+
+    /** @private */
+    FILE* _fp;
+
+    /** @private */
+    int _is_writer;
+
+    /** @private */
+    int _step;
+
+    /** @private */
+    ucd_data* _ndata;
+
+    /** @private */
+    ucd_data* _cdata;
+
+    /** @private */
+    unsigned int* _bits;
+
+    /** @private */
+    long* _offsets;
+} ucd_series;
+
+/**
+ * @struct ucd_stats
+ * @brief Statistics of a data column accumulated in a single pass.
+ *
+ * The histogram starts from a given range, or the range of the first
+ * values, and doubles its range when values out of the range are added.
+ * So the memory is bounded by the number of bins.
+ */
+typedef struct {
+    /** The number of finite values. */
+    long count;
+
+    /** The number of NaN or infinite values, which are not in the others. */
+    long num_nonfinite;
+
+    /** Mean of values. */
+    double mean;
+
+    /** Sum of squared deviations from the mean. */
+    double m2;
+
+    /** Minimum value. */
+    float minimum;
+
+    /** Maximum value. */
+    float maximum;
+
+    /** Lower bound of the histogram. */
+    float lower;
+
+    /** Upper bound of the histogram. */
+    float upper;
+
+    /** The number of bins of the histogram. */
+    int num_bins;
+
+    /**
+     * Counts of values in the histogram.
+     * The size is #num_bins.
+     */
+    long* bins;
+} ucd_stats;
+
 /**
  *
  * \param ucd A pointer to content.
@@ -195,10 +715,442 @@ typedef struct {
  * \return EXIT_SUCCESS if success.
  */
 int ucd_simple_reader(ucd_content* ucd, const char* filename, int* was_binary);
+
+/**
+ * Read a content with options.
+ *
+ * \param ucd A pointer to content.
+ * \param filename A filename to read.
+ * \param o A pointer to options, or NULL for the defaults.
+ * \param c It returns the format of the file unless NULL.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_simple_reader_ex(ucd_content* ucd, const char* filename,
+        const ucd_options* o, ucd_context* c);
 int ucd_simple_writer(const ucd_content* ucd, const char* filename, int is_binary);
+
+/**
+ * Read numbers and headers of data of a file without nodes, cells and
+ * data.  Bodies of binary format are skipped by their sizes, and lines of
+ * ASCII format are skipped without parsing.
+ *
+ * \param ucd A pointer to content.  It returns the numbers of nodes and
+ *     cells and headers (components, labels, units, minima and maxima) of
+ *     data, but no arrays of nodes, cells and data.  It should be freed by
+ *     ucd_simple_free().  Minima are greater than maxima in ASCII format,
+ *     which does not store them.
+ * \param filename A filename to read.
+ * \param c A pointer to context.  It returns the format of the file.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_probe(ucd_content* ucd, const char* filename, ucd_context* c);
+
+/**
+ * Write a content with options.
+ *
+ * \param ucd A pointer to content.
+ * \param filename A filename to write.
+ * \param is_binary Non-zero for binary format.
+ * \param o A pointer to options, or NULL for the defaults.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_simple_writer_ex(const ucd_content* ucd, const char* filename,
+        int is_binary, const ucd_options* o);
 void ucd_simple_free(ucd_content* ucd);
 
+/**
+ * Allocate node and cell arrays of a content.
+ * The #ucd_content::ndata and #ucd_content::cdata are set to NULL.
+ *
+ * \param ucd A pointer to content.
+ * \param num_nodes The number of nodes.
+ * \param num_cells The number of cells.
+ * \param ld_nlist The leading dimension size of the node list.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_simple_alloc(ucd_content* ucd,
+        int num_nodes, int num_cells, int ld_nlist);
+
+/**
+ * Allocate node or cell data.
+ * The labels and units are cleared and #ucd_data::num_comp is zero.
+ *
+ * \return A pointer to data which should be freed by ucd_data_free(),
+ *     or NULL if failed.
+ */
+ucd_data* ucd_data_alloc(int num_rows, int num_data);
+void ucd_data_free(ucd_data* d);
+
+/** Recompute #ucd_data::minima and #ucd_data::maxima from data. */
+void ucd_data_update_minmax(ucd_data* d);
+
+/** Copy components, labels and units (but not data) from another one. */
+void ucd_data_copy_header(ucd_data* dst, const ucd_data* src);
+
+/**
+ * Get a component of data.
+ *
+ * \param d A pointer to data.
+ * \param comp A component number (0-based).
+ * \param ld It returns the leading dimension, i.e. (i, j) of the component
+ *     is at [i * ld + j] of the returned pointer.
+ * \return A pointer to (0, 0) of the component.
+ */
+float* ucd_data_component(const ucd_data* d, int comp, int* ld);
+
+/**
+ * Get a column of data.
+ *
+ * \param d A pointer to data.
+ * \param col A column number (0-based) less than #ucd_data::num_data.
+ * \param ld It returns the stride between rows.
+ * \return A pointer to the value of the first row.
+ */
+float* ucd_data_column(const ucd_data* d, int col, int* ld);
+
+/**
+ * Find a component by label.
+ *
+ * \return A component number (0-based), or -1 if not found.
+ */
+int ucd_data_find_component(const ucd_data* d, const char* label);
+
+/**
+ * Append a component to data.
+ * Data are reallocated, so pointers got before are invalidated.  Values of
+ * the new component are uninitialized; minima and maxima should be updated
+ * after filling them.
+ *
+ * \param d A pointer to data.
+ * \param size The size of the component.
+ * \param label A label of the component.
+ * \param unit A unit of the component.
+ * \param ld It returns the leading dimension of the new component.
+ * \return A pointer to (0, 0) of the new component, or NULL if failed.
+ */
+float* ucd_data_append_component(ucd_data* d, int size,
+        const char* label, const char* unit, int* ld);
+
+/**
+ * Append all components of other data which have the same rows.
+ *
+ * \param d A pointer to data.
+ * \param src Data to append.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_data_append(ucd_data* d, const ucd_data* src);
+
+/**
+ * Rearrange data into a layout.
+ *
+ * \param d A pointer to data.
+ * \param layout One of UCD_LAYOUT_* values.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_data_set_layout(ucd_data* d, int layout);
+
+/**
+ * @name Derived components
+ * Functions to append a component derived from existing ones.
+ * If @p label is NULL, a label is made from the source label.
+ * The unit is inherited from the source component.
+ * @{
+ */
+
+/** Append the magnitude of a vector component as a scalar. */
+int ucd_derive_magnitude(ucd_data* d, int comp, const char* label);
+
+/**
+ * Append the von Mises stress of a symmetric tensor component.
+ * The component should have 6 values in order of xx, yy, zz, xy, yz, zx.
+ */
+int ucd_derive_mises(ucd_data* d, int comp, const char* label);
+
+/**
+ * Append the principal values of a symmetric tensor component.
+ * The component should have 6 values in order of xx, yy, zz, xy, yz, zx.
+ * The appended component has 3 values in descending order.
+ */
+int ucd_derive_principal(ucd_data* d, int comp, const char* label);
+
+/**
+ * Append a linear combination of components which have the same size.
+ *
+ * \param d A pointer to data.
+ * \param num_terms The number of terms.
+ * \param comps Component numbers of terms.
+ * \param coefs Coefficients of terms.
+ * \param label A label of the component.
+ * \param unit A unit of the component.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_derive_linear(ucd_data* d, int num_terms,
+        const int* comps, const float* coefs,
+        const char* label, const char* unit);
+/** @} */
+
+/**
+ * Initialize statistics.
+ *
+ * \param s A pointer to statistics.  It should be freed by ucd_stats_free().
+ * \param num_bins The number of bins of the histogram (rounded up to even).
+ * \param lower Lower bound of the histogram.
+ * \param upper Upper bound of the histogram.  If it is not greater than
+ *     @p lower, the range of the first values is used.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_stats_init(ucd_stats* s, int num_bins, float lower, float upper);
+void ucd_stats_free(ucd_stats* s);
+
+/** Add @p n values which the stride is @p stride. */
+void ucd_stats_add(ucd_stats* s, const float* values, int n, int stride);
+
+/** Variance of values. */
+double ucd_stats_variance(const ucd_stats* s);
+
+/**
+ * Approximate percentile from the histogram.
+ *
+ * \param s A pointer to statistics.
+ * \param p A fraction from 0 to 1 (e.g. 0.5 for median).
+ * \return An interpolated value within the bin.
+ */
+float ucd_stats_percentile(const ucd_stats* s, double p);
+
+/**
+ * Compute statistics of all node and cell data in a file.
+ * Data are streamed by blocks of rows, so the memory is bounded
+ * regardless of the file size.
+ *
+ * \param ucd A pointer to content.  It returns the numbers of nodes and
+ *     cells and headers (components, labels, units, minima and maxima) of
+ *     data, but no arrays of nodes, cells and data.  It should be freed by
+ *     ucd_simple_free().
+ * \param filename A filename to read.
+ * \param num_bins The number of bins of histograms.
+ * \param nstats It returns an array of statistics for each node data, or
+ *     NULL if no node data.  Each should be freed by ucd_stats_free() and
+ *     the array by free().
+ * \param cstats It returns the same for cell data.
+ * \return EXIT_SUCCESS if success.  Nothing is left to free if failure.
+ */
+int ucd_stats_read(ucd_content* ucd, const char* filename, int num_bins,
+        ucd_stats** nstats, ucd_stats** cstats);
+
+/**
+ * Select cells which satisfy all predicates.
+ *
+ * \param ucd A pointer to content.
+ * \param num_predicates The number of predicates.
+ * \param predicates Predicates.
+ * \param any_node If non-zero, a cell satisfies a predicate on nodes when
+ *     any of its nodes satisfies it.  Otherwise all nodes should.
+ * \param selected It returns non-zero for selected cells.
+ *     The size is #ucd_content::num_cells.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_select_cells(const ucd_content* ucd,
+        int num_predicates, const ucd_predicate* predicates,
+        int any_node, char* selected);
+
+/**
+ * Extract cells which satisfy all predicates from a file.
+ * Data are streamed twice by blocks of rows, once to evaluate predicates
+ * and once to copy rows of selected nodes and cells, so only nodes, cells
+ * and the extracted data are kept in memory.  In a file of chunked
+ * container, chunks which cannot satisfy a predicate by their minima and
+ * maxima are skipped, and only chunks of selected rows are decoded.
+ *
+ * \param sub A pointer to content to make as ucd_extract_cells() does.
+ *     It should be freed by ucd_simple_free().
+ * \param filename A filename to read.
+ * \param num_predicates The number of predicates.
+ * \param predicates Predicates.
+ * \param any_node Same as ucd_select_cells().
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_extract_file(ucd_content* sub, const char* filename,
+        int num_predicates, const ucd_predicate* predicates, int any_node);
+
+/**
+ * Build node-to-cell and cell-to-cell (face neighbor) adjacency.
+ * Cells of nodes are made by counting sort and faces of cells are matched
+ * through them in parallel, so the memory is proportional to the node
+ * list.  Faces of 2D cells are edges and those of lines are end points.
+ * A face is shared with a cell of the same dimension which has a face of
+ * the same set of nodes, and faces without such a cell are on the
+ * boundary.
+ *
+ * \param adj A pointer to adjacency to make.  It should be freed by
+ *     ucd_adjacency_free().
+ * \param ucd A pointer to content.
+ * \return EXIT_SUCCESS if success.  Nothing is left to free if failure.
+ */
+int ucd_adjacency_build(ucd_adjacency* adj, const ucd_content* ucd);
+void ucd_adjacency_free(ucd_adjacency* adj);
+
+/**
+ * Group cells by types.
+ *
+ * \param b A pointer to buckets to make.  It should be freed by
+ *     ucd_buckets_free().
+ * \param ucd A pointer to content.
+ * \return EXIT_SUCCESS if success.  Nothing is left to free if failure.
+ */
+int ucd_buckets_build(ucd_buckets* b, const ucd_content* ucd);
+void ucd_buckets_free(ucd_buckets* b);
+
+/**
+ * Gather values of cells into the bucketed order.
+ *
+ * \param b A pointer to buckets.
+ * \param src Values in the original order, of which row @c i is from
+ *     <tt>src[i*ld]</tt>.
+ * \param ld The leading dimension of @p src.
+ * \param n The number of values of a row.
+ * \param dst It returns values in the bucketed order, of which rows are
+ *     contiguous.  The size is ucd_buckets#num_cells times @p n.
+ */
+void ucd_buckets_gather(const ucd_buckets* b,
+        const float* src, int ld, int n, float* dst);
+
+/**
+ * Scatter values of cells in the bucketed order back to the original
+ * order.  It is the inverse of ucd_buckets_gather().
+ */
+void ucd_buckets_scatter(const ucd_buckets* b,
+        const float* src, int n, float* dst, int ld);
+
+/**
+ * Compute measures of cells, which are volumes of 3D cells, areas of 2D
+ * cells, lengths of lines and zero for points.  Cells are split into
+ * simplices of the centroid and faces, so they are exact for cells with
+ * planar faces which are star-shaped from the centroid.
+ *
+ * \param ucd A pointer to content.
+ * \param measures It returns measures.  The size is #ucd_content::num_cells.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_cell_measures(const ucd_content* ucd, float* measures);
+
+/**
+ * Average cell data onto nodes.
+ * A node has the weighted mean of cells which have the node, and zero if
+ * no cell has it.  Nodes gather values from their cells, so they are
+ * computed in parallel without conflicts.
+ *
+ * \param ucd A pointer to content.
+ * \param adj Adjacency of @p ucd, or NULL to build it temporarily.
+ * \param cdata Cell data.
+ * \param weighting One of UCD_AVERAGE_* values.
+ * \return Node data with the same components, labels and units, which
+ *     should be freed by ucd_data_free(), or NULL if failed.
+ */
+ucd_data* ucd_cell_to_node(const ucd_content* ucd, const ucd_adjacency* adj,
+        const ucd_data* cdata, int weighting);
+
+/**
+ * Average node data onto cells.
+ * A cell has the mean of its nodes.
+ *
+ * \param ucd A pointer to content.
+ * \param ndata Node data.
+ * \return Cell data with the same components, labels and units, which
+ *     should be freed by ucd_data_free(), or NULL if failed.
+ */
+ucd_data* ucd_node_to_cell(const ucd_content* ucd, const ucd_data* ndata);
+
+/**
+ * Compute geometric quality metrics of cells.
+ * Cells are processed by batches of the same type in parallel.  Metrics
+ * are the following components of size one.
+ * - measure: volume, area or length as ucd_cell_measures().
+ * - jacobian: the minimum scaled Jacobian at corners, from -1 to 1.  It is
+ *   negative if a cell is inverted, i.e. the first face of a 3D cell is not
+ *   counter-clockwise seen from the rest (the apex of pyr is not checked).
+ *   Corners of 2D cells are measured against the normal of the cell.
+ * - aspect: the ratio of the longest edge to the shortest one.
+ * - skew: equiangle skewness of faces from 0 (equilateral) to 1.
+ *
+ * \param ucd A pointer to content.
+ * \return Cell data of metrics, which should be freed by ucd_data_free(),
+ *     or NULL if failed.
+ */
+ucd_data* ucd_cell_quality(const ucd_content* ucd);
+
+/**
+ * Partition cells into parts by recursive coordinate bisection.
+ * Cell centroids are split along the longest extent recursively,
+ * so each part is spatially coherent and has nearly equal cells.
+ *
+ * \param ucd A pointer to content.
+ * \param num_parts The number of parts.
+ * \param cell_part It returns the part number (0-based) of each cell.
+ *     The size is #ucd_content::num_cells.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_partition(const ucd_content* ucd, int num_parts, int* cell_part);
+
+/**
+ * Extract selected cells into a standalone content.
+ * Nodes used by the selected cells are renumbered from one, and the rows
+ * of node and cell data are copied.
+ *
+ * \param sub A pointer to content to make.  It should be freed by
+ *     ucd_simple_free().
+ * \param ucd A pointer to source content.
+ * \param selected Non-zero for cells to extract.
+ *     The size is #ucd_content::num_cells.
+ * \param global_node It returns an array of original node IDs for each
+ *     node of @p sub unless NULL.  It should be freed by the caller, and
+ *     nothing is returned if failure.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_extract_cells(ucd_content* sub, const ucd_content* ucd,
+        const char* selected, int** global_node);
+
+/**
+ * Start merging contents.
+ * Contents are appended one by one with ucd_merger_add(), so only the
+ * merged content and a part are needed to be in memory at once.
+ *
+ * \param m A pointer to merger.
+ * \param ucd A pointer to content to make.  It should be freed by
+ *     ucd_simple_free().
+ * \param tolerance Nodes within the distance are merged into one.  If it is
+ *     zero, only nodes which have exactly the same coordinates are merged.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_merger_open(ucd_merger* m, ucd_content* ucd, float tolerance);
+
+/**
+ * Append a content to the merged one.
+ * Coincident nodes are found by spatial hashing and the node list is
+ * remapped.  Nodes and cells are renumbered from one in the order of
+ * appending, so IDs of parts need not be unique.  Node and cell data
+ * should have the same number of data with the others.
+ */
+int ucd_merger_add(ucd_merger* m, const ucd_content* part);
+
+/** Finish merging and recompute minima and maxima of data. */
+int ucd_merger_close(ucd_merger* m);
+
+/** Initialize options with the defaults of the classic format. */
+void ucd_options_init(ucd_options* o);
+
 int ucd_reader_open(ucd_context* c, const char* filename);
+
+/**
+ * Open a file to read with options.  ucd_reader_open() is the same with
+ * the defaults.
+ *
+ * \param c A pointer to context.  All members are overwritten.
+ * \param filename A filename to read.
+ * \param o A pointer to options, or NULL for the defaults.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_reader_open_ex(ucd_context* c, const char* filename,
+        const ucd_options* o);
 int ucd_read_nodes_and_cells(ucd_context* c,
         int* nodes, float* x, float* y, float* z,
         int* cells, int* nlist, int ld_nlist);
@@ -210,7 +1162,200 @@ int ucd_read_data_binary(ucd_context* c,
         int component_size, float* data, int ld_data);
 int ucd_read_data_active_list(ucd_context* ucd, int* active_list);
 
+/**
+ * Read the next rows of node or cell data in ASCII format.
+ * It can be called repeatedly instead of ucd_read_data_ascii() to read
+ * data by blocks of rows.
+ *
+ * \param c A pointer to context.
+ * \param num_block The number of rows to read.
+ * \param ids It returns IDs of the rows.
+ * \param data It returns data of the rows, which the size is @p num_block
+ *     times the number of data.
+ * \return Zero if success.
+ */
+int ucd_read_data_ascii_rows(ucd_context* c,
+        int num_block, int* ids, float* data);
+
+/**
+ * Read the next rows of a component in binary format.
+ * It can be called repeatedly instead of ucd_read_data_binary() to read
+ * a component by blocks of rows.  The next component starts after all
+ * rows of the component are read.
+ *
+ * \param c A pointer to context.
+ * \param component_size The size of the component.
+ * \param num_block The number of rows to read.
+ * \param data It returns data of the rows.  It is skipped if NULL.
+ * \param ld_data The leading dimension of @p data.
+ * \return Zero if success.
+ */
+int ucd_read_data_binary_rows(ucd_context* c,
+        int component_size, int num_block, float* data, int ld_data);
+
+/**
+ * Overwrite node and cell data of an existing binary file in place.
+ * Nodes, cells and coordinates in the file are kept as they are, so
+ * only data are written for each step of a fixed mesh.
+ *
+ * \param ucd A pointer to content.  The numbers of nodes, cells and data,
+ *     and sizes of components should be the same as the file.
+ * \param filename A filename to rewrite.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_simple_rewriter(const ucd_content* ucd, const char* filename);
+
+/**
+ * Write content in VTK file formats of an unstructured grid.
+ * The XML format (.vtu) has raw appended data in the byte order of the
+ * host, and the legacy format (.vtk) is binary in big endian.  Nodes of
+ * cells are reordered for VTK, and components are written straight from
+ * data if they are in component layout.
+ *
+ * \param ucd A pointer to content.
+ * \param filename A filename to write.
+ * \param is_xml Nonzero for the XML format, zero for the legacy format.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_vtk_writer(const ucd_content* ucd, const char* filename, int is_xml);
+
+/**
+ * Make a coarse preview of a content by clustering nodes on a grid.
+ *
+ * Faces on the boundary of 3D cells and 2D, 1D and 0D cells themselves are
+ * kept, whose nodes are merged into one node per grid cell at the mean of
+ * the nodes.  Faces and cells which collapse are dropped.  Node data are
+ * averaged over merged nodes, and cell data are copied from the cell of
+ * each face.  Cells of the preview are in the order of types of their
+ * sources.  Minima and maxima are of the preview.
+ *
+ * \param lod A pointer to content to make.  It should be freed by
+ *     ucd_simple_free().
+ * \param ucd A pointer to content.
+ * \param adj A pointer to adjacency of the content.
+ * \param resolution The number of grid cells along the longest side of
+ *     the bounding box, from 1 to 1024.
+ * \return EXIT_SUCCESS if success.  Nothing is left to free if failure.
+ */
+int ucd_preview(ucd_content* lod, const ucd_content* ucd,
+        const ucd_adjacency* adj, int resolution);
+
+/**
+ * Write previews of a content in companion files of the binary format.
+ * Levels are written to @c x.lod1.inp, @c x.lod2.inp, ... for @c x.inp,
+ * and the resolution is halved at each level, so the last level is the
+ * smallest one to be read first.  The first level is at most half the
+ * resolution of the mesh itself, estimated from the number of cells in
+ * their bounding box.  Levels stop early at one which is empty or has no
+ * fewer cells than the last level, or more cells than the content.
+ *
+ * \param ucd A pointer to content.
+ * \param filename The filename of the content.
+ * \param num_levels The largest number of levels.
+ * \param resolution The largest resolution of the first level for
+ *     ucd_preview().
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_preview_writer(const ucd_content* ucd, const char* filename,
+        int num_levels, int resolution);
+
+/**
+ * Open an existing binary file to rewrite data by ucd_rewrite_data().
+ * The header of the file is read into the context.
+ */
+int ucd_rewriter_open(ucd_context* c, const char* filename);
+
+/**
+ * Overwrite a component of node or cell data in place.
+ * Minima and maxima of the component are also updated.
+ *
+ * \param c A pointer to context opened by ucd_rewriter_open().
+ * \param d Data which have the same numbers of rows and data and the
+ *     same sizes of components as the file.
+ * \param is_cell Non-zero for cell data.
+ * \param comp A component to write, or negative for all components.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_rewrite_data(ucd_context* c, const ucd_data* d, int is_cell, int comp);
+
+/**
+ * Read minima and maxima of chunks (zone maps) of a section.
+ * Chunks which cannot contain values of a query can be skipped, and the
+ * others can be read by ucd_read_chunk() in any order.  It moves the file
+ * position, so it should not be mixed with sequential reading.
+ *
+ * \param c A pointer to context opened by ucd_reader_open().
+ * \param section One of UCD_CHUNK_* values.
+ * \param num_chunks It returns the number of chunks per column.
+ * \return An array of chunks, where chunk @c k of column @c j is at
+ *     <tt>[j * num_chunks + k]</tt>.  It should be freed by the caller.
+ *     NULL if failure.  Columns of coordinates are x, y and z.
+ */
+ucd_chunk* ucd_read_chunk_map(ucd_context* c, int section, int* num_chunks);
+
+/**
+ * Read values of a chunk.
+ *
+ * \param c A pointer to context opened by ucd_reader_open().
+ * \param chunk A chunk returned by ucd_read_chunk_map().
+ * \param data It returns values of the chunk.
+ * \param ld_data The leading dimension of @p data.
+ * \return Zero if success.
+ */
+int ucd_read_chunk(ucd_context* c, const ucd_chunk* chunk,
+        float* data, int ld_data);
+
+/**
+ * @name Cursors
+ * Random access to a file of classic binary format.  Sections are
+ * located from the numbers in the shared context, so calls on different
+ * cursors can run in parallel.  They return zero if success.
+ * @{
+ */
+/** Open a cursor of @p filename, which @p c is opened for. */
+int ucd_cursor_open(ucd_cursor* cur, const ucd_context* c,
+        const char* filename);
+int ucd_cursor_close(ucd_cursor* cur);
+
+/** Read cells (ID, material ID, node list size, type) from @p first. */
+int ucd_cursor_read_cells(ucd_cursor* cur, int first, int count, int* cells);
+
+/** Read a part of node list of all cells from @p first. */
+int ucd_cursor_read_nlist(ucd_cursor* cur, int first, int count, int* nlist);
+
+/** Read x (@p axis 0), y (1) or z (2) of nodes from @p first. */
+int ucd_cursor_read_coords(ucd_cursor* cur, int axis,
+        int first, int count, float* coords);
+
+/**
+ * Read rows of a component of node or cell data.
+ *
+ * \param cur A pointer to cursor.
+ * \param is_cell Non-zero for cell data.
+ * \param comp A component.
+ * \param first_row The first row to read.
+ * \param num_rows The number of rows to read.
+ * \param data It returns data of the rows.
+ * \param ld_data The leading dimension of @p data.
+ */
+int ucd_cursor_read_component(ucd_cursor* cur, int is_cell, int comp,
+        int first_row, int num_rows, float* data, int ld_data);
+/** @} */
+
 int ucd_writer_open(ucd_context* c, const char* filename);
+
+/**
+ * Open a file to write with options.  ucd_writer_open() is the same with
+ * the defaults, which is the classic format.
+ *
+ * \param c A pointer to context which the format and numbers are
+ *     specified.  Other members are overwritten.
+ * \param filename A filename to write.
+ * \param o A pointer to options, or NULL for the defaults.
+ * \return EXIT_SUCCESS if success.
+ */
+int ucd_writer_open_ex(ucd_context* c, const char* filename,
+        const ucd_options* o);
 int ucd_write_nodes_and_cells(ucd_context* c,
         const int* nodes, const float* x, const float* y, const float* z,
         const int* cells, const int* nlist, int ld_nlist);
@@ -225,9 +1370,118 @@ int ucd_write_data_binary(ucd_context* ucd,
         int component_size, const float* data, int ld_data);
 int ucd_write_data_active_list(ucd_context* c, const int* active_list);
 
+/**
+ * Write the next rows of node or cell data in binary format.
+ * It can be called repeatedly after ucd_write_data_header() instead of
+ * ucd_write_data_binary() to write data by blocks of rows, and it is
+ * finished by ucd_write_data_active_list().  Rows are scattered into
+ * blocks of components through buffers of a fixed number of rows, so
+ * the whole data need not be kept in memory.  Minima and maxima are computed
+ * from the rows if ucd_write_data_minmax() is not called before, which
+ * is required to quantize data.
+ *
+ * \param c A pointer to context.
+ * \param num_block The number of rows to write.
+ * \param data Data of the rows, where (i, j) is at <tt>[i * ld_data + j]</tt>.
+ * \param ld_data The leading dimension of @p data.
+ * \return Zero if success.
+ */
+int ucd_write_data_rows(ucd_context* c,
+        int num_block, const float* data, int ld_data);
+
+/**
+ * @name Lazy content
+ * Parts of a content are read on demand.  Binary files of classic and
+ * extended encodings are read by parts, and the others are read entirely
+ * by ucd_lazy_open().  Loaded parts are kept until ucd_lazy_close().
+ * They return zero if success.
+ * @{
+ */
+/** Open a file and read numbers and headers of data. */
+int ucd_lazy_open(ucd_lazy* lz, const char* filename);
+
+/** Load IDs and coordinates of nodes unless loaded. */
+int ucd_lazy_nodes(ucd_lazy* lz);
+
+/** Load IDs, material IDs, types and node lists of cells unless loaded. */
+int ucd_lazy_cells(ucd_lazy* lz);
+
+/**
+ * Load a component of node or cell data unless loaded.
+ *
+ * \param lz A pointer to lazy content.
+ * \param is_cell Non-zero for cell data.
+ * \param comp A component.
+ * \param ld It returns the leading dimension of the component.
+ * \return A pointer to the component in data of the content, or NULL if
+ *     failed.
+ */
+float* ucd_lazy_component(ucd_lazy* lz, int is_cell, int comp, int* ld);
+int ucd_lazy_close(ucd_lazy* lz);
+/** @} */
+
+/**
+ * @name Series
+ * Node and cell data of time steps in a file.  Either of node data or
+ * cell data may be NULL, and all steps should have the same numbers of
+ * rows and columns as the first one.  They return zero if success.
+ * @{
+ */
+/**
+ * Create a series file.
+ *
+ * \param s A pointer to series.
+ * \param filename The name of a file.
+ * \param ndata Node data, of which labels, units, components and row IDs
+ *     are stored for all steps.
+ * \param cdata Cell data as well.
+ * \param keyframe_interval The interval of keyframes in steps.
+ */
+int ucd_series_writer_open(ucd_series* s, const char* filename,
+        const ucd_data* ndata, const ucd_data* cdata, int keyframe_interval);
+
+/** Append a step of node data and cell data. */
+int ucd_series_write(ucd_series* s, const ucd_data* ndata,
+        const ucd_data* cdata);
+
+/** Open a series file and locate its steps. */
+int ucd_series_reader_open(ucd_series* s, const char* filename);
+
+/**
+ * Read a step.  Steps are faster to read in ascending order, since the
+ * last step read is kept.
+ *
+ * \param s A pointer to series opened by ucd_series_reader_open().
+ * \param step A step (0-based).
+ * \param ndata It returns node data which should be freed by
+ *     ucd_data_free(), or NULL if there are no node data.
+ * \param cdata It returns cell data as well.
+ */
+int ucd_series_read(ucd_series* s, int step,
+        ucd_data** ndata, ucd_data** cdata);
+int ucd_series_close(ucd_series* s);
+/** @} */
+
 int ucd_cell_nlist_size(int cell_type);
+
+/** The number of faces of a cell type, or -1 if invalid. */
+int ucd_cell_num_faces(int cell_type);
 const char* ucd_cell_type_string(int num);
 int ucd_cell_type_number(const char* str);
 int ucd_binary_filesize(ucd_context* c);
 
+/**
+ * Verify checksums of sections of a binary file.
+ *
+ * \param c A pointer to context opened by ucd_reader_open() for the file.
+ * \param filename The name of the file.
+ * \return Zero if all sections match the trailer or the file has no
+ *     trailer.
+ */
+int ucd_verify_checksum(const ucd_context* c, const char* filename);
+
 int ucd_close(ucd_context* c);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,517 @@
+/**
+ * @file ucd.hpp
+ * @brief A header-only C++ interface of the ucdtool.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ *
+ * Contents and data are owned by move-only ucd::mesh and ucd::field, which
+ * free them on destruction.  Arrays are exposed as spans without copies,
+ * and components of data as views of which offsets, labels and units are
+ * computed once.  Failures of the C functions are thrown as ucd::error.
+ * It requires C++17, and std::span is used in C++20.
+ */
+
+#pragma once
+
+#include "ucd.h"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_MSVC_LANG)
+#define UCD_CPLUSPLUS _MSVC_LANG
+#else
+#define UCD_CPLUSPLUS __cplusplus
+#endif
+
+#if UCD_CPLUSPLUS >= 202002L && __has_include(<span>)
+#include <span>
+#endif
+
+namespace ucd {
+
+#if UCD_CPLUSPLUS >= 202002L && __has_include(<span>)
+template <class T>
+using span = std::span<T>;
+#else
+/** A view of a contiguous array as std::span of C++20. */
+template <class T>
+class span {
+public:
+    using element_type = T;
+    using iterator = T*;
+
+    constexpr span() noexcept : _data(nullptr), _size(0) {}
+    constexpr span(T* data, std::size_t size) noexcept
+        : _data(data), _size(size) {}
+    template <class U, class = std::enable_if_t<
+            std::is_convertible_v<U (*)[], T (*)[]>>>
+    constexpr span(const span<U>& s) noexcept
+        : _data(s.data()), _size(s.size()) {}
+
+    constexpr T* data() const noexcept { return _data; }
+    constexpr std::size_t size() const noexcept { return _size; }
+    constexpr bool empty() const noexcept { return _size == 0; }
+    constexpr T& operator[](std::size_t i) const { return _data[i]; }
+    constexpr T* begin() const noexcept { return _data; }
+    constexpr T* end() const noexcept { return _data + _size; }
+
+private:
+    T* _data;
+    std::size_t _size;
+};
+#endif
+
+/** An exception of a failed function of the library. */
+class error : public std::runtime_error {
+public:
+    explicit error(const std::string& what) : std::runtime_error(what) {}
+};
+
+/** Cell types as numbers of ucd_content#cell_type. */
+enum class cell_type : int {
+    pt = 0, line = 1, tri = 2, quad = 3,
+    tet = 4, pyr = 5, prism = 6, hex = 7
+};
+
+/** Properties of a cell type known at compile time. */
+template <cell_type Type>
+struct cell_traits {
+    /** The number of nodes as ucd_cell_nlist_size(). */
+    static constexpr int num_nodes = static_cast<int>(Type)
+        + (static_cast<int>(Type) < 4 || Type == cell_type::hex);
+};
+
+/**
+ * A cell of which type is known at compile time.
+ * It is passed to functions by mesh::for_each_cell().
+ */
+template <cell_type Type>
+struct cell {
+    static constexpr cell_type type = Type;
+    static constexpr int num_nodes = cell_traits<Type>::num_nodes;
+
+    /** The index (0-based) of the cell in the mesh. */
+    int index;
+
+    /** The ID of the cell. */
+    int id;
+
+    /** The material ID of the cell. */
+    int mat_id;
+
+    /** Node IDs of the cell, as ucd_content#cell_nlist. */
+    const int* nodes;
+
+    /** A node ID, where @p k is less than #num_nodes. */
+    int node(int k) const { return nodes[k]; }
+};
+
+/**
+ * A component of data.
+ * The value (i, j) is at [i * ld + j] of #data, as ucd_data_component().
+ */
+template <class T>
+struct basic_component {
+    /** The label, which refers to ucd_data#labels. */
+    std::string_view label;
+
+    /** The unit, which refers to ucd_data#units. */
+    std::string_view unit;
+
+    /** The first column (0-based) of the component in data. */
+    int offset;
+
+    /** The number of columns of the component. */
+    int size;
+
+    /** The leading dimension. */
+    int ld;
+
+    /** The number of rows. */
+    int num_rows;
+
+    /** A pointer to (0, 0) of the component. */
+    T* data;
+
+    /** Values of a row of the component. */
+    span<T> operator[](int i) const
+    {
+        return span<T>(data + static_cast<std::size_t>(i) * ld, size);
+    }
+
+    /** Whether rows of the component are contiguous to each other. */
+    bool is_contiguous() const { return ld == size; }
+};
+
+using component = basic_component<float>;
+using const_component = basic_component<const float>;
+
+/**
+ * A view of node or cell data which does not own it.
+ *
+ * Components are computed when it is made, so views should be kept rather
+ * than made for each access.  They are invalidated when components of the
+ * data are appended or its layout is changed.
+ */
+template <class T>
+class basic_field_view {
+public:
+    using data_type = std::conditional_t<std::is_const_v<T>,
+          const ucd_data, ucd_data>;
+
+    basic_field_view() noexcept : _d(nullptr) {}
+
+    explicit basic_field_view(data_type* d) : _d(d)
+    {
+        const char *label, *unit;
+        int offset, i;
+
+        if (_d == nullptr) {
+            return;
+        }
+        _components.reserve(_d->num_comp);
+        label = _d->labels;
+        unit = _d->units;
+        offset = 0;
+        for (i = 0; i < _d->num_comp; ++i) {
+            basic_component<T> comp;
+
+            comp.label = label;
+            comp.unit = unit;
+            comp.offset = offset;
+            comp.size = _d->components[i];
+            comp.num_rows = _d->num_rows;
+            comp.data = ucd_data_component(_d, i, &comp.ld);
+            _components.push_back(comp);
+            label += comp.label.size() + 1;
+            unit += comp.unit.size() + 1;
+            offset += comp.size;
+        }
+    }
+
+    /** Whether it refers to data. */
+    explicit operator bool() const noexcept { return _d != nullptr; }
+
+    /** The underlying data. */
+    data_type* get() const noexcept { return _d; }
+
+    int num_rows() const { return _d->num_rows; }
+    int num_data() const { return _d->num_data; }
+    int num_comp() const { return _d->num_comp; }
+
+    /** Node or cell IDs of rows. */
+    span<std::conditional_t<std::is_const_v<T>, const int, int>>
+    row_id() const
+    {
+        return {_d->row_id, static_cast<std::size_t>(_d->num_rows)};
+    }
+
+    /** Minimum values for each column. */
+    span<T> minima() const
+    {
+        return {_d->minima, static_cast<std::size_t>(_d->num_data)};
+    }
+
+    /** Maximum values for each column. */
+    span<T> maxima() const
+    {
+        return {_d->maxima, static_cast<std::size_t>(_d->num_data)};
+    }
+
+    /** All values in ucd_data#layout. */
+    span<T> values() const
+    {
+        return {_d->data, static_cast<std::size_t>(_d->num_rows)
+            * static_cast<std::size_t>(_d->num_data)};
+    }
+
+    /** All components. */
+    const std::vector<basic_component<T>>& components() const noexcept
+    {
+        return _components;
+    }
+
+    /** A component by number (0-based). */
+    const basic_component<T>& operator[](int comp) const
+    {
+        return _components[comp];
+    }
+
+    /** A component by label, or nullptr if not found. */
+    const basic_component<T>* find(std::string_view label) const
+    {
+        for (const basic_component<T>& comp : _components) {
+            if (comp.label == label) {
+                return &comp;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    data_type* _d;
+    std::vector<basic_component<T>> _components;
+};
+
+using field_view = basic_field_view<float>;
+using const_field_view = basic_field_view<const float>;
+
+/** Node or cell data which is freed by ucd_data_free(). */
+class field {
+public:
+    field() noexcept : _d(nullptr) {}
+
+    /** Take ownership of data, e.g. returned by ucd_cell_quality(). */
+    explicit field(ucd_data* d) noexcept : _d(d) {}
+
+    /** Allocate data as ucd_data_alloc(). */
+    field(int num_rows, int num_data) : _d(ucd_data_alloc(num_rows, num_data))
+    {
+        if (_d == nullptr) {
+            throw error("ucd_data_alloc failed");
+        }
+    }
+
+    field(field&& other) noexcept : _d(other.release()) {}
+
+    field& operator=(field&& other) noexcept
+    {
+        if (this != &other) {
+            ucd_data_free(_d);
+            _d = other.release();
+        }
+        return *this;
+    }
+
+    field(const field&) = delete;
+    field& operator=(const field&) = delete;
+
+    ~field() { ucd_data_free(_d); }
+
+    explicit operator bool() const noexcept { return _d != nullptr; }
+
+    ucd_data* get() noexcept { return _d; }
+    const ucd_data* get() const noexcept { return _d; }
+
+    /** Give up ownership of the data. */
+    ucd_data* release() noexcept { return std::exchange(_d, nullptr); }
+
+    field_view view() { return field_view(_d); }
+    const_field_view view() const { return const_field_view(_d); }
+
+private:
+    ucd_data* _d;
+};
+
+/** A content which is freed by ucd_simple_free(). */
+class mesh {
+public:
+    mesh() noexcept : _ucd() {}
+
+    /** Allocate nodes and cells as ucd_simple_alloc(). */
+    mesh(int num_nodes, int num_cells, int ld_nlist) : _ucd()
+    {
+        if (ucd_simple_alloc(&_ucd, num_nodes, num_cells, ld_nlist)) {
+            _ucd = ucd_content();
+            throw error("ucd_simple_alloc failed");
+        }
+    }
+
+    mesh(mesh&& other) noexcept : _ucd(other.release()) {}
+
+    mesh& operator=(mesh&& other) noexcept
+    {
+        if (this != &other) {
+            ucd_simple_free(&_ucd);
+            _ucd = other.release();
+        }
+        return *this;
+    }
+
+    mesh(const mesh&) = delete;
+    mesh& operator=(const mesh&) = delete;
+
+    ~mesh() { ucd_simple_free(&_ucd); }
+
+    /**
+     * Take ownership of a content, e.g. made by ucd_extract_cells().
+     * The content is cleared.
+     */
+    static mesh adopt(ucd_content& ucd) noexcept
+    {
+        mesh m;
+
+        m._ucd = std::exchange(ucd, ucd_content());
+        return m;
+    }
+
+    /** Read a file with options as ucd_simple_reader_ex(). */
+    static mesh read(const std::string& filename, const ucd_options& o,
+            ucd_context* c = nullptr)
+    {
+        mesh m;
+
+        if (ucd_simple_reader_ex(&m._ucd, filename.c_str(), &o, c)) {
+            m._ucd = ucd_content();
+            throw error("cannot read " + filename);
+        }
+        return m;
+    }
+
+    /** Read a file in a layout of data. */
+    static mesh read(const std::string& filename,
+            int layout = UCD_LAYOUT_ROW)
+    {
+        ucd_options o;
+
+        ucd_options_init(&o);
+        o.layout = layout;
+        return read(filename, o);
+    }
+
+    /** Write a file with options as ucd_simple_writer_ex(). */
+    void write(const std::string& filename, bool is_binary,
+            const ucd_options& o) const
+    {
+        if (ucd_simple_writer_ex(&_ucd, filename.c_str(), is_binary, &o)) {
+            throw error("cannot write " + filename);
+        }
+    }
+
+    /** Write a file in ASCII or binary format. */
+    void write(const std::string& filename, bool is_binary) const
+    {
+        if (ucd_simple_writer(&_ucd, filename.c_str(), is_binary)) {
+            throw error("cannot write " + filename);
+        }
+    }
+
+    ucd_content& get() noexcept { return _ucd; }
+    const ucd_content& get() const noexcept { return _ucd; }
+
+    /** Give up ownership of the content, which is cleared. */
+    ucd_content release() noexcept
+    {
+        return std::exchange(_ucd, ucd_content());
+    }
+
+    int num_nodes() const noexcept { return _ucd.num_nodes; }
+    int num_cells() const noexcept { return _ucd.num_cells; }
+    int ld_nlist() const noexcept { return _ucd.ld_nlist; }
+
+    span<int> node_id() { return _nodes(_ucd.node_id); }
+    span<const int> node_id() const { return _nodes(_ucd.node_id); }
+    span<float> x() { return _nodes(_ucd.node_x); }
+    span<const float> x() const { return _nodes(_ucd.node_x); }
+    span<float> y() { return _nodes(_ucd.node_y); }
+    span<const float> y() const { return _nodes(_ucd.node_y); }
+    span<float> z() { return _nodes(_ucd.node_z); }
+    span<const float> z() const { return _nodes(_ucd.node_z); }
+
+    span<int> cell_id() { return _cells(_ucd.cell_id); }
+    span<const int> cell_id() const { return _cells(_ucd.cell_id); }
+    span<int> mat_id() { return _cells(_ucd.cell_mat_id); }
+    span<const int> mat_id() const { return _cells(_ucd.cell_mat_id); }
+    span<int> types() { return _cells(_ucd.cell_type); }
+    span<const int> types() const { return _cells(_ucd.cell_type); }
+
+    /** Node IDs of a cell, as ucd_content#cell_nlist. */
+    span<const int> nlist(int i) const
+    {
+        return {_ucd.cell_nlist + static_cast<std::size_t>(i) * _ucd.ld_nlist,
+            static_cast<std::size_t>(ucd_cell_nlist_size(_ucd.cell_type[i]))};
+    }
+
+    /** A view of node data, which is empty if there are none. */
+    field_view ndata() { return field_view(_ucd.ndata); }
+    const_field_view ndata() const { return const_field_view(_ucd.ndata); }
+
+    /** A view of cell data, which is empty if there are none. */
+    field_view cdata() { return field_view(_ucd.cdata); }
+    const_field_view cdata() const { return const_field_view(_ucd.cdata); }
+
+    /** Replace node data, of which ownership is taken. */
+    void set_ndata(field&& d)
+    {
+        ucd_data_free(_ucd.ndata);
+        _ucd.ndata = d.release();
+    }
+
+    /** Replace cell data, of which ownership is taken. */
+    void set_cdata(field&& d)
+    {
+        ucd_data_free(_ucd.cdata);
+        _ucd.cdata = d.release();
+    }
+
+    /**
+     * Call a function for each cell with ucd::cell of its type, so the
+     * function is instantiated for each type with the number of nodes
+     * known at compile time.
+     */
+    template <class F>
+    void for_each_cell(F&& f) const
+    {
+        int i;
+
+        for (i = 0; i < _ucd.num_cells; ++i) {
+            switch (_ucd.cell_type[i]) {
+            case 0: f(_cell<cell_type::pt>(i)); break;
+            case 1: f(_cell<cell_type::line>(i)); break;
+            case 2: f(_cell<cell_type::tri>(i)); break;
+            case 3: f(_cell<cell_type::quad>(i)); break;
+            case 4: f(_cell<cell_type::tet>(i)); break;
+            case 5: f(_cell<cell_type::pyr>(i)); break;
+            case 6: f(_cell<cell_type::prism>(i)); break;
+            case 7: f(_cell<cell_type::hex>(i)); break;
+            default:
+                throw error("cell type number "
+                        + std::to_string(_ucd.cell_type[i]) + " is invalid");
+            }
+        }
+    }
+
+    /** Call a function for each cell of a type. */
+    template <cell_type Type, class F>
+    void for_each_cell(F&& f) const
+    {
+        int i;
+
+        for (i = 0; i < _ucd.num_cells; ++i) {
+            if (_ucd.cell_type[i] == static_cast<int>(Type)) {
+                f(_cell<Type>(i));
+            }
+        }
+    }
+
+private:
+    template <class T>
+    span<T> _nodes(T* p) const
+    {
+        return {p, static_cast<std::size_t>(_ucd.num_nodes)};
+    }
+
+    template <class T>
+    span<T> _cells(T* p) const
+    {
+        return {p, static_cast<std::size_t>(_ucd.num_cells)};
+    }
+
+    template <cell_type Type>
+    cell<Type> _cell(int i) const
+    {
+        return cell<Type>{i, _ucd.cell_id[i], _ucd.cell_mat_id[i],
+            _ucd.cell_nlist + static_cast<std::size_t>(i) * _ucd.ld_nlist};
+    }
+
+    ucd_content _ucd;
+};
+
+} /* namespace ucd */
@@ -0,0 +1,257 @@
+/**
+ * @file ucd_adjacency.c
+ * @brief Functions relate to adjacency of nodes and cells.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/*
+ * Faces of cell types in local node numbers of UCD, terminated by -1.
+ * Faces of 2D cells are edges, and those of lines are end points.
+ * Faces of type t are from _ucd_first_face[t] to _ucd_first_face[t+1].
+ */
+static const int _ucd_first_face[9] = {0, 0, 2, 5, 9, 13, 18, 23, 29};
+
+static const int _ucd_face_nodes[29][4] = {
+    /* line */
+    {0, -1, -1, -1}, {1, -1, -1, -1},
+    /* tri */
+    {0, 1, -1, -1}, {1, 2, -1, -1}, {2, 0, -1, -1},
+    /* quad */
+    {0, 1, -1, -1}, {1, 2, -1, -1}, {2, 3, -1, -1}, {3, 0, -1, -1},
+    /* tet */
+    {0, 1, 2, -1}, {0, 1, 3, -1}, {1, 2, 3, -1}, {0, 2, 3, -1},
+    /* pyr (apex is the first node) */
+    {1, 2, 3, 4}, {0, 1, 2, -1}, {0, 2, 3, -1}, {0, 3, 4, -1}, {0, 4, 1, -1},
+    /* prism */
+    {0, 1, 2, -1}, {3, 4, 5, -1}, {0, 1, 4, 3}, {1, 2, 5, 4}, {2, 0, 3, 5},
+    /* hex */
+    {0, 1, 2, 3}, {4, 5, 6, 7}, {0, 1, 5, 4},
+    {1, 2, 6, 5}, {2, 3, 7, 6}, {3, 0, 4, 7}
+};
+
+/* topological dimension of cell types */
+static const int _ucd_cell_dimension[8] = {0, 1, 2, 2, 3, 3, 3, 3};
+
+
+int ucd_cell_num_faces(int cell_type)
+{
+    if (cell_type < 0 || cell_type > 7) {
+        return -1;
+    }
+    return _ucd_first_face[cell_type + 1] - _ucd_first_face[cell_type];
+}
+
+
+const int* _ucd_cell_face(int cell_type, int face)
+{
+    return _ucd_face_nodes[_ucd_first_face[cell_type] + face];
+}
+
+
+int _ucd_cell_nodes(const ucd_content* ucd, const ucd_node_index* index,
+        int cell, int* nodes)
+{
+    int nsize, j, k;
+
+    nsize = ucd_cell_nlist_size(ucd->cell_type[cell]);
+    for (j = 0; j < nsize; ++j) {
+        k = _ucd_node_find(index, ucd->cell_nlist[ucd->ld_nlist * cell + j]);
+        if (k < 0) {
+            fprintf(stderr, "%s: cell %d refers unknown node %d\n",
+                    __func__, ucd->cell_id[cell],
+                    ucd->cell_nlist[ucd->ld_nlist * cell + j]);
+            return EXIT_FAILURE;
+        }
+        nodes[j] = k;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/* node to cell by counting sort, so cells of a node are in order */
+static int _ucd_adjacency_nodes(ucd_adjacency* adj, const ucd_content* ucd,
+        const ucd_node_index* index)
+{
+    int nodes[8];
+    int nsize, i, j;
+    int* next;
+
+    for (i = 0; i < ucd->num_cells; ++i) {
+        if (ucd->cell_type[i] < 0 || ucd->cell_type[i] > 7) {
+            fprintf(stderr, "%s: cell %d has invalid type %d\n",
+                    __func__, ucd->cell_id[i], ucd->cell_type[i]);
+            return EXIT_FAILURE;
+        }
+        if (_ucd_cell_nodes(ucd, index, i, nodes)) {
+            return EXIT_FAILURE;
+        }
+        nsize = ucd_cell_nlist_size(ucd->cell_type[i]);
+        for (j = 0; j < nsize; ++j) {
+            adj->node_offset[nodes[j] + 1]++;
+        }
+    }
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        adj->node_offset[i + 1] += adj->node_offset[i];
+    }
+
+    adj->node_cells = malloc(adj->node_offset[ucd->num_nodes] * sizeof(int)
+            + 1);
+    next = malloc((ucd->num_nodes + 1) * sizeof(*next));
+    if (adj->node_cells == NULL || next == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(next);
+        return EXIT_FAILURE;
+    }
+    memcpy(next, adj->node_offset, ucd->num_nodes * sizeof(*next));
+    for (i = 0; i < ucd->num_cells; ++i) {
+        _ucd_cell_nodes(ucd, index, i, nodes);
+        nsize = ucd_cell_nlist_size(ucd->cell_type[i]);
+        for (j = 0; j < nsize; ++j) {
+            adj->node_cells[next[nodes[j]]++] = i;
+        }
+    }
+
+    free(next);
+    return EXIT_SUCCESS;
+}
+
+
+/* node indices of a face in ascending order, and the number of them */
+static int _ucd_face_key(const int* face, int* key)
+{
+    int n, j, v;
+
+    for (n = 0; n < 4 && face[n] >= 0; ++n) {
+        v = face[n];
+        for (j = n; j > 0 && key[j - 1] > v; --j) {
+            key[j] = key[j - 1];
+        }
+        key[j] = v;
+    }
+    return n;
+}
+
+
+/*
+ * The neighbor across a face is the first other cell of the same
+ * dimension which has a face of the same nodes.  Candidates are cells of
+ * the first node of the face.
+ */
+static int _ucd_face_neighbor(const ucd_adjacency* adj,
+        const ucd_content* ucd, const ucd_node_index* index,
+        int cell, const int* face)
+{
+    int other[8], other_face[4], key[4], other_key[4];
+    int n, first, last, d, i, j;
+
+    n = _ucd_face_key(face, key);
+    for (i = adj->node_offset[face[0]];
+            i < adj->node_offset[face[0] + 1]; ++i) {
+        d = adj->node_cells[i];
+        if (d == cell || _ucd_cell_dimension[ucd->cell_type[d]]
+                != _ucd_cell_dimension[ucd->cell_type[cell]]) {
+            continue;
+        }
+        _ucd_cell_nodes(ucd, index, d, other);
+        first = _ucd_first_face[ucd->cell_type[d]];
+        last = _ucd_first_face[ucd->cell_type[d] + 1];
+        for (; first < last; ++first) {
+            for (j = 0; j < 4; ++j) {
+                other_face[j] = _ucd_face_nodes[first][j] < 0
+                    ? -1 : other[_ucd_face_nodes[first][j]];
+            }
+            if (_ucd_face_key(other_face, other_key) == n
+                    && memcmp(key, other_key, n * sizeof(*key)) == 0) {
+                return d;
+            }
+        }
+    }
+    return -1;
+}
+
+
+int ucd_adjacency_build(ucd_adjacency* adj, const ucd_content* ucd)
+{
+    ucd_node_index index;
+    int i;
+
+    memset(adj, 0, sizeof(*adj));
+    adj->num_nodes = ucd->num_nodes;
+    adj->num_cells = ucd->num_cells;
+
+    if (_ucd_node_index_build(&index, ucd)) {
+        return EXIT_FAILURE;
+    }
+    adj->node_offset = calloc(ucd->num_nodes + 1, sizeof(int));
+    adj->cell_offset = malloc((ucd->num_cells + 1) * sizeof(int));
+    if (adj->node_offset == NULL || adj->cell_offset == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        _ucd_node_index_free(&index);
+        ucd_adjacency_free(adj);
+        return EXIT_FAILURE;
+    }
+
+    if (_ucd_adjacency_nodes(adj, ucd, &index)) {
+        _ucd_node_index_free(&index);
+        ucd_adjacency_free(adj);
+        return EXIT_FAILURE;
+    }
+
+    adj->cell_offset[0] = 0;
+    for (i = 0; i < ucd->num_cells; ++i) {
+        adj->cell_offset[i + 1] = adj->cell_offset[i]
+            + ucd_cell_num_faces(ucd->cell_type[i]);
+    }
+    adj->cell_cells = malloc(adj->cell_offset[ucd->num_cells] * sizeof(int)
+            + 1);
+    if (adj->cell_cells == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        _ucd_node_index_free(&index);
+        ucd_adjacency_free(adj);
+        return EXIT_FAILURE;
+    }
+
+    /* faces of each cell are found independently */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for (i = 0; i < ucd->num_cells; ++i) {
+        int nodes[8], face[4];
+        int f, first, j;
+
+        _ucd_cell_nodes(ucd, &index, i, nodes);
+        first = _ucd_first_face[ucd->cell_type[i]];
+        for (f = adj->cell_offset[i]; f < adj->cell_offset[i + 1]; ++f) {
+            for (j = 0; j < 4; ++j) {
+                face[j] = _ucd_face_nodes[first][j] < 0
+                    ? -1 : nodes[_ucd_face_nodes[first][j]];
+            }
+            adj->cell_cells[f] = _ucd_face_neighbor(adj, ucd,
+                    &index, i, face);
+            ++first;
+        }
+    }
+
+    _ucd_node_index_free(&index);
+    return EXIT_SUCCESS;
+}
+
+
+void ucd_adjacency_free(ucd_adjacency* adj)
+{
+    free(adj->node_offset);
+    free(adj->node_cells);
+    free(adj->cell_offset);
+    free(adj->cell_cells);
+    adj->node_offset = NULL;
+    adj->node_cells = NULL;
+    adj->cell_offset = NULL;
+    adj->cell_cells = NULL;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file ucd_average.c
+ * @brief Functions relate to averaging data between nodes and cells.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+
+/* data of the other entity with the same components */
+static ucd_data* _ucd_average_alloc(const ucd_data* src, int num_rows,
+        const int* row_id, float*** cols, int** lds)
+{
+    ucd_data* d;
+    int j;
+
+    d = ucd_data_alloc(num_rows, src->num_data);
+    *cols = malloc((src->num_data + 1) * sizeof(**cols));
+    *lds = malloc((src->num_data + 1) * sizeof(**lds));
+    if (d == NULL || *cols == NULL || *lds == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        if (d != NULL) {
+            ucd_data_free(d);
+        }
+        free(*cols);
+        free(*lds);
+        return NULL;
+    }
+    ucd_data_copy_header(d, src);
+    memcpy(d->row_id, row_id, num_rows * sizeof(*row_id));
+    for (j = 0; j < src->num_data; ++j) {
+        (*cols)[j] = ucd_data_column(src, j, &(*lds)[j]);
+    }
+    return d;
+}
+
+
+ucd_data* ucd_cell_to_node(const ucd_content* ucd, const ucd_adjacency* adj,
+        const ucd_data* cdata, int weighting)
+{
+    ucd_adjacency built;
+    ucd_data* d;
+    float* weights;
+    float** cols;
+    int* lds;
+    int i;
+
+    if (cdata->num_rows != ucd->num_cells) {
+        fprintf(stderr, "%s: data are not of cells\n", __func__);
+        return NULL;
+    }
+    if (adj == NULL) {
+        if (ucd_adjacency_build(&built, ucd)) {
+            return NULL;
+        }
+        adj = &built;
+    }
+
+    weights = NULL;
+    d = _ucd_average_alloc(cdata, ucd->num_nodes, ucd->node_id, &cols, &lds);
+    if (d != NULL && weighting == UCD_AVERAGE_MEASURE) {
+        weights = malloc((ucd->num_cells + 1) * sizeof(*weights));
+        if (weights == NULL || ucd_cell_measures(ucd, weights)) {
+            fprintf(stderr, "%s: cannot compute measures\n", __func__);
+            ucd_data_free(d);
+            free(cols);
+            free(lds);
+            d = NULL;
+        }
+    }
+    if (d == NULL) {
+        free(weights);
+        if (adj == &built) {
+            ucd_adjacency_free(&built);
+        }
+        return NULL;
+    }
+
+    /* gathered from cells of each node, so no node is written twice */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        double w, sum;
+        float* row;
+        int cell, j, k;
+
+        row = &d->data[d->num_data * i];
+        for (j = 0; j < d->num_data; ++j) {
+            row[j] = 0;
+        }
+        sum = 0;
+        for (k = adj->node_offset[i]; k < adj->node_offset[i + 1]; ++k) {
+            cell = adj->node_cells[k];
+            w = weights != NULL ? weights[cell] : 1;
+            for (j = 0; j < d->num_data; ++j) {
+                row[j] += (float)(w * cols[j][lds[j] * cell]);
+            }
+            sum += w;
+        }
+        if (sum == 0 && adj->node_offset[i + 1] > adj->node_offset[i]) {
+            /* degenerate cells are weighted equally */
+            for (k = adj->node_offset[i]; k < adj->node_offset[i + 1]; ++k) {
+                cell = adj->node_cells[k];
+                for (j = 0; j < d->num_data; ++j) {
+                    row[j] += cols[j][lds[j] * cell];
+                }
+                sum += 1;
+            }
+        }
+        for (j = 0; j < d->num_data && sum > 0; ++j) {
+            row[j] = (float)(row[j] / sum);
+        }
+    }
+
+    ucd_data_update_minmax(d);
+    free(cols);
+    free(lds);
+    free(weights);
+    if (adj == &built) {
+        ucd_adjacency_free(&built);
+    }
+    return d;
+}
+
+
+ucd_data* ucd_node_to_cell(const ucd_content* ucd, const ucd_data* ndata)
+{
+    ucd_data* d;
+    float** cols;
+    int* lds;
+    ucd_node_index index;
+    ucd_buckets buckets;
+    int has_error, nsize, t, i;
+
+    if (ndata->num_rows != ucd->num_nodes) {
+        fprintf(stderr, "%s: data are not of nodes\n", __func__);
+        return NULL;
+    }
+    if (ucd_buckets_build(&buckets, ucd)) {
+        return NULL;
+    }
+    _ucd_node_index_build(&index, ucd);
+    if (index.table == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_buckets_free(&buckets);
+        return NULL;
+    }
+    d = _ucd_average_alloc(ndata, ucd->num_cells, ucd->cell_id, &cols, &lds);
+    if (d == NULL) {
+        ucd_buckets_free(&buckets);
+        _ucd_node_index_free(&index);
+        return NULL;
+    }
+
+    /* cells of a bucket have the same number of nodes */
+    has_error = EXIT_SUCCESS;
+    for (t = 0; t < 8 && !has_error; ++t) {
+        nsize = ucd_cell_nlist_size(t);
+#ifdef _OPENMP
+#pragma omp parallel for reduction(|:has_error)
+#endif
+        for (i = 0; i < buckets.offset[t + 1] - buckets.offset[t]; ++i) {
+            int nodes[8];
+            float* row;
+            int j, k;
+
+            if (_ucd_bucket_nodes(&buckets, ucd, &index, t, i, nodes)) {
+                has_error = EXIT_FAILURE;
+                continue;
+            }
+            row = &d->data[d->num_data * buckets.order[buckets.offset[t] + i]];
+            for (j = 0; j < d->num_data; ++j) {
+                row[j] = 0;
+                for (k = 0; k < nsize; ++k) {
+                    row[j] += cols[j][lds[j] * nodes[k]];
+                }
+                row[j] /= nsize;
+            }
+        }
+    }
+
+    ucd_buckets_free(&buckets);
+    _ucd_node_index_free(&index);
+    free(cols);
+    free(lds);
+    if (has_error) {
+        ucd_data_free(d);
+        return NULL;
+    }
+    ucd_data_update_minmax(d);
+    return d;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file ucd_bucket.c
+ * @brief Functions relate to cells grouped by types.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+
+/* cells are placed by counting sort, so buckets keep the original order */
+int ucd_buckets_build(ucd_buckets* b, const ucd_content* ucd)
+{
+    int first[8], base[9];
+    int nsize, type, i, k;
+    const int* src;
+    int* dst;
+
+    memset(b, 0, sizeof(*b));
+    b->num_cells = ucd->num_cells;
+
+    for (i = 0; i < ucd->num_cells; ++i) {
+        type = ucd->cell_type[i];
+        if (type < 0 || type > 7) {
+            fprintf(stderr, "%s: cell %d has invalid type %d\n",
+                    __func__, ucd->cell_id[i], type);
+            return EXIT_FAILURE;
+        }
+        ++b->offset[type + 1];
+    }
+    base[0] = 0;
+    for (type = 0; type < 8; ++type) {
+        base[type + 1] = base[type]
+            + b->offset[type + 1] * ucd_cell_nlist_size(type);
+        b->offset[type + 1] += b->offset[type];
+    }
+
+    b->order = malloc(ucd->num_cells * sizeof(int) + 1);
+    b->nlist[0] = malloc(base[8] * sizeof(int) + 1);
+    if (b->order == NULL || b->nlist[0] == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_buckets_free(b);
+        return EXIT_FAILURE;
+    }
+    for (type = 0; type < 8; ++type) {
+        b->nlist[type] = b->nlist[0] + base[type];
+        first[type] = b->offset[type];
+    }
+
+    for (i = 0; i < ucd->num_cells; ++i) {
+        type = ucd->cell_type[i];
+        nsize = ucd_cell_nlist_size(type);
+        k = first[type]++;
+        b->order[k] = i;
+        src = &ucd->cell_nlist[ucd->ld_nlist * i];
+        dst = &b->nlist[type][nsize * (k - b->offset[type])];
+        memcpy(dst, src, nsize * sizeof(int));
+    }
+    return EXIT_SUCCESS;
+}
+
+
+void ucd_buckets_free(ucd_buckets* b)
+{
+    int type;
+
+    free(b->order);
+    free(b->nlist[0]);
+    b->order = NULL;
+    for (type = 0; type < 8; ++type) {
+        b->nlist[type] = NULL;
+    }
+}
+
+
+int _ucd_bucket_nodes(const ucd_buckets* b, const ucd_content* ucd,
+        const ucd_node_index* index, int type, int k, int* nodes)
+{
+    const int* src;
+    int nsize, j;
+
+    nsize = ucd_cell_nlist_size(type);
+    src = &b->nlist[type][nsize * k];
+    for (j = 0; j < nsize; ++j) {
+        nodes[j] = _ucd_node_find(index, src[j]);
+        if (nodes[j] < 0) {
+            fprintf(stderr, "%s: cell %d refers unknown node %d\n",
+                    __func__, ucd->cell_id[b->order[b->offset[type] + k]],
+                    src[j]);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+void ucd_buckets_gather(const ucd_buckets* b,
+        const float* src, int ld, int n, float* dst)
+{
+    int i;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < b->num_cells; ++i) {
+        memcpy(&dst[(size_t)n * i], &src[(size_t)ld * b->order[i]],
+                n * sizeof(float));
+    }
+}
+
+
+void ucd_buckets_scatter(const ucd_buckets* b,
+        const float* src, int n, float* dst, int ld)
+{
+    int i;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < b->num_cells; ++i) {
+        memcpy(&dst[(size_t)ld * b->order[i]], &src[(size_t)n * i],
+                n * sizeof(float));
+    }
+}
@@ -0,0 +1,645 @@
+/**
+ * @file ucd_checksum.c
+ * @brief Functions relate to checksums of sections of a binary file.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ *
+ * The trailer follows the last section of a binary file.  It is CRC32C
+ * of sections, the number of sections and #UCD_CHECKSUM_TAG.  Sections
+ * of classic and extended encodings are the header, cells, node list,
+ * coordinates, node data and cell data.  The chunked container is a
+ * section.
+ *
+ * Checksums are computed from the bytes read or written through a
+ * context while it is tracked, and only sections of which some bytes
+ * were not seen are read again.  Runs of bytes out of order, such as
+ * blocks of threads or rows written by blocks, are combined by the
+ * algebra of CRC.
+ */
+
+#include "ucd_private.h"
+#include <limits.h>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/** The size in bytes of blocks to compute checksums. */
+#define UCD_CHECKSUM_BLOCK (1 << 20)
+
+/** The reflected Castagnoli polynomial. */
+#define UCD_CRC32C_POLY 0x82f63b78U
+
+#ifndef __SSE4_2__
+/* slicing-by-8 tables of the polynomial */
+static unsigned int _ucd_crc32c_table[8][256];
+#endif
+
+/* x^(2^k) modulo the polynomial to combine checksums */
+static unsigned int _ucd_crc32c_x2n[32];
+static int _ucd_crc32c_ready = 0;
+
+
+/* product of polynomials modulo the polynomial, in reflected bits */
+static unsigned int _ucd_crc32c_multiply(unsigned int a, unsigned int b)
+{
+    unsigned int m, p;
+
+    m = 1U << 31;
+    p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ UCD_CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+
+static void _ucd_crc32c_build(void)
+{
+    unsigned int p;
+    int n;
+#ifndef __SSE4_2__
+    unsigned int crc;
+    int i, j;
+
+    for (i = 0; i < 256; ++i) {
+        crc = i;
+        for (j = 0; j < 8; ++j) {
+            crc = crc & 1 ? (crc >> 1) ^ UCD_CRC32C_POLY : crc >> 1;
+        }
+        _ucd_crc32c_table[0][i] = crc;
+    }
+    for (i = 0; i < 256; ++i) {
+        crc = _ucd_crc32c_table[0][i];
+        for (j = 1; j < 8; ++j) {
+            crc = _ucd_crc32c_table[0][crc & 0xff] ^ (crc >> 8);
+            _ucd_crc32c_table[j][i] = crc;
+        }
+    }
+#endif
+
+    p = 1U << 30; /* x^1 */
+    _ucd_crc32c_x2n[0] = p;
+    for (n = 1; n < 32; ++n) {
+        p = _ucd_crc32c_multiply(p, p);
+        _ucd_crc32c_x2n[n] = p;
+    }
+    _ucd_crc32c_ready = 1;
+}
+
+
+void _ucd_crc32c_init(void)
+{
+    /* tables are built once even if threads of callers come at once */
+#ifdef _OPENMP
+#pragma omp critical(_ucd_crc32c)
+#endif
+    {
+        if (!_ucd_crc32c_ready) {
+            _ucd_crc32c_build();
+        }
+    }
+}
+
+
+/* CRC32C of bytes of @p crc1 followed by @p size2 bytes of @p crc2 */
+static unsigned int _ucd_crc32c_combine(unsigned int crc1,
+        unsigned int crc2, long size2)
+{
+    unsigned int p;
+    int k;
+
+    /* x^(8 * size2) */
+    p = 1U << 31;
+    for (k = 3; size2 > 0; size2 >>= 1, ++k) {
+        if (size2 & 1) {
+            p = _ucd_crc32c_multiply(_ucd_crc32c_x2n[k & 31], p);
+        }
+    }
+    return _ucd_crc32c_multiply(p, crc1) ^ crc2;
+}
+
+
+unsigned int _ucd_crc32c(unsigned int crc, const void* data, size_t size)
+{
+    const unsigned char* p;
+    unsigned int w0, w1;
+
+    p = data;
+    crc = ~crc;
+#ifdef __SSE4_2__
+    for (; size >= 8; size -= 8, p += 8) {
+        memcpy(&w0, p, 4);
+        memcpy(&w1, p + 4, 4);
+        crc = _mm_crc32_u32(crc, w0);
+        crc = _mm_crc32_u32(crc, w1);
+    }
+    for (; size > 0; --size, ++p) {
+        crc = _mm_crc32_u8(crc, *p);
+    }
+#else
+    /* words are composed of bytes, so it is independent of byte order */
+    for (; size >= 8; size -= 8, p += 8) {
+        w0 = crc ^ ((unsigned int)p[0] | (unsigned int)p[1] << 8
+                | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24);
+        w1 = (unsigned int)p[4] | (unsigned int)p[5] << 8
+            | (unsigned int)p[6] << 16 | (unsigned int)p[7] << 24;
+        crc = _ucd_crc32c_table[7][w0 & 0xff]
+            ^ _ucd_crc32c_table[6][(w0 >> 8) & 0xff]
+            ^ _ucd_crc32c_table[5][(w0 >> 16) & 0xff]
+            ^ _ucd_crc32c_table[4][w0 >> 24]
+            ^ _ucd_crc32c_table[3][w1 & 0xff]
+            ^ _ucd_crc32c_table[2][(w1 >> 8) & 0xff]
+            ^ _ucd_crc32c_table[1][(w1 >> 16) & 0xff]
+            ^ _ucd_crc32c_table[0][w1 >> 24];
+    }
+    for (; size > 0; --size, ++p) {
+        crc = _ucd_crc32c_table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+#endif
+    return ~crc & 0xffffffffU;
+}
+
+
+int _ucd_checksum_sections(const ucd_context* c, long end, long* bounds)
+{
+    ucd_binary_layout layout;
+
+    bounds[0] = 0;
+    if (c->chunk_rows > 0) {
+        bounds[1] = end;
+        return 1;
+    }
+    _ucd_binary_layout(c, &layout);
+    bounds[1] = layout.cells;
+    bounds[2] = layout.nlist;
+    bounds[3] = layout.coords;
+    bounds[4] = layout.header[0];
+    bounds[5] = layout.header[1];
+    bounds[6] = layout.end;
+    return UCD_CHECKSUM_SECTIONS;
+}
+
+
+long _ucd_checksum_find(FILE* fp, int* num_sections)
+{
+    int trailer[2];
+    long size;
+
+    *num_sections = 0;
+    if (fseek(fp, 0, SEEK_END)) {
+        return -1;
+    }
+    size = ftell(fp);
+    if (size < (long)sizeof(trailer)
+            || fseek(fp, size - (long)sizeof(trailer), SEEK_SET)
+            || fread(trailer, sizeof(int), 2, fp) != 2) {
+        return size;
+    }
+    if (trailer[1] != UCD_CHECKSUM_TAG || trailer[0] < 1
+            || trailer[0] > UCD_CHECKSUM_SECTIONS) {
+        return size;
+    }
+    *num_sections = trailer[0];
+    return size - (long)sizeof(trailer) - trailer[0] * (long)sizeof(int);
+}
+
+
+struct ucd_crc_log* _ucd_crc_log_alloc(int is_writer)
+{
+    struct ucd_crc_log* log;
+
+    log = malloc(sizeof(*log));
+    if (log == NULL) {
+        return NULL;
+    }
+    log->run.first = -1;
+    log->run.last = -1;
+    log->run.crc = 0;
+    log->spans = NULL;
+    log->num_spans = 0;
+    log->max_spans = 0;
+    log->is_writer = is_writer;
+    log->has_error = 0;
+    _ucd_crc32c_init();
+    return log;
+}
+
+
+void _ucd_crc_log_free(struct ucd_crc_log* log)
+{
+    if (log != NULL) {
+        free(log->spans);
+        free(log);
+    }
+}
+
+
+static void _ucd_crc_log_push(struct ucd_crc_log* log,
+        const struct ucd_crc_span* span, int count)
+{
+    struct ucd_crc_span* spans;
+    int max_spans;
+
+    if (log->num_spans + count > log->max_spans) {
+        max_spans = 2 * log->max_spans > log->num_spans + count
+            ? 2 * log->max_spans : log->num_spans + count + 64;
+        spans = realloc(log->spans, max_spans * sizeof(*spans));
+        if (spans == NULL) {
+            log->has_error = 1;
+            return;
+        }
+        log->spans = spans;
+        log->max_spans = max_spans;
+    }
+    memcpy(&log->spans[log->num_spans], span, count * sizeof(*span));
+    log->num_spans += count;
+}
+
+
+/* the current run is kept as a span */
+static void _ucd_crc_log_end_run(struct ucd_crc_log* log)
+{
+    if (log->run.first >= 0 && log->run.last > log->run.first) {
+        _ucd_crc_log_push(log, &log->run, 1);
+    }
+    log->run.first = -1;
+    log->run.last = -1;
+    log->run.crc = 0;
+}
+
+
+void _ucd_crc_log_feed(struct ucd_crc_log* log, const ucd_context* c,
+        long offset, const void* data, size_t size)
+{
+    long bounds[UCD_CHECKSUM_SECTIONS + 1];
+    const unsigned char* p;
+    long last;
+    int num_sections, is_bound, i;
+
+    if (offset < 0) {
+        _ucd_crc_log_end_run(log);
+        return;
+    }
+    num_sections = _ucd_checksum_sections(c, LONG_MAX, bounds);
+    for (p = data; size > 0; p += last - offset, offset = last) {
+        last = offset + (long)size;
+        is_bound = 0;
+        for (i = 0; i <= num_sections; ++i) {
+            if (bounds[i] > offset && bounds[i] < last) {
+                last = bounds[i];
+            }
+            is_bound |= bounds[i] == offset;
+        }
+        if (is_bound || log->run.last != offset) {
+            _ucd_crc_log_end_run(log);
+            log->run.first = offset;
+        }
+        log->run.crc = _ucd_crc32c(log->run.crc, p, (size_t)(last - offset));
+        log->run.last = last;
+        size -= (size_t)(last - offset);
+    }
+}
+
+
+void _ucd_crc_log_merge(struct ucd_crc_log* log, struct ucd_crc_log* from)
+{
+    _ucd_crc_log_end_run(from);
+    _ucd_crc_log_push(log, from->spans, from->num_spans);
+    log->has_error |= from->has_error;
+    _ucd_crc_log_free(from);
+}
+
+
+static int _ucd_compare_span(const void* a, const void* b)
+{
+    const struct ucd_crc_span* x = a;
+    const struct ucd_crc_span* y = b;
+
+    /* longer spans first at the same offset */
+    if (x->first != y->first) {
+        return x->first < y->first ? -1 : 1;
+    }
+    return x->last > y->last ? -1 : x->last < y->last;
+}
+
+
+/*
+ * Spans in each section are combined from its beginning.  Spans read
+ * again are skipped, but spans written twice are not known to be the
+ * last one, and a section with a gap or such overlap is not known.
+ */
+static void _ucd_crc_log_sections(struct ucd_crc_log* log,
+        int num_sections, const long* bounds, unsigned int* crcs, int* known)
+{
+    const struct ucd_crc_span *span, *prev;
+    long pos;
+    int i, j;
+
+    if (log == NULL) {
+        for (i = 0; i < num_sections; ++i) {
+            known[i] = 0;
+        }
+        return;
+    }
+    _ucd_crc_log_end_run(log);
+    if (log->num_spans > 1) {
+        qsort(log->spans, log->num_spans, sizeof(*log->spans),
+                _ucd_compare_span);
+    }
+
+    j = 0;
+    for (i = 0; i < num_sections; ++i) {
+        pos = bounds[i];
+        crcs[i] = 0;
+        known[i] = !log->has_error;
+        prev = NULL;
+        for (; j < log->num_spans && log->spans[j].first < bounds[i + 1];
+                ++j) {
+            span = &log->spans[j];
+            if (span->last <= bounds[i]) {
+                continue;
+            }
+            if (span->first == pos) {
+                crcs[i] = _ucd_crc32c_combine(crcs[i],
+                        span->crc, span->last - span->first);
+                pos = span->last;
+                prev = span;
+            } else if (prev != NULL && span->first == prev->first
+                    && span->last == prev->last && span->crc == prev->crc) {
+                continue;
+            } else if (span->first > pos || span->last > pos
+                    || log->is_writer) {
+                known[i] = 0;
+            }
+        }
+        known[i] = known[i] && pos == bounds[i + 1];
+    }
+}
+
+
+void _ucd_checksum_track(ucd_context* c)
+{
+    unsigned char header[64];
+    long pos;
+    size_t n;
+
+    if (!c->is_binary || !c->checksum || c->_crc_log != NULL) {
+        return;
+    }
+    c->_crc_log = _ucd_crc_log_alloc(c->_is_writer);
+    if (c->_crc_log == NULL || c->_is_writer) {
+        return;
+    }
+    pos = ftell(c->_fp);
+    if (pos > 0 && pos <= (long)sizeof(header) && !fseek(c->_fp, 0, SEEK_SET)) {
+        n = _ucd_checksum_fread(c, header, 1, (size_t)pos);
+        fseek(c->_fp, pos, SEEK_SET);
+        if (n != (size_t)pos) {
+            c->_crc_log->has_error = 1;
+        }
+    }
+}
+
+
+void _ucd_checksum_untrack(ucd_context* c)
+{
+    if (c->_crc_log == NULL) {
+        return;
+    }
+    if (c->_owner != NULL && c->_owner->_crc_log != NULL) {
+#ifdef _OPENMP
+#pragma omp critical(_ucd_crc32c)
+#endif
+        _ucd_crc_log_merge(c->_owner->_crc_log, c->_crc_log);
+    } else {
+        _ucd_crc_log_free(c->_crc_log);
+    }
+    c->_crc_log = NULL;
+}
+
+
+size_t _ucd_checksum_fread(ucd_context* c,
+        void* data, size_t size, size_t count)
+{
+    long offset;
+    size_t n;
+
+    /* a writer knows bytes only by writing them */
+    if (c->_crc_log == NULL || c->_crc_log->is_writer) {
+        return fread(data, size, count, c->_fp);
+    }
+    offset = ftell(c->_fp);
+    n = fread(data, size, count, c->_fp);
+    _ucd_crc_log_feed(c->_crc_log, c, offset, data, n * size);
+    return n;
+}
+
+
+size_t _ucd_checksum_fwrite(ucd_context* c,
+        const void* data, size_t size, size_t count)
+{
+    long offset;
+    size_t n;
+
+    if (c->_crc_log == NULL) {
+        return fwrite(data, size, count, c->_fp);
+    }
+    offset = ftell(c->_fp);
+    n = fwrite(data, size, count, c->_fp);
+    _ucd_crc_log_feed(c->_crc_log, c, offset, data, n * size);
+    return n;
+}
+
+
+/* checksum of a range of a file */
+static int _ucd_checksum_range(FILE* fp, long first, long last,
+        unsigned char* buffer, unsigned int* crc)
+{
+    size_t size;
+
+    *crc = 0;
+    if (fseek(fp, first, SEEK_SET)) {
+        return EXIT_FAILURE;
+    }
+    for (; first < last; first += (long)size) {
+        size = last - first < UCD_CHECKSUM_BLOCK
+            ? (size_t)(last - first) : UCD_CHECKSUM_BLOCK;
+        if (fread(buffer, 1, size, fp) != size) {
+            return EXIT_FAILURE;
+        }
+        *crc = _ucd_crc32c(*crc, buffer, size);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int _ucd_checksum_write(ucd_context* c)
+{
+    unsigned int crcs[UCD_CHECKSUM_SECTIONS];
+    int known[UCD_CHECKSUM_SECTIONS];
+    int trailer[2];
+    long bounds[UCD_CHECKSUM_SECTIONS + 1];
+    long end;
+    unsigned char* buffer;
+    int num_sections, has_error, i;
+
+    /* the chunked container ends where it is written to */
+    fflush(c->_fp);
+    fseek(c->_fp, 0, SEEK_END);
+    end = ftell(c->_fp);
+    num_sections = _ucd_checksum_sections(c, end, bounds);
+    _ucd_crc_log_sections(c->_crc_log, num_sections, bounds, crcs, known);
+
+    /* sections not written wholly through the context are read back */
+    buffer = NULL;
+    has_error = EXIT_SUCCESS;
+    for (i = 0; i < num_sections && !has_error; ++i) {
+        if (known[i]) {
+            continue;
+        }
+        if (buffer == NULL) {
+            buffer = malloc(UCD_CHECKSUM_BLOCK);
+            if (buffer == NULL) {
+                fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+                return EXIT_FAILURE;
+            }
+            _ucd_crc32c_init();
+        }
+        has_error = _ucd_checksum_range(c->_fp, bounds[i], bounds[i + 1],
+                buffer, &crcs[i]);
+    }
+    free(buffer);
+    if (has_error) {
+        fprintf(stderr, "%s: cannot read sections\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    trailer[0] = num_sections;
+    trailer[1] = UCD_CHECKSUM_TAG;
+    fseek(c->_fp, bounds[num_sections], SEEK_SET);
+    fwrite(crcs, sizeof(int), num_sections, c->_fp);
+    fwrite(trailer, sizeof(int), 2, c->_fp);
+
+    return ferror(c->_fp);
+}
+
+
+/*
+ * Checksums of sections of a file are compared with those in the log,
+ * and sections which are not known from the log are read again by
+ * threads with their own file handles.
+ */
+static int _ucd_checksum_check(const ucd_context* c, const char* filename,
+        FILE* fp, struct ucd_crc_log* log)
+{
+    unsigned int crcs[UCD_CHECKSUM_SECTIONS];
+    unsigned int logged[UCD_CHECKSUM_SECTIONS];
+    int known[UCD_CHECKSUM_SECTIONS];
+    long bounds[UCD_CHECKSUM_SECTIONS + 1];
+    long end;
+    int num_sections, num_stored, has_error, i;
+
+    end = _ucd_checksum_find(fp, &num_stored);
+    if (num_stored == 0) {
+        return EXIT_SUCCESS;
+    }
+    num_sections = _ucd_checksum_sections(c, end, bounds);
+    if (num_sections != num_stored || bounds[num_sections] != end
+            || fseek(fp, end, SEEK_SET)
+            || fread(crcs, sizeof(int), num_sections, fp)
+                != (size_t)num_sections) {
+        fprintf(stderr, "%s: %s has wrong size\n", __func__, filename);
+        return EXIT_FAILURE;
+    }
+
+    has_error = EXIT_SUCCESS;
+    _ucd_crc_log_sections(log, num_sections, bounds, logged, known);
+    for (i = 0; i < num_sections; ++i) {
+        if (known[i] && logged[i] != crcs[i]) {
+            fprintf(stderr, "%s: section %d of %s is broken\n",
+                    __func__, i, filename);
+            has_error = EXIT_FAILURE;
+        }
+    }
+
+    _ucd_crc32c_init();
+#ifdef _OPENMP
+#pragma omp parallel private(fp) reduction(|:has_error)
+#endif
+    {
+        unsigned char* buffer;
+        unsigned int crc;
+
+        buffer = NULL;
+        fp = NULL;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (i = 0; i < num_sections; ++i) {
+            if (known[i]) {
+                continue;
+            }
+            if (buffer == NULL && fp == NULL) {
+                buffer = malloc(UCD_CHECKSUM_BLOCK);
+                fp = fopen(filename, "rb");
+            }
+            if (buffer == NULL || fp == NULL) {
+                fprintf(stderr, "%s: cannot read %s\n", __func__, filename);
+                has_error = EXIT_FAILURE;
+                continue;
+            }
+            if (_ucd_checksum_range(fp, bounds[i], bounds[i + 1],
+                        buffer, &crc) || crc != crcs[i]) {
+                fprintf(stderr, "%s: section %d of %s is broken\n",
+                        __func__, i, filename);
+                has_error = EXIT_FAILURE;
+            }
+        }
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        free(buffer);
+    }
+
+    return has_error;
+}
+
+
+int _ucd_checksum_verify(ucd_context* c, const char* filename)
+{
+    if (!c->is_binary || !c->checksum) {
+        return EXIT_SUCCESS;
+    }
+    return _ucd_checksum_check(c, filename, c->_fp, c->_crc_log);
+}
+
+
+int ucd_verify_checksum(const ucd_context* c, const char* filename)
+{
+    int has_error;
+    FILE* fp;
+
+    if (!c->is_binary) {
+        return EXIT_SUCCESS;
+    }
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+        return EXIT_FAILURE;
+    }
+    has_error = _ucd_checksum_check(c, filename, fp, NULL);
+    fclose(fp);
+    return has_error;
+}
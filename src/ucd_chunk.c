@@ -0,0 +1,475 @@
+/**
+ * @file ucd_chunk.c
+ * @brief Functions relate to the chunked binary container.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ *
+ * The chunked container has the same header, cells and node list as the
+ * binary format, with the number of rows per chunk in place of the number
+ * of model data.  Coordinates and each column of node and cell data are
+ * split into chunks of rows.  A section of columns is a directory of all
+ * chunks followed by encoded values of the chunks in the same order.
+ * An entry of the directory is the codec, the size in bytes, the minimum
+ * and the maximum of the chunk other than NaN.  Values of a chunk are
+ * omitted if the minimum and the maximum are the same, and chunks with
+ * NaN or infinity are stored as floats whatever the codec.  The codec of
+ * a chunk with NaN has #UCD_CHUNK_FLAG_NAN.
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/** Size in bytes of an entry of the directory. */
+#define UCD_CHUNK_ENTRY_SIZE (2 * sizeof(int) + 2 * sizeof(float))
+
+
+int _ucd_num_chunks(const ucd_context* c, int num_rows)
+{
+    return (num_rows + c->chunk_rows - 1) / c->chunk_rows;
+}
+
+
+/* size in bytes of the file, or -1 */
+static long _ucd_chunk_file_size(FILE* fp)
+{
+    long pos, size;
+
+    pos = ftell(fp);
+    if (pos < 0 || fseek(fp, 0, SEEK_END)) {
+        return -1;
+    }
+    size = ftell(fp);
+    if (fseek(fp, pos, SEEK_SET)) {
+        return -1;
+    }
+    return size;
+}
+
+
+ucd_chunk* _ucd_chunk_directory(ucd_context* c, long offset,
+        int num_cols, int num_rows, long* end)
+{
+    ucd_chunk* chunks;
+    long file_size;
+    int num_chunks, has_error, i, j, k;
+    int entry[2];
+    float range[2];
+
+    /* entries are read from the file, so they are checked against it */
+    num_chunks = _ucd_num_chunks(c, num_rows);
+    file_size = _ucd_chunk_file_size(c->_fp);
+    if (file_size < 0 || offset < 0 || offset > file_size
+            || (double)num_cols * num_chunks * UCD_CHUNK_ENTRY_SIZE
+                > file_size - offset) {
+        fprintf(stderr, "%s: directory is out of the file\n", __func__);
+        return NULL;
+    }
+    chunks = malloc(((size_t)num_cols * num_chunks + 1) * sizeof(*chunks));
+    if (chunks == NULL) {
+        fprintf(stderr, "%s: cannot allocate chunks\n", __func__);
+        return NULL;
+    }
+
+    has_error = fseek(c->_fp, offset, SEEK_SET);
+    offset += (long)num_cols * num_chunks * UCD_CHUNK_ENTRY_SIZE;
+    for (j = 0; j < num_cols && !has_error; ++j) {
+        for (k = 0; k < num_chunks && !has_error; ++k) {
+            i = num_chunks * j + k;
+            if (_ucd_checksum_fread(c, entry, sizeof(int), 2) != 2
+                    || _ucd_checksum_fread(c, range, sizeof(float), 2) != 2) {
+                fprintf(stderr, "%s: cannot read directory\n", __func__);
+                has_error = EXIT_FAILURE;
+                break;
+            }
+            chunks[i].first_row = c->chunk_rows * k;
+            chunks[i].num_rows = num_rows - chunks[i].first_row;
+            if (chunks[i].num_rows > c->chunk_rows) {
+                chunks[i].num_rows = c->chunk_rows;
+            }
+            chunks[i].codec = entry[0] & ~UCD_CHUNK_FLAG_NAN;
+            chunks[i].has_nan = (entry[0] & UCD_CHUNK_FLAG_NAN) != 0;
+            chunks[i].size = entry[1];
+            chunks[i].minimum = range[0];
+            chunks[i].maximum = range[1];
+            chunks[i].offset = offset;
+            if (chunks[i].codec < UCD_ENCODING_FLOAT32
+                    || chunks[i].codec > UCD_ENCODING_UINT8) {
+                fprintf(stderr, "%s: unknown codec %d\n", __func__, entry[0]);
+                has_error = EXIT_FAILURE;
+            } else if (entry[1] != 0 && entry[1] != chunks[i].num_rows
+                    * _ucd_encoding_size(chunks[i].codec)) {
+                fprintf(stderr, "%s: wrong chunk size %d\n",
+                        __func__, entry[1]);
+                has_error = EXIT_FAILURE;
+            } else if (entry[1] > file_size - offset) {
+                fprintf(stderr, "%s: chunk is out of the file\n", __func__);
+                has_error = EXIT_FAILURE;
+            }
+            offset += entry[1];
+        }
+    }
+    *end = offset;
+
+    if (has_error || ferror(c->_fp)) {
+        free(chunks);
+        return NULL;
+    }
+    return chunks;
+}
+
+
+long _ucd_chunk_end(ucd_context* c)
+{
+    ucd_chunk* chunks;
+    long offset;
+    int num_data, i;
+
+    offset = sizeof(char) + 6 * sizeof(int)
+        + 4 * (long)c->num_cells * sizeof(int)
+        + (long)c->num_nlist * sizeof(int);
+    chunks = _ucd_chunk_directory(c, offset, 3, c->num_nodes, &offset);
+    for (i = 0; i < 2 && chunks != NULL; ++i) {
+        num_data = i == 0 ? c->num_ndata : c->num_cdata;
+        if (num_data == 0) {
+            continue;
+        }
+        free(chunks);
+        offset += 2 * UCD_TEXT_FIELD_SIZE * sizeof(char)
+            + sizeof(int) + num_data * sizeof(int)
+            + 2 * num_data * sizeof(float);
+        chunks = _ucd_chunk_directory(c, offset, num_data,
+                i == 0 ? c->num_nodes : c->num_cells, &offset);
+    }
+    if (chunks == NULL) {
+        return -1;
+    }
+    free(chunks);
+    return offset;
+}
+
+
+static void _ucd_chunk_decode(const ucd_chunk* chunk, const void* src,
+        float* data, int ld_data)
+{
+    int i;
+
+    if (chunk->size == 0) {
+        for (i = 0; i < chunk->num_rows; ++i) {
+            data[ld_data * i] = chunk->minimum;
+        }
+    } else {
+        _ucd_decode(chunk->codec, src, chunk->num_rows, 1,
+                &chunk->minimum, &chunk->maximum, data, ld_data);
+    }
+}
+
+
+int _ucd_chunk_read_body(ucd_context* c, int num_cols, int num_rows,
+        float** cols, const int* lds)
+{
+    ucd_chunk* chunks;
+    char* buffer;
+    long end, size, max_size;
+    int num_chunks, cancelled, j, k;
+
+    chunks = _ucd_chunk_directory(c, ftell(c->_fp), num_cols, num_rows, &end);
+    if (chunks == NULL) {
+        return EXIT_FAILURE;
+    }
+    num_chunks = _ucd_num_chunks(c, num_rows);
+    if (cols == NULL) {
+        free(chunks);
+        fseek(c->_fp, end, SEEK_SET);
+        return ferror(c->_fp);
+    }
+
+    max_size = 0;
+    for (j = 0; j < num_cols && num_chunks > 0; ++j) {
+        size = j + 1 < num_cols
+            ? chunks[num_chunks * (j + 1)].offset : end;
+        size -= chunks[num_chunks * j].offset;
+        max_size = size > max_size ? size : max_size;
+    }
+    buffer = malloc(max_size > 0 ? max_size : 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "%s: cannot allocate buffer\n", __func__);
+        free(chunks);
+        return EXIT_FAILURE;
+    }
+
+    /* values of a column are read at once and chunks are decoded */
+    cancelled = 0;
+    for (j = 0; j < num_cols && num_chunks > 0 && !cancelled; ++j) {
+        size = j + 1 < num_cols
+            ? chunks[num_chunks * (j + 1)].offset : end;
+        size -= chunks[num_chunks * j].offset;
+        if (_ucd_checksum_fread(c, buffer, 1, size) != (size_t)size) {
+            fprintf(stderr, "%s: cannot read chunks\n", __func__);
+            free(buffer);
+            free(chunks);
+            return EXIT_FAILURE;
+        }
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (k = 0; k < num_chunks; ++k) {
+            _ucd_chunk_decode(&chunks[num_chunks * j + k],
+                    buffer + (chunks[num_chunks * j + k].offset
+                        - chunks[num_chunks * j].offset),
+                    &cols[j][lds[j] * chunks[num_chunks * j + k].first_row],
+                    lds[j]);
+        }
+        cancelled = _ucd_progress(c, size, num_rows);
+    }
+
+    free(buffer);
+    free(chunks);
+    fseek(c->_fp, end, SEEK_SET);
+    return ferror(c->_fp) || cancelled;
+}
+
+
+int _ucd_chunk_write_body(ucd_context* c, int num_cols, int num_rows,
+        const float** cols, const int* lds, int codec)
+{
+    ucd_chunk* chunks;
+    char* buffer;
+    long directory, end, size;
+    int num_chunks, entry[2], cancelled, i, j, k;
+    float range[2];
+    ucd_chunk* chunk;
+
+    num_chunks = _ucd_num_chunks(c, num_rows);
+    cancelled = 0;
+    chunks = malloc(((size_t)num_cols * num_chunks + 1) * sizeof(*chunks));
+    buffer = malloc((long)num_rows * sizeof(float) + 1);
+    if (chunks == NULL || buffer == NULL) {
+        fprintf(stderr, "%s: cannot allocate buffer\n", __func__);
+        free(chunks);
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+
+    /* the directory is written after values */
+    directory = ftell(c->_fp);
+    fseek(c->_fp, (long)num_cols * num_chunks * UCD_CHUNK_ENTRY_SIZE, SEEK_CUR);
+
+    /*
+     * chunks are encoded at offsets of floats, since chunks which cannot
+     * be quantized are stored as floats
+     */
+    for (j = 0; j < num_cols; ++j) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (k = 0; k < num_chunks; ++k) {
+            ucd_chunk* ck;
+            const float* p;
+            float v;
+            int has_nonfinite, n;
+
+            ck = &chunks[num_chunks * j + k];
+            ck->first_row = c->chunk_rows * k;
+            ck->num_rows = num_rows - ck->first_row;
+            if (ck->num_rows > c->chunk_rows) {
+                ck->num_rows = c->chunk_rows;
+            }
+            p = &cols[j][lds[j] * ck->first_row];
+
+            /* the range is of values other than NaN */
+            ck->minimum = ck->maximum = p[0];
+            ck->has_nan = 0;
+            has_nonfinite = 0;
+            for (n = 0; n < ck->num_rows; ++n) {
+                v = p[lds[j] * n];
+                if (!(v - v == 0)) {
+                    has_nonfinite = 1;
+                }
+                if (v != v) {
+                    ck->has_nan = 1;
+                    continue;
+                }
+                if (ck->minimum != ck->minimum || v < ck->minimum) {
+                    ck->minimum = v;
+                }
+                if (ck->maximum != ck->maximum || v > ck->maximum) {
+                    ck->maximum = v;
+                }
+            }
+
+            /* NaN and infinity are kept only by floats */
+            ck->codec = codec;
+            if (has_nonfinite || (codec != UCD_ENCODING_FLOAT32
+                        && codec != UCD_ENCODING_FLOAT16
+                        && !_ucd_range_is_finite(ck->minimum, ck->maximum))) {
+                ck->codec = UCD_ENCODING_FLOAT32;
+            }
+            ck->size = 0;
+            if (has_nonfinite || ck->minimum != ck->maximum) {
+                ck->size = ck->num_rows * _ucd_encoding_size(ck->codec);
+                _ucd_encode(ck->codec, p, lds[j], ck->num_rows, 1,
+                        &ck->minimum, &ck->maximum,
+                        buffer + (long)ck->first_row * sizeof(float));
+            }
+        }
+        size = 0;
+        for (k = 0; k < num_chunks; ++k) {
+            chunk = &chunks[num_chunks * j + k];
+            _ucd_checksum_fwrite(c,
+                    buffer + (long)chunk->first_row * sizeof(float),
+                    1, chunk->size);
+            size += chunk->size;
+        }
+        cancelled = _ucd_progress(c, size, num_rows);
+        if (cancelled) {
+            break;
+        }
+    }
+    end = ftell(c->_fp);
+    if (cancelled) {
+        free(chunks);
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+
+    fseek(c->_fp, directory, SEEK_SET);
+    for (i = 0; i < num_cols * num_chunks; ++i) {
+        entry[0] = chunks[i].codec
+            | (chunks[i].has_nan ? UCD_CHUNK_FLAG_NAN : 0);
+        entry[1] = chunks[i].size;
+        range[0] = chunks[i].minimum;
+        range[1] = chunks[i].maximum;
+        _ucd_checksum_fwrite(c, entry, sizeof(int), 2);
+        _ucd_checksum_fwrite(c, range, sizeof(float), 2);
+    }
+    fseek(c->_fp, end, SEEK_SET);
+
+    free(chunks);
+    free(buffer);
+    return ferror(c->_fp);
+}
+
+
+ucd_chunk* ucd_read_chunk_map(ucd_context* c, int section, int* num_chunks)
+{
+    ucd_chunk* chunks;
+    long offset;
+    int num_rows, num_data, i;
+
+    if (c->chunk_rows <= 0) {
+        fprintf(stderr, "%s: file is not chunked\n", __func__);
+        return NULL;
+    }
+    if (section < UCD_CHUNK_COORDS || section > UCD_CHUNK_CDATA
+            || (section == UCD_CHUNK_NDATA && c->num_ndata == 0)
+            || (section == UCD_CHUNK_CDATA && c->num_cdata == 0)) {
+        fprintf(stderr, "%s: section %d is invalid\n", __func__, section);
+        return NULL;
+    }
+
+    /* walk sections from coordinates */
+    offset = sizeof(char) + 6 * sizeof(int)
+        + 4 * (long)c->num_cells * sizeof(int)
+        + (long)c->num_nlist * sizeof(int);
+    chunks = _ucd_chunk_directory(c, offset, 3, c->num_nodes, &offset);
+    for (i = UCD_CHUNK_NDATA; i <= section && chunks != NULL; ++i) {
+        num_rows = i == UCD_CHUNK_NDATA ? c->num_nodes : c->num_cells;
+        num_data = i == UCD_CHUNK_NDATA ? c->num_ndata : c->num_cdata;
+        if (num_data == 0) {
+            continue;
+        }
+        free(chunks);
+        offset += 2 * UCD_TEXT_FIELD_SIZE * sizeof(char)
+            + sizeof(int) + num_data * sizeof(int)
+            + 2 * num_data * sizeof(float);
+        chunks = _ucd_chunk_directory(c, offset, num_data, num_rows, &offset);
+    }
+
+    if (chunks != NULL) {
+        *num_chunks = _ucd_num_chunks(c,
+                section == UCD_CHUNK_CDATA ? c->num_cells : c->num_nodes);
+    }
+    return chunks;
+}
+
+
+int ucd_read_chunk(ucd_context* c, const ucd_chunk* chunk,
+        float* data, int ld_data)
+{
+    void* buffer;
+
+    buffer = malloc(chunk->size + 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "%s: cannot allocate buffer\n", __func__);
+        return EXIT_FAILURE;
+    }
+    if (fseek(c->_fp, chunk->offset, SEEK_SET)
+            || _ucd_checksum_fread(c, buffer, 1, chunk->size)
+                != (size_t)chunk->size) {
+        fprintf(stderr, "%s: cannot read chunk\n", __func__);
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+    _ucd_chunk_decode(chunk, buffer, data, ld_data);
+    free(buffer);
+
+    return ferror(c->_fp);
+}
+
+
+/* pointers to columns of data */
+static int _ucd_chunk_columns(const ucd_data* d, float*** cols, int** lds)
+{
+    int j;
+
+    *cols = malloc((d->num_data + 1) * sizeof(**cols));
+    *lds = malloc((d->num_data + 1) * sizeof(**lds));
+    if (*cols == NULL || *lds == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(*cols);
+        free(*lds);
+        return EXIT_FAILURE;
+    }
+    for (j = 0; j < d->num_data; ++j) {
+        (*cols)[j] = ucd_data_column(d, j, &(*lds)[j]);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int _ucd_chunk_read_data(ucd_context* c, ucd_data* d)
+{
+    float** cols;
+    int* lds;
+    int has_error;
+
+    if (_ucd_chunk_columns(d, &cols, &lds)) {
+        return EXIT_FAILURE;
+    }
+    has_error = _ucd_chunk_read_body(c, d->num_data, d->num_rows, cols, lds);
+    free(cols);
+    free(lds);
+
+    return has_error;
+}
+
+
+int _ucd_chunk_write_data(ucd_context* c, const ucd_data* d)
+{
+    float** cols;
+    int* lds;
+    int has_error;
+
+    if (_ucd_chunk_columns(d, &cols, &lds)) {
+        return EXIT_FAILURE;
+    }
+    has_error = _ucd_chunk_write_body(c, d->num_data, d->num_rows,
+            (const float**)cols, lds, c->encoding);
+    free(cols);
+    free(lds);
+
+    return has_error;
+}
@@ -0,0 +1,253 @@
+/**
+ * @file ucd_cursor.c
+ * @brief Functions relate to reading a binary file by independent cursors.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+
+static int _ucd_cursor_read(ucd_cursor* cur, long offset,
+        void* data, size_t size, size_t count)
+{
+    if (fseek(cur->_fp, offset, SEEK_SET)
+            || fread(data, size, count, cur->_fp) != count) {
+        fprintf(stderr, "%s: cannot read at %ld\n", __func__, offset);
+        return EXIT_FAILURE;
+    }
+    if (cur->_crc_log != NULL) {
+        _ucd_crc_log_feed(cur->_crc_log, cur->context,
+                offset, data, size * count);
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/* components of node (0) and cell (1) data are read once */
+static int _ucd_cursor_components(ucd_cursor* cur)
+{
+    ucd_binary_layout layout;
+    int num_data, num_comp, sum, i, j;
+
+    _ucd_binary_layout(cur->context, &layout);
+    for (i = 0; i < 2; ++i) {
+        num_data = i == 0 ? cur->context->num_ndata : cur->context->num_cdata;
+        if (num_data == 0) {
+            continue;
+        }
+        if (_ucd_cursor_read(cur, layout.header[i] + 2 * UCD_TEXT_FIELD_SIZE,
+                    &num_comp, sizeof(int), 1)
+                || num_comp < 1 || num_comp > num_data) {
+            fprintf(stderr, "%s: wrong number of components\n", __func__);
+            return EXIT_FAILURE;
+        }
+        cur->_components[i] = malloc(num_comp * sizeof(int));
+        if (cur->_components[i] == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        cur->_num_comp[i] = num_comp;
+        if (_ucd_cursor_read(cur,
+                    layout.header[i] + 2 * UCD_TEXT_FIELD_SIZE + sizeof(int),
+                    cur->_components[i], sizeof(int), num_comp)) {
+            return EXIT_FAILURE;
+        }
+        sum = 0;
+        for (j = 0; j < num_comp; ++j) {
+            if (cur->_components[i][j] < 1) {
+                break;
+            }
+            sum += cur->_components[i][j];
+        }
+        if (j < num_comp || sum != num_data) {
+            fprintf(stderr, "%s: wrong components\n", __func__);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_cursor_open(ucd_cursor* cur, const ucd_context* c,
+        const char* filename)
+{
+    cur->context = c;
+    cur->_fp = NULL;
+    cur->_num_comp[0] = cur->_num_comp[1] = 0;
+    cur->_components[0] = cur->_components[1] = NULL;
+    cur->_crc_log = NULL;
+
+    if (!c->is_binary || c->chunk_rows > 0) {
+        fprintf(stderr, "%s: %s is not classic binary\n", __func__, filename);
+        return EXIT_FAILURE;
+    }
+
+    cur->_fp = fopen(filename, "rb");
+    if (cur->_fp == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+        return EXIT_FAILURE;
+    }
+
+    /* bytes read are passed to the log of the context at close */
+    if (c->_crc_log != NULL) {
+        cur->_crc_log = _ucd_crc_log_alloc(0);
+    }
+    if (_ucd_cursor_components(cur)) {
+        ucd_cursor_close(cur);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_cursor_close(ucd_cursor* cur)
+{
+    int has_error;
+
+    has_error = fclose(cur->_fp);
+    if (cur->_crc_log != NULL) {
+#ifdef _OPENMP
+#pragma omp critical(_ucd_crc32c)
+#endif
+        _ucd_crc_log_merge(cur->context->_crc_log, cur->_crc_log);
+        cur->_crc_log = NULL;
+    }
+    free(cur->_components[0]);
+    free(cur->_components[1]);
+    cur->_fp = NULL;
+    cur->_num_comp[0] = cur->_num_comp[1] = 0;
+    cur->_components[0] = cur->_components[1] = NULL;
+
+    return has_error;
+}
+
+
+int ucd_cursor_read_cells(ucd_cursor* cur, int first, int count, int* cells)
+{
+    ucd_binary_layout layout;
+
+    if (first < 0 || count < 0 || first + count > cur->context->num_cells) {
+        fprintf(stderr, "%s: cells are out of range\n", __func__);
+        return EXIT_FAILURE;
+    }
+    _ucd_binary_layout(cur->context, &layout);
+
+    return _ucd_cursor_read(cur, layout.cells + 4L * first * sizeof(int),
+            cells, sizeof(int), 4 * count);
+}
+
+
+int ucd_cursor_read_nlist(ucd_cursor* cur, int first, int count, int* nlist)
+{
+    ucd_binary_layout layout;
+
+    if (first < 0 || count < 0 || first + count > cur->context->num_nlist) {
+        fprintf(stderr, "%s: node list is out of range\n", __func__);
+        return EXIT_FAILURE;
+    }
+    _ucd_binary_layout(cur->context, &layout);
+
+    return _ucd_cursor_read(cur, layout.nlist + (long)first * sizeof(int),
+            nlist, sizeof(int), count);
+}
+
+
+int ucd_cursor_read_coords(ucd_cursor* cur, int axis,
+        int first, int count, float* coords)
+{
+    ucd_binary_layout layout;
+    int num_nodes;
+
+    num_nodes = cur->context->num_nodes;
+    if (axis < 0 || axis > 2 || first < 0 || count < 0
+            || first + count > num_nodes) {
+        fprintf(stderr, "%s: coordinates are out of range\n", __func__);
+        return EXIT_FAILURE;
+    }
+    _ucd_binary_layout(cur->context, &layout);
+
+    return _ucd_cursor_read(cur, layout.coords
+            + ((long)axis * num_nodes + first) * sizeof(float),
+            coords, sizeof(float), count);
+}
+
+
+int ucd_cursor_read_component(ucd_cursor* cur, int is_cell, int comp,
+        int first_row, int num_rows, float* data, int ld_data)
+{
+    const ucd_context* c;
+    ucd_binary_layout layout;
+    int rows, num_data, base, size, esize, has_error, i;
+    float *minima, *maxima;
+    void* buffer;
+    long offset;
+
+    c = cur->context;
+    rows = is_cell ? c->num_cells : c->num_nodes;
+    num_data = is_cell ? c->num_cdata : c->num_ndata;
+    if (first_row < 0 || num_rows < 0 || first_row + num_rows > rows) {
+        fprintf(stderr, "%s: rows are out of range\n", __func__);
+        return EXIT_FAILURE;
+    }
+    _ucd_binary_layout(c, &layout);
+    esize = _ucd_encoding_size(c->encoding);
+
+    /* offset of the component */
+    is_cell = is_cell != 0;
+    if (comp < 0 || comp >= cur->_num_comp[is_cell]) {
+        fprintf(stderr, "%s: component %d is invalid\n", __func__, comp);
+        return EXIT_FAILURE;
+    }
+    base = 0;
+    for (i = 0; i < comp; ++i) {
+        base += cur->_components[is_cell][i];
+    }
+    size = cur->_components[is_cell][comp];
+    has_error = EXIT_SUCCESS;
+    offset = layout.body[is_cell]
+        + ((long)rows * base + (long)first_row * size) * esize;
+
+    if (c->encoding == UCD_ENCODING_FLOAT32) {
+        if (ld_data == size) {
+            return _ucd_cursor_read(cur, offset,
+                    data, sizeof(float), num_rows * size);
+        }
+        for (i = 0; i < num_rows && !has_error; ++i) {
+            has_error = _ucd_cursor_read(cur,
+                    offset + (long)i * size * (long)sizeof(float),
+                    &data[ld_data * i], sizeof(float), size);
+        }
+        return has_error;
+    }
+
+    /* quantized data are decoded with minima and maxima of the columns */
+    minima = malloc(size * sizeof(*minima));
+    maxima = malloc(size * sizeof(*maxima));
+    buffer = malloc((long)num_rows * size * esize + 1);
+    if (minima == NULL || maxima == NULL || buffer == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        has_error = EXIT_FAILURE;
+    } else {
+        has_error = _ucd_cursor_read(cur,
+                layout.minmax[is_cell] + base * sizeof(float),
+                minima, sizeof(float), size)
+            || _ucd_cursor_read(cur,
+                layout.minmax[is_cell] + (num_data + base) * sizeof(float),
+                maxima, sizeof(float), size)
+            || _ucd_cursor_read(cur, offset, buffer, esize, num_rows * size);
+    }
+    if (!has_error) {
+        _ucd_decode(c->encoding, buffer, num_rows, size,
+                minima, maxima, data, ld_data);
+    }
+
+    free(minima);
+    free(maxima);
+    free(buffer);
+    return has_error;
+}
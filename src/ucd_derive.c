@@ -0,0 +1,255 @@
+/**
+ * @file ucd_derive.c
+ * @brief Functions relate to deriving components from existing ones.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include <math.h>
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+
+static const char* _ucd_component_text(const char* text, int comp)
+{
+    int i;
+
+    for (i = 0; i < comp; ++i) {
+        text += strlen(text) + 1;
+    }
+    return text;
+}
+
+
+/*
+ * Append a component and return pointers to the source and the new one.
+ * The source label and unit are copied before data are reallocated.
+ */
+static int _ucd_derive_prepare(ucd_data* d, int comp, int size,
+        const char* label, const char* suffix,
+        const float** src, int* ld_src, float** dst, int* ld_dst)
+{
+    char new_label[UCD_TEXT_FIELD_SIZE];
+    char new_unit[UCD_TEXT_FIELD_SIZE];
+
+    if (comp < 0 || comp >= d->num_comp) {
+        fprintf(stderr, "%s: component %d is invalid\n", __func__, comp);
+        return EXIT_FAILURE;
+    }
+
+    if (label != NULL) {
+        sprintf(new_label, "%.*s", UCD_TEXT_FIELD_SIZE - 1, label);
+    } else {
+        sprintf(new_label, "%.*s-%s", UCD_TEXT_FIELD_SIZE - 16,
+                _ucd_component_text(d->labels, comp), suffix);
+    }
+    sprintf(new_unit, "%.*s", UCD_TEXT_FIELD_SIZE - 1,
+            _ucd_component_text(d->units, comp));
+
+    *dst = ucd_data_append_component(d, size, new_label, new_unit, ld_dst);
+    if (*dst == NULL) {
+        return EXIT_FAILURE;
+    }
+    *src = ucd_data_component(d, comp, ld_src);
+
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_derive_magnitude(ucd_data* d, int comp, const char* label)
+{
+    const float* src;
+    float* dst;
+    int ld_src, ld_dst, size, i, j;
+    double sum;
+
+    if (_ucd_derive_prepare(d, comp, 1, label, "MAG",
+                &src, &ld_src, &dst, &ld_dst)) {
+        return EXIT_FAILURE;
+    }
+    size = d->components[comp];
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j, sum)
+#endif
+    for (i = 0; i < d->num_rows; ++i) {
+        sum = 0;
+        for (j = 0; j < size; ++j) {
+            sum += (double)src[ld_src * i + j] * src[ld_src * i + j];
+        }
+        dst[ld_dst * i] = (float)sqrt(sum);
+    }
+
+    ucd_data_update_minmax(d);
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_derive_mises(ucd_data* d, int comp, const char* label)
+{
+    const float* src;
+    float* dst;
+    const float* s;
+    int ld_src, ld_dst, i;
+    double dxy, dyz, dzx;
+
+    if (comp >= 0 && comp < d->num_comp && d->components[comp] != 6) {
+        fprintf(stderr, "%s: component %d is not a tensor\n", __func__, comp);
+        return EXIT_FAILURE;
+    }
+    if (_ucd_derive_prepare(d, comp, 1, label, "MISES",
+                &src, &ld_src, &dst, &ld_dst)) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for private(s, dxy, dyz, dzx)
+#endif
+    for (i = 0; i < d->num_rows; ++i) {
+        s = &src[ld_src * i];
+        dxy = (double)s[0] - s[1];
+        dyz = (double)s[1] - s[2];
+        dzx = (double)s[2] - s[0];
+        dst[ld_dst * i] = (float)sqrt(0.5 * (dxy * dxy + dyz * dyz + dzx * dzx)
+                + 3.0 * ((double)s[3] * s[3] + (double)s[4] * s[4]
+                    + (double)s[5] * s[5]));
+    }
+
+    ucd_data_update_minmax(d);
+    return EXIT_SUCCESS;
+}
+
+
+static void _ucd_sort2(float* a, float* b)
+{
+    float t;
+
+    if (*a < *b) {
+        t = *a;
+        *a = *b;
+        *b = t;
+    }
+}
+
+
+/* eigenvalues of a symmetric 3x3 matrix in descending order */
+static void _ucd_principal(const float* s, float* e)
+{
+    const double pi = 3.14159265358979323846;
+    double q, p, p1, p2, r, phi, b[6];
+
+    p1 = (double)s[3] * s[3] + (double)s[4] * s[4] + (double)s[5] * s[5];
+    q = ((double)s[0] + s[1] + s[2]) / 3;
+
+    if (p1 == 0) {
+        /* diagonal */
+        e[0] = s[0];
+        e[1] = s[1];
+        e[2] = s[2];
+        _ucd_sort2(&e[0], &e[1]);
+        _ucd_sort2(&e[1], &e[2]);
+        _ucd_sort2(&e[0], &e[1]);
+        return;
+    }
+
+    p2 = (s[0] - q) * (s[0] - q) + (s[1] - q) * (s[1] - q)
+        + (s[2] - q) * (s[2] - q) + 2 * p1;
+    p = sqrt(p2 / 6);
+    b[0] = (s[0] - q) / p;
+    b[1] = (s[1] - q) / p;
+    b[2] = (s[2] - q) / p;
+    b[3] = s[3] / p;
+    b[4] = s[4] / p;
+    b[5] = s[5] / p;
+    r = (b[0] * (b[1] * b[2] - b[4] * b[4])
+            - b[3] * (b[3] * b[2] - b[4] * b[5])
+            + b[5] * (b[3] * b[4] - b[1] * b[5])) / 2;
+
+    phi = r <= -1 ? pi / 3 : r >= 1 ? 0 : acos(r) / 3;
+    e[0] = (float)(q + 2 * p * cos(phi));
+    e[2] = (float)(q + 2 * p * cos(phi + 2 * pi / 3));
+    e[1] = (float)(3 * q - e[0] - e[2]);
+}
+
+
+int ucd_derive_principal(ucd_data* d, int comp, const char* label)
+{
+    const float* src;
+    float* dst;
+    int ld_src, ld_dst, i;
+
+    if (comp >= 0 && comp < d->num_comp && d->components[comp] != 6) {
+        fprintf(stderr, "%s: component %d is not a tensor\n", __func__, comp);
+        return EXIT_FAILURE;
+    }
+    if (_ucd_derive_prepare(d, comp, 3, label, "PRINCIPAL",
+                &src, &ld_src, &dst, &ld_dst)) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < d->num_rows; ++i) {
+        _ucd_principal(&src[ld_src * i], &dst[ld_dst * i]);
+    }
+
+    ucd_data_update_minmax(d);
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_derive_linear(ucd_data* d, int num_terms,
+        const int* comps, const float* coefs,
+        const char* label, const char* unit)
+{
+    const float* src;
+    float* dst;
+    int ld_src, ld_dst, size, i, j, t;
+
+    if (num_terms < 1) {
+        fprintf(stderr, "%s: no terms\n", __func__);
+        return EXIT_FAILURE;
+    }
+    for (t = 0; t < num_terms; ++t) {
+        if (comps[t] < 0 || comps[t] >= d->num_comp
+                || d->components[comps[t]] != d->components[comps[0]]) {
+            fprintf(stderr, "%s: component %d is invalid\n",
+                    __func__, comps[t]);
+            return EXIT_FAILURE;
+        }
+    }
+    size = d->components[comps[0]];
+
+    dst = ucd_data_append_component(d, size, label, unit, &ld_dst);
+    if (dst == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    src = ucd_data_component(d, comps[0], &ld_src);
+#ifdef _OPENMP
+#pragma omp parallel for private(j)
+#endif
+    for (i = 0; i < d->num_rows; ++i) {
+        for (j = 0; j < size; ++j) {
+            dst[ld_dst * i + j] = coefs[0] * src[ld_src * i + j];
+        }
+    }
+    for (t = 1; t < num_terms; ++t) {
+        src = ucd_data_component(d, comps[t], &ld_src);
+#ifdef _OPENMP
+#pragma omp parallel for private(j)
+#endif
+        for (i = 0; i < d->num_rows; ++i) {
+            for (j = 0; j < size; ++j) {
+                dst[ld_dst * i + j] += coefs[t] * src[ld_src * i + j];
+            }
+        }
+    }
+
+    ucd_data_update_minmax(d);
+    return EXIT_SUCCESS;
+}
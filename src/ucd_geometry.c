@@ -0,0 +1,95 @@
+/**
+ * @file ucd_geometry.c
+ * @brief Functions relate to geometry of cells.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include <math.h>
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+
+/*
+ * Cells are split into simplices of the centroid and faces, which are
+ * segments for lines, triangles for 2D cells and tetrahedra for 3D cells.
+ */
+static float _ucd_cell_measure(const ucd_content* ucd, int cell_type,
+        const int* nodes)
+{
+    const int* face;
+    double p[3], v[4][3], c[3], sum;
+    int nsize, num_faces, f, j, k;
+
+    nsize = ucd_cell_nlist_size(cell_type);
+    p[0] = p[1] = p[2] = 0;
+    for (j = 0; j < nsize; ++j) {
+        p[0] += ucd->node_x[nodes[j]] / nsize;
+        p[1] += ucd->node_y[nodes[j]] / nsize;
+        p[2] += ucd->node_z[nodes[j]] / nsize;
+    }
+
+    sum = 0;
+    num_faces = ucd_cell_num_faces(cell_type);
+    for (f = 0; f < num_faces; ++f) {
+        face = _ucd_cell_face(cell_type, f);
+        for (k = 0; k < 4 && face[k] >= 0; ++k) {
+            v[k][0] = ucd->node_x[nodes[face[k]]] - p[0];
+            v[k][1] = ucd->node_y[nodes[face[k]]] - p[1];
+            v[k][2] = ucd->node_z[nodes[face[k]]] - p[2];
+        }
+        if (k == 1) {
+            sum += sqrt(v[0][0] * v[0][0] + v[0][1] * v[0][1]
+                    + v[0][2] * v[0][2]);
+            continue;
+        }
+        /* a fan of triangles from the first node of the face */
+        for (j = 1; j < k; ++j) {
+            c[0] = v[0][1] * v[j][2] - v[0][2] * v[j][1];
+            c[1] = v[0][2] * v[j][0] - v[0][0] * v[j][2];
+            c[2] = v[0][0] * v[j][1] - v[0][1] * v[j][0];
+            if (k == 2) {
+                sum += sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]) / 2;
+            } else if (j + 1 < k) {
+                sum += fabs(c[0] * v[j+1][0] + c[1] * v[j+1][1]
+                        + c[2] * v[j+1][2]) / 6;
+            }
+        }
+    }
+    return (float)sum;
+}
+
+
+int ucd_cell_measures(const ucd_content* ucd, float* measures)
+{
+    int has_error, i;
+    ucd_node_index index;
+
+    _ucd_node_index_build(&index, ucd);
+    if (index.table == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    has_error = EXIT_SUCCESS;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(|:has_error)
+#endif
+    for (i = 0; i < ucd->num_cells; ++i) {
+        int nodes[8];
+
+        if (ucd_cell_num_faces(ucd->cell_type[i]) < 0
+                || _ucd_cell_nodes(ucd, &index, i, nodes)) {
+            has_error = EXIT_FAILURE;
+            measures[i] = 0;
+            continue;
+        }
+        measures[i] = _ucd_cell_measure(ucd, ucd->cell_type[i], nodes);
+    }
+
+    _ucd_node_index_free(&index);
+    return has_error;
+}
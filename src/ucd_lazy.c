@@ -0,0 +1,268 @@
+/**
+ * @file ucd_lazy.c
+ * @brief Functions relate to loading parts of a content on demand.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+#define UCD_LAZY_NODES 1
+#define UCD_LAZY_CELLS 2
+
+
+/* arrays allocated with no rows by ucd_probe() are released */
+static void _ucd_lazy_release(ucd_lazy* lz)
+{
+    ucd_content* ucd;
+    ucd_data* d;
+    int i;
+
+    ucd = &lz->ucd;
+    free(ucd->node_id);
+    free(ucd->node_x);
+    free(ucd->node_y);
+    free(ucd->node_z);
+    free(ucd->cell_id);
+    free(ucd->cell_mat_id);
+    free(ucd->cell_type);
+    free(ucd->cell_nlist);
+    ucd->node_id = NULL;
+    ucd->node_x = NULL;
+    ucd->node_y = NULL;
+    ucd->node_z = NULL;
+    ucd->cell_id = NULL;
+    ucd->cell_mat_id = NULL;
+    ucd->cell_type = NULL;
+    ucd->cell_nlist = NULL;
+
+    for (i = 0; i < 2; ++i) {
+        d = i == 0 ? ucd->ndata : ucd->cdata;
+        if (d != NULL) {
+            free(d->row_id);
+            free(d->data);
+            d->row_id = NULL;
+            d->data = NULL;
+            d->layout = UCD_LAYOUT_COMPONENT;
+        }
+    }
+}
+
+
+int ucd_lazy_open(ucd_lazy* lz, const char* filename)
+{
+    ucd_options o;
+    int num_comp;
+
+    memset(lz, 0, sizeof(*lz));
+    if (ucd_probe(&lz->ucd, filename, &lz->context)) {
+        return EXIT_FAILURE;
+    }
+
+    /* ASCII and chunked files cannot be located, so they are read now */
+    if (!lz->context.is_binary || lz->context.chunk_rows > 0) {
+        ucd_simple_free(&lz->ucd);
+        ucd_options_init(&o);
+        o.layout = UCD_LAYOUT_COMPONENT;
+        if (ucd_simple_reader_ex(&lz->ucd, filename, &o, &lz->context)) {
+            return EXIT_FAILURE;
+        }
+        lz->_loaded = UCD_LAZY_NODES | UCD_LAZY_CELLS;
+        return EXIT_SUCCESS;
+    }
+
+    _ucd_lazy_release(lz);
+    num_comp = (lz->ucd.ndata != NULL ? lz->ucd.ndata->num_comp : 0)
+        + (lz->ucd.cdata != NULL ? lz->ucd.cdata->num_comp : 0);
+    lz->_components = calloc(num_comp + 1, sizeof(*lz->_components));
+    if (lz->_components == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_simple_free(&lz->ucd);
+        return EXIT_FAILURE;
+    }
+    if (ucd_cursor_open(&lz->_cursor, &lz->context, filename)) {
+        free(lz->_components);
+        ucd_simple_free(&lz->ucd);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_lazy_nodes(ucd_lazy* lz)
+{
+    ucd_content* ucd;
+    int has_error, i;
+
+    if (lz->_loaded & UCD_LAZY_NODES) {
+        return EXIT_SUCCESS;
+    }
+
+    ucd = &lz->ucd;
+    ucd->node_id = malloc((ucd->num_nodes + 1) * sizeof(*ucd->node_id));
+    ucd->node_x = malloc((ucd->num_nodes + 1) * sizeof(*ucd->node_x));
+    ucd->node_y = malloc((ucd->num_nodes + 1) * sizeof(*ucd->node_y));
+    ucd->node_z = malloc((ucd->num_nodes + 1) * sizeof(*ucd->node_z));
+    has_error = ucd->node_id == NULL || ucd->node_x == NULL
+        || ucd->node_y == NULL || ucd->node_z == NULL;
+    if (has_error) {
+        fprintf(stderr, "%s: cannot allocate nodes\n", __func__);
+    } else {
+        for (i = 0; i < ucd->num_nodes; ++i) {
+            ucd->node_id[i] = i + 1;
+        }
+        has_error = ucd_cursor_read_coords(&lz->_cursor, 0,
+                0, ucd->num_nodes, ucd->node_x)
+            || ucd_cursor_read_coords(&lz->_cursor, 1,
+                0, ucd->num_nodes, ucd->node_y)
+            || ucd_cursor_read_coords(&lz->_cursor, 2,
+                0, ucd->num_nodes, ucd->node_z);
+    }
+
+    if (has_error) {
+        free(ucd->node_id);
+        free(ucd->node_x);
+        free(ucd->node_y);
+        free(ucd->node_z);
+        ucd->node_id = NULL;
+        ucd->node_x = NULL;
+        ucd->node_y = NULL;
+        ucd->node_z = NULL;
+        return EXIT_FAILURE;
+    }
+    lz->_loaded |= UCD_LAZY_NODES;
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_lazy_cells(ucd_lazy* lz)
+{
+    ucd_content* ucd;
+    int *cells, *nlist;
+    int has_error, i, j, k;
+
+    if (lz->_loaded & UCD_LAZY_CELLS) {
+        return EXIT_SUCCESS;
+    }
+
+    ucd = &lz->ucd;
+    ucd->ld_nlist = 8; /* hex */
+    ucd->cell_id = malloc((ucd->num_cells + 1) * sizeof(*ucd->cell_id));
+    ucd->cell_mat_id = malloc((ucd->num_cells + 1) * sizeof(*ucd->cell_mat_id));
+    ucd->cell_type = malloc((ucd->num_cells + 1) * sizeof(*ucd->cell_type));
+    ucd->cell_nlist = malloc((ucd->ld_nlist * ucd->num_cells + 1)
+            * sizeof(*ucd->cell_nlist));
+    cells = malloc((4 * ucd->num_cells + 1) * sizeof(*cells));
+    nlist = malloc((lz->context.num_nlist + 1) * sizeof(*nlist));
+    has_error = ucd->cell_id == NULL || ucd->cell_mat_id == NULL
+        || ucd->cell_type == NULL || ucd->cell_nlist == NULL
+        || cells == NULL || nlist == NULL;
+    if (has_error) {
+        fprintf(stderr, "%s: cannot allocate cells\n", __func__);
+    } else {
+        has_error = ucd_cursor_read_cells(&lz->_cursor,
+                0, ucd->num_cells, cells)
+            || ucd_cursor_read_nlist(&lz->_cursor,
+                0, lz->context.num_nlist, nlist);
+    }
+
+    k = 0;
+    for (i = 0; i < ucd->num_cells && !has_error; ++i) {
+        ucd->cell_id[i] = cells[4*i];
+        ucd->cell_mat_id[i] = cells[4*i+1];
+        ucd->cell_type[i] = cells[4*i+3];
+        if (cells[4*i+2] < 0 || cells[4*i+2] > ucd->ld_nlist
+                || k + cells[4*i+2] > lz->context.num_nlist) {
+            fprintf(stderr, "%s: cell %d has wrong node list\n",
+                    __func__, cells[4*i]);
+            has_error = EXIT_FAILURE;
+            break;
+        }
+        for (j = 0; j < cells[4*i+2]; ++j) {
+            ucd->cell_nlist[ucd->ld_nlist * i + j] = nlist[k++];
+        }
+    }
+    free(cells);
+    free(nlist);
+
+    if (has_error) {
+        free(ucd->cell_id);
+        free(ucd->cell_mat_id);
+        free(ucd->cell_type);
+        free(ucd->cell_nlist);
+        ucd->cell_id = NULL;
+        ucd->cell_mat_id = NULL;
+        ucd->cell_type = NULL;
+        ucd->cell_nlist = NULL;
+        return EXIT_FAILURE;
+    }
+    lz->_loaded |= UCD_LAZY_CELLS;
+    return EXIT_SUCCESS;
+}
+
+
+float* ucd_lazy_component(ucd_lazy* lz, int is_cell, int comp, int* ld)
+{
+    ucd_data* d;
+    float* data;
+    int i;
+
+    d = is_cell ? lz->ucd.cdata : lz->ucd.ndata;
+    if (d == NULL || comp < 0 || comp >= d->num_comp) {
+        fprintf(stderr, "%s: component %d is invalid\n", __func__, comp);
+        return NULL;
+    }
+    if (lz->_components == NULL) {
+        /* all data were read by ucd_lazy_open() */
+        return ucd_data_component(d, comp, ld);
+    }
+
+    /* rows of all components are allocated at the first access */
+    if (d->data == NULL) {
+        d->row_id = malloc((d->num_rows + 1) * sizeof(*d->row_id));
+        d->data = malloc(((long)d->num_rows * d->num_data + 1)
+                * sizeof(*d->data));
+        if (d->row_id == NULL || d->data == NULL) {
+            fprintf(stderr, "%s: cannot allocate data\n", __func__);
+            free(d->row_id);
+            free(d->data);
+            d->row_id = NULL;
+            d->data = NULL;
+            return NULL;
+        }
+        for (i = 0; i < d->num_rows; ++i) {
+            d->row_id[i] = i + 1;
+        }
+    }
+
+    data = ucd_data_component(d, comp, ld);
+    i = is_cell && lz->ucd.ndata != NULL ? lz->ucd.ndata->num_comp + comp : comp;
+    if (!lz->_components[i]) {
+        if (ucd_cursor_read_component(&lz->_cursor, is_cell, comp,
+                    0, d->num_rows, data, *ld)) {
+            return NULL;
+        }
+        lz->_components[i] = 1;
+    }
+    return data;
+}
+
+
+int ucd_lazy_close(ucd_lazy* lz)
+{
+    int has_error;
+
+    has_error = EXIT_SUCCESS;
+    if (lz->_cursor._fp != NULL) {
+        has_error = ucd_cursor_close(&lz->_cursor);
+    }
+    free(lz->_components);
+    ucd_simple_free(&lz->ucd);
+    memset(lz, 0, sizeof(*lz));
+
+    return has_error;
+}
@@ -0,0 +1,217 @@
+/**
+ * @file ucd_memory.c
+ * @brief Functions relate to arrays allocated within a memory budget.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ *
+ * Arrays beyond the budget of a context are spilled to mappings of
+ * temporary files, which are removed as soon as they are created, so the
+ * kernel pages them to the disk instead of the swap.  Spilled arrays are
+ * registered to be unmapped by _ucd_free(), and the registry is only read
+ * and updated in a critical section.  Spilling is not available on
+ * Windows, where all arrays are allocated from the heap.
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600
+#endif
+
+#include "ucd_private.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/** A spilled array. */
+struct ucd_spill {
+    void* addr;
+    size_t size;
+    struct ucd_spill* next;
+};
+
+static struct ucd_spill* _ucd_spills = NULL;
+
+
+#ifndef _WIN32
+static void* _ucd_spill(size_t size, int advice)
+{
+    struct ucd_spill* s;
+    const char* dir;
+    char* name;
+    void* p;
+    int fd;
+
+    s = malloc(sizeof(*s));
+    dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0') {
+        dir = "/tmp";
+    }
+    name = malloc(strlen(dir) + 16);
+    if (s == NULL || name == NULL) {
+        free(s);
+        free(name);
+        return NULL;
+    }
+    sprintf(name, "%s/ucdXXXXXX", dir);
+    fd = mkstemp(name);
+    if (fd >= 0) {
+        unlink(name);
+    }
+    free(name);
+    if (fd < 0 || ftruncate(fd, (off_t)size)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(s);
+        return NULL;
+    }
+    /* the mapping is kept after the descriptor is closed */
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        free(s);
+        return NULL;
+    }
+    posix_madvise(p, size, advice == UCD_ADVICE_RANDOM
+            ? POSIX_MADV_RANDOM : POSIX_MADV_SEQUENTIAL);
+
+    s->addr = p;
+    s->size = size;
+#ifdef _OPENMP
+#pragma omp critical(_ucd_spill)
+#endif
+    {
+        s->next = _ucd_spills;
+        _ucd_spills = s;
+    }
+    return p;
+}
+#endif
+
+
+int _ucd_is_spilled(const void* p)
+{
+    struct ucd_spill* s;
+    int found;
+
+    found = 0;
+    if (p == NULL) {
+        return found;
+    }
+#ifdef _OPENMP
+#pragma omp critical(_ucd_spill)
+#endif
+    {
+        for (s = _ucd_spills; s != NULL && !found; s = s->next) {
+            found = s->addr == p;
+        }
+    }
+    return found;
+}
+
+
+void* _ucd_alloc(ucd_context* c, size_t size, int advice)
+{
+    void* p;
+
+    /* an extra byte, so that empty arrays are not NULL */
+    if (c == NULL || c->memory_budget == 0
+            || c->_allocated + size <= c->memory_budget) {
+        p = malloc(size + 1);
+        if (p != NULL && c != NULL) {
+            c->_allocated += size;
+        }
+        return p;
+    }
+#ifndef _WIN32
+    p = _ucd_spill(size > 0 ? size : 1, advice);
+    if (p != NULL) {
+        return p;
+    }
+#endif
+    /* the budget is exceeded on the heap if arrays cannot be spilled */
+    p = malloc(size + 1);
+    if (p != NULL) {
+        c->_allocated += size;
+    }
+    return p;
+}
+
+
+void* _ucd_alloc_like(const void* like, size_t size)
+{
+    void* p;
+
+#ifndef _WIN32
+    if (_ucd_is_spilled(like)) {
+        p = _ucd_spill(size > 0 ? size : 1, UCD_ADVICE_SEQUENTIAL);
+        if (p != NULL) {
+            return p;
+        }
+    }
+#endif
+    p = malloc(size + 1);
+    return p;
+}
+
+
+void* _ucd_realloc(void* p, size_t old_size, size_t size)
+{
+    void* q;
+
+    if (!_ucd_is_spilled(p)) {
+        return realloc(p, size + 1);
+    }
+    q = _ucd_alloc_like(p, size);
+    if (q != NULL) {
+        memcpy(q, p, old_size < size ? old_size : size);
+        _ucd_free(p);
+    }
+    return q;
+}
+
+
+void _ucd_free(void* p)
+{
+    struct ucd_spill *s, **prev;
+
+    s = NULL;
+    if (p != NULL) {
+#ifdef _OPENMP
+#pragma omp critical(_ucd_spill)
+#endif
+        {
+            for (prev = &_ucd_spills; *prev != NULL; prev = &(*prev)->next) {
+                if ((*prev)->addr == p) {
+                    s = *prev;
+                    *prev = s->next;
+                    break;
+                }
+            }
+        }
+    }
+    if (s == NULL) {
+        free(p);
+        return;
+    }
+#ifndef _WIN32
+    munmap(s->addr, s->size);
+#endif
+    free(s);
+}
+
+
+void _ucd_budget_free(ucd_context* c, void* p, size_t size)
+{
+    if (p != NULL && !_ucd_is_spilled(p)) {
+        c->_allocated -= size;
+    }
+    _ucd_free(p);
+}
@@ -0,0 +1,624 @@
+/**
+ * @file ucd_partition.c
+ * @brief Functions relate to partitioning and merging meshes.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include <float.h>
+#include "ucd_private.h"
+
+
+typedef struct {
+    float key;
+    int cell;
+} _ucd_sort_item;
+
+
+static int _ucd_compare_item(const void* a, const void* b)
+{
+    float ka = ((const _ucd_sort_item*)a)->key;
+    float kb = ((const _ucd_sort_item*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+
+static void _ucd_bisect(const float* centroid,
+        _ucd_sort_item* items, int num_items,
+        int first_part, int num_parts, int* cell_part)
+{
+    int num_left, axis, i, j;
+    float lo[3], hi[3];
+
+    if (num_parts == 1) {
+        for (i = 0; i < num_items; ++i) {
+            cell_part[items[i].cell] = first_part;
+        }
+        return;
+    }
+
+    /* split along the longest extent */
+    for (j = 0; j < 3; ++j) {
+        lo[j] = +FLT_MAX;
+        hi[j] = -FLT_MAX;
+    }
+    for (i = 0; i < num_items; ++i) {
+        for (j = 0; j < 3; ++j) {
+            if (centroid[3 * items[i].cell + j] < lo[j]) {
+                lo[j] = centroid[3 * items[i].cell + j];
+            }
+            if (centroid[3 * items[i].cell + j] > hi[j]) {
+                hi[j] = centroid[3 * items[i].cell + j];
+            }
+        }
+    }
+    axis = 0;
+    for (j = 1; j < 3; ++j) {
+        if (hi[j] - lo[j] > hi[axis] - lo[axis]) {
+            axis = j;
+        }
+    }
+
+    for (i = 0; i < num_items; ++i) {
+        items[i].key = centroid[3 * items[i].cell + axis];
+    }
+    qsort(items, num_items, sizeof(*items), _ucd_compare_item);
+
+    num_left = (int)((double)num_items * (num_parts / 2) / num_parts);
+    _ucd_bisect(centroid, items, num_left,
+            first_part, num_parts / 2, cell_part);
+    _ucd_bisect(centroid, items + num_left, num_items - num_left,
+            first_part + num_parts / 2, num_parts - num_parts / 2, cell_part);
+}
+
+
+int ucd_partition(const ucd_content* ucd, int num_parts, int* cell_part)
+{
+    int nsize, i, j, k;
+    ucd_node_index index;
+    float* centroid;
+    _ucd_sort_item* items;
+
+    if (num_parts < 1) {
+        fprintf(stderr, "%s: number of parts %d is invalid\n",
+                __func__, num_parts);
+        return EXIT_FAILURE;
+    }
+
+    _ucd_node_index_build(&index, ucd);
+    centroid = malloc(3 * ucd->num_cells * sizeof(*centroid));
+    items = malloc(ucd->num_cells * sizeof(*items));
+    if (index.table == NULL || (ucd->num_cells > 0
+                && (centroid == NULL || items == NULL))) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        _ucd_node_index_free(&index);
+        free(centroid);
+        free(items);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < ucd->num_cells; ++i) {
+        nsize = ucd_cell_nlist_size(ucd->cell_type[i]);
+        centroid[3*i] = centroid[3*i+1] = centroid[3*i+2] = 0;
+        for (j = 0; j < nsize; ++j) {
+            k = _ucd_node_find(&index, ucd->cell_nlist[ucd->ld_nlist * i + j]);
+            if (k < 0) {
+                fprintf(stderr, "%s: cell %d refers unknown node %d\n",
+                        __func__, ucd->cell_id[i],
+                        ucd->cell_nlist[ucd->ld_nlist * i + j]);
+                _ucd_node_index_free(&index);
+                free(centroid);
+                free(items);
+                return EXIT_FAILURE;
+            }
+            centroid[3*i] += ucd->node_x[k] / nsize;
+            centroid[3*i+1] += ucd->node_y[k] / nsize;
+            centroid[3*i+2] += ucd->node_z[k] / nsize;
+        }
+        items[i].cell = i;
+    }
+
+    _ucd_bisect(centroid, items, ucd->num_cells, 0, num_parts, cell_part);
+
+    _ucd_node_index_free(&index);
+    free(centroid);
+    free(items);
+
+    return EXIT_SUCCESS;
+}
+
+
+static ucd_data* _ucd_extract_rows(const ucd_data* d,
+        const int* row_map, int num_rows, int renumber)
+{
+    ucd_data* e;
+    int i, k;
+
+    e = ucd_data_alloc(num_rows, d->num_data);
+    if (e == NULL) {
+        return NULL;
+    }
+    ucd_data_copy_header(e, d);
+    e->layout = d->layout;
+
+    for (i = 0; i < d->num_rows; ++i) {
+        k = row_map[i];
+        if (k >= 0) {
+            e->row_id[k] = renumber ? k + 1 : d->row_id[i];
+            _ucd_data_copy_row(e, k, d, i);
+        }
+    }
+    ucd_data_update_minmax(e);
+
+    return e;
+}
+
+
+int ucd_extract_cells(ucd_content* sub, const ucd_content* ucd,
+        const char* selected, int** global_node)
+{
+    int num_nodes, num_cells, nsize, i, j, k, n;
+    ucd_node_index index;
+    int *node_map, *cell_map;
+
+    _ucd_node_index_build(&index, ucd);
+    node_map = malloc(ucd->num_nodes * sizeof(*node_map));
+    cell_map = malloc(ucd->num_cells * sizeof(*cell_map));
+    if (index.table == NULL || (ucd->num_nodes > 0 && node_map == NULL)
+            || (ucd->num_cells > 0 && cell_map == NULL)) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        _ucd_node_index_free(&index);
+        free(node_map);
+        free(cell_map);
+        return EXIT_FAILURE;
+    }
+
+    /* local numbering of nodes and cells */
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        node_map[i] = -1;
+    }
+    num_nodes = num_cells = 0;
+    for (i = 0; i < ucd->num_cells; ++i) {
+        if (!selected[i]) {
+            cell_map[i] = -1;
+            continue;
+        }
+        cell_map[i] = num_cells++;
+        nsize = ucd_cell_nlist_size(ucd->cell_type[i]);
+        for (j = 0; j < nsize; ++j) {
+            k = _ucd_node_find(&index, ucd->cell_nlist[ucd->ld_nlist * i + j]);
+            if (k < 0) {
+                fprintf(stderr, "%s: cell %d refers unknown node %d\n",
+                        __func__, ucd->cell_id[i],
+                        ucd->cell_nlist[ucd->ld_nlist * i + j]);
+                _ucd_node_index_free(&index);
+                free(node_map);
+                free(cell_map);
+                return EXIT_FAILURE;
+            }
+            if (node_map[k] < 0) {
+                node_map[k] = num_nodes++;
+            }
+        }
+    }
+
+    if (ucd_simple_alloc(sub, num_nodes, num_cells, ucd->ld_nlist)) {
+        _ucd_node_index_free(&index);
+        free(node_map);
+        free(cell_map);
+        return EXIT_FAILURE;
+    }
+
+    if (global_node != NULL) {
+        *global_node = malloc(num_nodes * sizeof(**global_node) + 1);
+        if (*global_node == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            _ucd_node_index_free(&index);
+            free(node_map);
+            free(cell_map);
+            ucd_simple_free(sub);
+            return EXIT_FAILURE;
+        }
+    }
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        n = node_map[i];
+        if (n >= 0) {
+            sub->node_id[n] = n + 1;
+            sub->node_x[n] = ucd->node_x[i];
+            sub->node_y[n] = ucd->node_y[i];
+            sub->node_z[n] = ucd->node_z[i];
+            if (global_node != NULL) {
+                (*global_node)[n] = ucd->node_id[i];
+            }
+        }
+    }
+
+    for (i = 0; i < ucd->num_cells; ++i) {
+        n = cell_map[i];
+        if (n >= 0) {
+            sub->cell_id[n] = ucd->cell_id[i];
+            sub->cell_mat_id[n] = ucd->cell_mat_id[i];
+            sub->cell_type[n] = ucd->cell_type[i];
+            nsize = ucd_cell_nlist_size(ucd->cell_type[i]);
+            for (j = 0; j < nsize; ++j) {
+                k = _ucd_node_find(&index,
+                        ucd->cell_nlist[ucd->ld_nlist * i + j]);
+                sub->cell_nlist[sub->ld_nlist * n + j] = node_map[k] + 1;
+            }
+        }
+    }
+
+    if (ucd->ndata != NULL) {
+        sub->ndata = _ucd_extract_rows(ucd->ndata, node_map, num_nodes, 1);
+    }
+    if (ucd->cdata != NULL) {
+        sub->cdata = _ucd_extract_rows(ucd->cdata, cell_map, num_cells, 0);
+    }
+
+    _ucd_node_index_free(&index);
+    free(node_map);
+    free(cell_map);
+
+    if ((ucd->ndata != NULL && sub->ndata == NULL)
+            || (ucd->cdata != NULL && sub->cdata == NULL)) {
+        ucd_simple_free(sub);
+        if (global_node != NULL) {
+            free(*global_node);
+            *global_node = NULL;
+        }
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/* floor of grid coordinate, clamped so that the conversion cannot overflow */
+static long _ucd_merger_grid(float q)
+{
+    if (q != q) {
+        return 0;
+    }
+    if (q < -1.0e9f) {
+        q = -1.0e9f;
+    } else if (q > 1.0e9f) {
+        q = 1.0e9f;
+    }
+    return (long)q - (q < (long)q);
+}
+
+
+static int _ucd_merger_bucket(const ucd_merger* m,
+        float x, float y, float z, int dx, int dy, int dz)
+{
+    union {
+        float f;
+        unsigned int u;
+    } bx, by, bz;
+    float qx, qy, qz;
+    long ix, iy, iz;
+    unsigned int h;
+
+    if (m->tolerance > 0) {
+        /* grid cell of the size of tolerance */
+        qx = x / m->tolerance;
+        qy = y / m->tolerance;
+        qz = z / m->tolerance;
+        ix = _ucd_merger_grid(qx) + dx;
+        iy = _ucd_merger_grid(qy) + dy;
+        iz = _ucd_merger_grid(qz) + dz;
+        h = (unsigned int)ix * 73856093u
+            ^ (unsigned int)iy * 19349663u
+            ^ (unsigned int)iz * 83492791u;
+    } else {
+        /* exact coordinates (+0.0 is added to unify -0.0) */
+        bx.f = x + 0.0f;
+        by.f = y + 0.0f;
+        bz.f = z + 0.0f;
+        h = bx.u * 73856093u ^ by.u * 19349663u ^ bz.u * 83492791u;
+    }
+    return (int)(h & (unsigned int)(m->_num_buckets - 1));
+}
+
+
+static int _ucd_merger_find(const ucd_merger* m, float x, float y, float z)
+{
+    const ucd_content* u = m->ucd;
+    float tol2, ex, ey, ez;
+    int reach, dx, dy, dz, k;
+
+    tol2 = m->tolerance * m->tolerance;
+    reach = m->tolerance > 0;
+    for (dz = -reach; dz <= reach; ++dz) {
+        for (dy = -reach; dy <= reach; ++dy) {
+            for (dx = -reach; dx <= reach; ++dx) {
+                k = m->_bucket[_ucd_merger_bucket(m, x, y, z, dx, dy, dz)];
+                for (; k >= 0; k = m->_next[k]) {
+                    ex = u->node_x[k] - x;
+                    ey = u->node_y[k] - y;
+                    ez = u->node_z[k] - z;
+                    if (ex * ex + ey * ey + ez * ez <= tol2) {
+                        return k;
+                    }
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+
+/*
+ * Arrays which are reallocated keep their contents even if others fail, and
+ * capacities are raised only after all of them succeed.
+ */
+static int _ucd_merger_reserve(ucd_merger* m, int num_nodes, int num_cells)
+{
+    ucd_content* u = m->ucd;
+    int max_rows, num_buckets, i, b;
+    int* bucket;
+    void* p[10];
+
+    if (num_nodes > m->_max_nodes) {
+        max_rows = num_nodes > 2 * m->_max_nodes
+            ? num_nodes : 2 * m->_max_nodes;
+        p[0] = realloc(u->node_id, max_rows * sizeof(*u->node_id));
+        p[1] = realloc(u->node_x, max_rows * sizeof(*u->node_x));
+        p[2] = realloc(u->node_y, max_rows * sizeof(*u->node_y));
+        p[3] = realloc(u->node_z, max_rows * sizeof(*u->node_z));
+        p[4] = realloc(m->_next, max_rows * sizeof(*m->_next));
+        if (p[0] != NULL) u->node_id = p[0];
+        if (p[1] != NULL) u->node_x = p[1];
+        if (p[2] != NULL) u->node_y = p[2];
+        if (p[3] != NULL) u->node_z = p[3];
+        if (p[4] != NULL) m->_next = p[4];
+        if (u->ndata != NULL) {
+            p[5] = realloc(u->ndata->row_id,
+                    max_rows * sizeof(*u->ndata->row_id));
+            p[6] = realloc(u->ndata->data,
+                    max_rows * u->ndata->num_data * sizeof(*u->ndata->data));
+            if (p[5] != NULL) u->ndata->row_id = p[5];
+            if (p[6] != NULL) u->ndata->data = p[6];
+        } else {
+            p[5] = p[6] = p;
+        }
+        for (i = 0; i < 7; ++i) {
+            if (p[i] == NULL) {
+                fprintf(stderr, "%s: cannot allocate nodes\n", __func__);
+                return EXIT_FAILURE;
+            }
+        }
+
+        /* rehash */
+        num_buckets = 1;
+        while (num_buckets < 2 * max_rows) {
+            num_buckets *= 2;
+        }
+        bucket = malloc(num_buckets * sizeof(*bucket));
+        if (bucket == NULL) {
+            fprintf(stderr, "%s: cannot allocate hash\n", __func__);
+            return EXIT_FAILURE;
+        }
+        free(m->_bucket);
+        m->_bucket = bucket;
+        m->_num_buckets = num_buckets;
+        m->_max_nodes = max_rows;
+        for (i = 0; i < m->_num_buckets; ++i) {
+            m->_bucket[i] = -1;
+        }
+        for (i = 0; i < u->num_nodes; ++i) {
+            b = _ucd_merger_bucket(m,
+                    u->node_x[i], u->node_y[i], u->node_z[i], 0, 0, 0);
+            m->_next[i] = m->_bucket[b];
+            m->_bucket[b] = i;
+        }
+    }
+
+    if (num_cells > m->_max_cells) {
+        max_rows = num_cells > 2 * m->_max_cells
+            ? num_cells : 2 * m->_max_cells;
+        p[0] = realloc(u->cell_id, max_rows * sizeof(*u->cell_id));
+        p[1] = realloc(u->cell_mat_id, max_rows * sizeof(*u->cell_mat_id));
+        p[2] = realloc(u->cell_type, max_rows * sizeof(*u->cell_type));
+        p[3] = realloc(u->cell_nlist,
+                max_rows * u->ld_nlist * sizeof(*u->cell_nlist));
+        if (p[0] != NULL) u->cell_id = p[0];
+        if (p[1] != NULL) u->cell_mat_id = p[1];
+        if (p[2] != NULL) u->cell_type = p[2];
+        if (p[3] != NULL) u->cell_nlist = p[3];
+        if (u->cdata != NULL) {
+            p[4] = realloc(u->cdata->row_id,
+                    max_rows * sizeof(*u->cdata->row_id));
+            p[5] = realloc(u->cdata->data,
+                    max_rows * u->cdata->num_data * sizeof(*u->cdata->data));
+            if (p[4] != NULL) u->cdata->row_id = p[4];
+            if (p[5] != NULL) u->cdata->data = p[5];
+        } else {
+            p[4] = p[5] = p;
+        }
+        for (i = 0; i < 6; ++i) {
+            if (p[i] == NULL) {
+                fprintf(stderr, "%s: cannot allocate cells\n", __func__);
+                return EXIT_FAILURE;
+            }
+        }
+        m->_max_cells = max_rows;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+static int _ucd_merger_check_data(ucd_data** merged,
+        const ucd_data* d, int is_first, const char* name)
+{
+    if (is_first && *merged == NULL && d != NULL) {
+        *merged = ucd_data_alloc(0, d->num_data);
+        if (*merged == NULL) {
+            return EXIT_FAILURE;
+        }
+        ucd_data_copy_header(*merged, d);
+    } else if ((*merged == NULL) != (d == NULL)
+            || (d != NULL && d->num_data != (*merged)->num_data)) {
+        fprintf(stderr, "%s: %s data mismatch\n", __func__, name);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_merger_open(ucd_merger* m, ucd_content* ucd, float tolerance)
+{
+    if (tolerance < 0) {
+        fprintf(stderr, "%s: negative tolerance\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    m->ucd = ucd;
+    m->tolerance = tolerance;
+    m->_max_nodes = 0;
+    m->_max_cells = 0;
+    m->_num_buckets = 0;
+    m->_bucket = NULL;
+    m->_next = NULL;
+
+    return ucd_simple_alloc(ucd, 0, 0, 8 /* hex */);
+}
+
+
+int ucd_merger_add(ucd_merger* m, const ucd_content* part)
+{
+    ucd_content* u = m->ucd;
+    int is_first, first_cell, has_error, i, k, b;
+    ucd_node_index index;
+    int* node_map;
+
+    is_first = u->num_nodes == 0 && u->num_cells == 0;
+    if (_ucd_merger_check_data(&u->ndata, part->ndata, is_first, "node")
+            || _ucd_merger_check_data(&u->cdata, part->cdata, is_first, "cell")
+            || _ucd_merger_reserve(m, u->num_nodes + part->num_nodes,
+                u->num_cells + part->num_cells)) {
+        return EXIT_FAILURE;
+    }
+
+    _ucd_node_index_build(&index, part);
+    node_map = malloc(part->num_nodes * sizeof(*node_map));
+    if (index.table == NULL || (part->num_nodes > 0 && node_map == NULL)) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        _ucd_node_index_free(&index);
+        free(node_map);
+        return EXIT_FAILURE;
+    }
+
+    /* nodes already merged are looked up in parallel */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256)
+#endif
+    for (i = 0; i < part->num_nodes; ++i) {
+        node_map[i] = _ucd_merger_find(m,
+                part->node_x[i], part->node_y[i], part->node_z[i]);
+    }
+
+    /*
+     * The others are inserted in order, and may be found among those of
+     * this part.  Node k inserted for node i is marked by -2 - k.
+     */
+    for (i = 0; i < part->num_nodes; ++i) {
+        if (node_map[i] >= 0) {
+            continue;
+        }
+        k = _ucd_merger_find(m,
+                part->node_x[i], part->node_y[i], part->node_z[i]);
+        if (k < 0) {
+            k = u->num_nodes++;
+            u->node_x[k] = part->node_x[i];
+            u->node_y[k] = part->node_y[i];
+            u->node_z[k] = part->node_z[i];
+            b = _ucd_merger_bucket(m,
+                    u->node_x[k], u->node_y[k], u->node_z[k], 0, 0, 0);
+            m->_next[k] = m->_bucket[b];
+            m->_bucket[b] = k;
+            k = -2 - k;
+        }
+        node_map[i] = k;
+    }
+
+    /* rows of inserted nodes are copied in parallel */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < part->num_nodes; ++i) {
+        int k;
+
+        if (node_map[i] < 0) {
+            k = -2 - node_map[i];
+            node_map[i] = k;
+            u->node_id[k] = k + 1;
+            if (u->ndata != NULL) {
+                u->ndata->row_id[k] = k + 1;
+                _ucd_data_copy_row(u->ndata, k, part->ndata, i);
+            }
+        }
+    }
+
+    /* cells */
+    first_cell = u->num_cells;
+    has_error = EXIT_SUCCESS;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 256) reduction(|:has_error)
+#endif
+    for (i = 0; i < part->num_cells; ++i) {
+        int nsize, j, k, b;
+
+        k = first_cell + i;
+        u->cell_id[k] = k + 1;
+        u->cell_mat_id[k] = part->cell_mat_id[i];
+        u->cell_type[k] = part->cell_type[i];
+        nsize = ucd_cell_nlist_size(part->cell_type[i]);
+        for (j = 0; j < nsize; ++j) {
+            b = _ucd_node_find(&index,
+                    part->cell_nlist[part->ld_nlist * i + j]);
+            if (b < 0) {
+                fprintf(stderr, "%s: cell %d refers unknown node %d\n",
+                        __func__, part->cell_id[i],
+                        part->cell_nlist[part->ld_nlist * i + j]);
+                has_error = EXIT_FAILURE;
+                break;
+            }
+            u->cell_nlist[u->ld_nlist * k + j] = node_map[b] + 1;
+        }
+        if (u->cdata != NULL) {
+            u->cdata->row_id[k] = k + 1;
+            _ucd_data_copy_row(u->cdata, k, part->cdata, i);
+        }
+    }
+    if (!has_error) {
+        u->num_cells += part->num_cells;
+    }
+
+    _ucd_node_index_free(&index);
+    free(node_map);
+
+    return has_error;
+}
+
+
+int ucd_merger_close(ucd_merger* m)
+{
+    ucd_content* u = m->ucd;
+
+    if (u->ndata != NULL) {
+        u->ndata->num_rows = u->num_nodes;
+        ucd_data_update_minmax(u->ndata);
+    }
+    if (u->cdata != NULL) {
+        u->cdata->num_rows = u->num_cells;
+        ucd_data_update_minmax(u->cdata);
+    }
+
+    free(m->_bucket);
+    free(m->_next);
+    m->_bucket = NULL;
+    m->_next = NULL;
+
+    return EXIT_SUCCESS;
+}
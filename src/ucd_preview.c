@@ -0,0 +1,480 @@
+/**
+ * @file ucd_preview.c
+ * @brief Functions relate to coarse previews of contents.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ *
+ * A preview is made by vertex clustering on a uniform grid: the boundary
+ * of the content is extracted, its nodes are merged into one node per
+ * grid cell at their mean, and faces which collapse are dropped.
+ */
+
+#include <math.h>
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/* clusters are numbered in 32 bits */
+#define UCD_PREVIEW_MAX_RESOLUTION 1024
+
+/** A node with the grid cell of its cluster. */
+struct ucd_cluster_key {
+    long key;
+    int node;
+};
+
+/** Elements of a preview before nodes are numbered. */
+struct ucd_preview_elements {
+    int num;
+    int* type;
+    int* owner;
+    int* nlist;
+};
+
+
+static int _ucd_cluster_compare(const void* a, const void* b)
+{
+    long ka, kb;
+
+    ka = ((const struct ucd_cluster_key*)a)->key;
+    kb = ((const struct ucd_cluster_key*)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+
+/* clusters (0-based) of nodes in the order of grid cells */
+static int _ucd_preview_clusters(const ucd_content* ucd, int resolution,
+        int* cluster)
+{
+    struct ucd_cluster_key* keys;
+    const float* coords[3];
+    float lower[3], upper[3];
+    double h;
+    long dims[3], cell[3];
+    int num_clusters, axis, i;
+
+    coords[0] = ucd->node_x;
+    coords[1] = ucd->node_y;
+    coords[2] = ucd->node_z;
+    h = 0;
+    for (axis = 0; axis < 3; ++axis) {
+        lower[axis] = upper[axis] = ucd->num_nodes > 0 ? coords[axis][0] : 0;
+        for (i = 1; i < ucd->num_nodes; ++i) {
+            if (coords[axis][i] < lower[axis]) {
+                lower[axis] = coords[axis][i];
+            }
+            if (coords[axis][i] > upper[axis]) {
+                upper[axis] = coords[axis][i];
+            }
+        }
+        if (upper[axis] - lower[axis] > h) {
+            h = upper[axis] - lower[axis];
+        }
+    }
+    h = h > 0 ? h / resolution : 1;
+    for (axis = 0; axis < 3; ++axis) {
+        dims[axis] = (long)ceil((upper[axis] - lower[axis]) / h);
+        dims[axis] = dims[axis] > 0 ? dims[axis] : 1;
+    }
+
+    keys = malloc(ucd->num_nodes * sizeof(*keys) + 1);
+    if (keys == NULL) {
+        return -1;
+    }
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        for (axis = 0; axis < 3; ++axis) {
+            cell[axis] = (long)((coords[axis][i] - lower[axis]) / h);
+            if (cell[axis] >= dims[axis]) {
+                cell[axis] = dims[axis] - 1;
+            }
+        }
+        keys[i].key = (cell[0] * dims[1] + cell[1]) * dims[2] + cell[2];
+        keys[i].node = i;
+    }
+    qsort(keys, ucd->num_nodes, sizeof(*keys), _ucd_cluster_compare);
+
+    num_clusters = 0;
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        if (i > 0 && keys[i].key != keys[i - 1].key) {
+            ++num_clusters;
+        }
+        cluster[keys[i].node] = num_clusters;
+    }
+    free(keys);
+    return ucd->num_nodes > 0 ? num_clusters + 1 : 0;
+}
+
+
+/* append an element unless it collapses, and mark its nodes and clusters */
+static void _ucd_preview_add(struct ucd_preview_elements* e,
+        const int* cluster, int* used, char* kept, int owner, int dim,
+        const int* nodes, int n)
+{
+    int* dst;
+    int m, j, k;
+
+    dst = &e->nlist[4 * e->num];
+    for (j = 0, m = 0; j < n; ++j) {
+        for (k = 0; k < m && dst[k] != cluster[nodes[j]]; ++k) {
+            continue;
+        }
+        if (k == m) {
+            dst[m++] = cluster[nodes[j]];
+        }
+    }
+    if (dim == 0 ? used[dst[0]] : m < dim + 1) {
+        return;
+    }
+    for (j = 0; j < m; ++j) {
+        used[dst[j]] = 1;
+    }
+    for (j = 0; j < n; ++j) {
+        kept[nodes[j]] = 1;
+    }
+    /* a quad with a collapsed edge is a tri */
+    e->type[e->num] = dim == 2 ? m == 4 ? 3 : 2 : dim;
+    e->owner[e->num] = owner;
+    ++e->num;
+}
+
+
+/* elements are appended by buckets, so cells of a type are in a row */
+static int _ucd_preview_elements(struct ucd_preview_elements* e,
+        const ucd_content* ucd, const ucd_adjacency* adj,
+        const int* cluster, int* used, char* kept)
+{
+    const int* face;
+    int nodes[8], fnodes[4];
+    int type, f, n, i, k;
+    ucd_node_index index;
+    ucd_buckets buckets;
+
+    if (ucd_buckets_build(&buckets, ucd)) {
+        return EXIT_FAILURE;
+    }
+    _ucd_node_index_build(&index, ucd);
+    e->num = 0;
+    n = adj->cell_offset[ucd->num_cells] + ucd->num_cells;
+    e->type = malloc(n * sizeof(int) + 1);
+    e->owner = malloc(n * sizeof(int) + 1);
+    e->nlist = malloc(4 * n * sizeof(int) + 1);
+    if (index.table == NULL || e->type == NULL || e->owner == NULL
+            || e->nlist == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_buckets_free(&buckets);
+        _ucd_node_index_free(&index);
+        return EXIT_FAILURE;
+    }
+
+    for (type = 0; type < 8; ++type) {
+        for (k = 0; k < buckets.offset[type + 1] - buckets.offset[type];
+                ++k) {
+            i = buckets.order[buckets.offset[type] + k];
+            if (_ucd_bucket_nodes(&buckets, ucd, &index, type, k, nodes)) {
+                ucd_buckets_free(&buckets);
+                _ucd_node_index_free(&index);
+                return EXIT_FAILURE;
+            }
+            if (type < 4) {
+                /* points, lines and surfaces are boundaries by themselves */
+                _ucd_preview_add(e, cluster, used, kept, i,
+                        type < 2 ? type : 2, nodes, ucd_cell_nlist_size(type));
+                continue;
+            }
+            for (f = 0; f < ucd_cell_num_faces(type); ++f) {
+                if (adj->cell_cells[adj->cell_offset[i] + f] >= 0) {
+                    continue;
+                }
+                face = _ucd_cell_face(type, f);
+                for (n = 0; n < 4 && face[n] >= 0; ++n) {
+                    fnodes[n] = nodes[face[n]];
+                }
+                _ucd_preview_add(e, cluster, used, kept, i, 2, fnodes, n);
+            }
+        }
+    }
+    ucd_buckets_free(&buckets);
+    _ucd_node_index_free(&index);
+    return EXIT_SUCCESS;
+}
+
+
+/* node data averaged over kept nodes of clusters */
+static ucd_data* _ucd_preview_ndata(const ucd_data* src, int num_nodes,
+        const int* cluster, const int* node_index, const char* kept,
+        const int* count)
+{
+    ucd_data* d;
+    const float* column;
+    int ld, i, j, k;
+
+    d = ucd_data_alloc(num_nodes, src->num_data);
+    if (d == NULL) {
+        return NULL;
+    }
+    ucd_data_copy_header(d, src);
+    memset(d->data, 0, (size_t)num_nodes * src->num_data * sizeof(float));
+    for (j = 0; j < src->num_data; ++j) {
+        column = ucd_data_column(src, j, &ld);
+        for (i = 0; i < src->num_rows; ++i) {
+            if (kept[i]) {
+                k = node_index[cluster[i]];
+                d->data[(size_t)k * d->num_data + j] += column[(size_t)ld * i];
+            }
+        }
+    }
+    for (k = 0; k < num_nodes; ++k) {
+        d->row_id[k] = k + 1;
+        for (j = 0; j < d->num_data; ++j) {
+            d->data[(size_t)k * d->num_data + j] /= count[k];
+        }
+    }
+    ucd_data_update_minmax(d);
+    return d;
+}
+
+
+/* cell data of the cells which elements come from */
+static ucd_data* _ucd_preview_cdata(const ucd_data* src,
+        const struct ucd_preview_elements* e)
+{
+    ucd_data* d;
+    const float* column;
+    int ld, i, j;
+
+    d = ucd_data_alloc(e->num, src->num_data);
+    if (d == NULL) {
+        return NULL;
+    }
+    ucd_data_copy_header(d, src);
+    for (j = 0; j < src->num_data; ++j) {
+        column = ucd_data_column(src, j, &ld);
+        for (i = 0; i < e->num; ++i) {
+            d->data[(size_t)i * d->num_data + j]
+                = column[(size_t)ld * e->owner[i]];
+        }
+    }
+    for (i = 0; i < e->num; ++i) {
+        d->row_id[i] = i + 1;
+    }
+    ucd_data_update_minmax(d);
+    return d;
+}
+
+
+int ucd_preview(ucd_content* lod, const ucd_content* ucd,
+        const ucd_adjacency* adj, int resolution)
+{
+    struct ucd_preview_elements e;
+    int *cluster, *used, *count;
+    char* kept;
+    double* sums;
+    int num_clusters, num_nodes, has_error, i, j, k;
+
+    memset(lod, 0, sizeof(*lod));
+    memset(&e, 0, sizeof(e));
+    if (resolution < 1 || resolution > UCD_PREVIEW_MAX_RESOLUTION) {
+        fprintf(stderr, "%s: resolution %d is invalid\n",
+                __func__, resolution);
+        return EXIT_FAILURE;
+    }
+
+    cluster = malloc(ucd->num_nodes * sizeof(int) + 1);
+    kept = calloc(ucd->num_nodes + 1, sizeof(char));
+    used = NULL;
+    count = NULL;
+    sums = NULL;
+    num_clusters = cluster != NULL && kept != NULL
+        ? _ucd_preview_clusters(ucd, resolution, cluster) : -1;
+    if (num_clusters >= 0) {
+        used = calloc(num_clusters + 1, sizeof(int));
+    }
+    has_error = used == NULL;
+    if (has_error) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+    } else {
+        has_error = _ucd_preview_elements(&e, ucd, adj, cluster, used, kept);
+    }
+
+    /* used clusters become nodes, which used[] maps to */
+    num_nodes = 0;
+    if (!has_error) {
+        for (k = 0; k < num_clusters; ++k) {
+            used[k] = used[k] ? num_nodes++ : -1;
+        }
+        count = calloc(num_nodes + 1, sizeof(int));
+        sums = calloc(3 * (size_t)num_nodes + 1, sizeof(double));
+        has_error = count == NULL || sums == NULL
+            || ucd_simple_alloc(lod, num_nodes, e.num, 4);
+        if (has_error) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        }
+    }
+
+    if (!has_error) {
+        for (i = 0; i < ucd->num_nodes; ++i) {
+            if (kept[i]) {
+                k = used[cluster[i]];
+                ++count[k];
+                sums[3 * k] += ucd->node_x[i];
+                sums[3 * k + 1] += ucd->node_y[i];
+                sums[3 * k + 2] += ucd->node_z[i];
+            }
+        }
+        for (k = 0; k < num_nodes; ++k) {
+            lod->node_id[k] = k + 1;
+            lod->node_x[k] = (float)(sums[3 * k] / count[k]);
+            lod->node_y[k] = (float)(sums[3 * k + 1] / count[k]);
+            lod->node_z[k] = (float)(sums[3 * k + 2] / count[k]);
+        }
+        for (i = 0; i < e.num; ++i) {
+            lod->cell_id[i] = i + 1;
+            lod->cell_mat_id[i] = ucd->cell_mat_id[e.owner[i]];
+            lod->cell_type[i] = e.type[i];
+            for (j = 0; j < 4; ++j) {
+                lod->cell_nlist[4 * i + j] = j < ucd_cell_nlist_size(e.type[i])
+                    ? used[e.nlist[4 * i + j]] + 1 : 0;
+            }
+        }
+        if (ucd->ndata != NULL) {
+            lod->ndata = _ucd_preview_ndata(ucd->ndata, num_nodes,
+                    cluster, used, kept, count);
+            has_error = lod->ndata == NULL;
+        }
+        if (!has_error && ucd->cdata != NULL) {
+            lod->cdata = _ucd_preview_cdata(ucd->cdata, &e);
+            has_error = lod->cdata == NULL;
+        }
+        if (has_error) {
+            ucd_simple_free(lod);
+            memset(lod, 0, sizeof(*lod));
+        }
+    }
+
+    free(cluster);
+    free(kept);
+    free(used);
+    free(count);
+    free(sums);
+    free(e.type);
+    free(e.owner);
+    free(e.nlist);
+    return has_error;
+}
+
+
+/* resolution of the mesh itself, from its cells in the extents they span */
+static double _ucd_preview_native(const ucd_content* ucd)
+{
+    const float* coords[3];
+    double extent[3], t, volume;
+    float lower, upper;
+    int dim, axis, i, j;
+
+    dim = 0;
+    for (i = 0; i < ucd->num_cells; ++i) {
+        j = ucd->cell_type[i];
+        j = j < 2 ? j : j < 4 ? 2 : 3;
+        dim = j > dim ? j : dim;
+    }
+    coords[0] = ucd->node_x;
+    coords[1] = ucd->node_y;
+    coords[2] = ucd->node_z;
+    for (axis = 0; axis < 3; ++axis) {
+        lower = upper = ucd->num_nodes > 0 ? coords[axis][0] : 0;
+        for (i = 1; i < ucd->num_nodes; ++i) {
+            if (coords[axis][i] < lower) {
+                lower = coords[axis][i];
+            }
+            if (coords[axis][i] > upper) {
+                upper = coords[axis][i];
+            }
+        }
+        extent[axis] = (double)upper - lower;
+    }
+    /* the longest extents first */
+    for (i = 0; i < 3; ++i) {
+        for (j = i + 1; j < 3; ++j) {
+            if (extent[j] > extent[i]) {
+                t = extent[i];
+                extent[i] = extent[j];
+                extent[j] = t;
+            }
+        }
+    }
+
+    /* points and a mesh of no extent are as fine as they can be */
+    if (dim == 0 || extent[0] <= 0) {
+        return dim == 0 ? ucd->num_nodes : 1;
+    }
+    volume = 1;
+    for (axis = 0; axis < dim; ++axis) {
+        volume *= extent[axis] > 0 ? extent[axis] : extent[0];
+    }
+    return extent[0] * pow(ucd->num_cells / volume, 1.0 / dim);
+}
+
+
+int ucd_preview_writer(const ucd_content* ucd, const char* filename,
+        int num_levels, int resolution)
+{
+    ucd_adjacency adj;
+    ucd_content lod;
+    const char* ext;
+    char* name;
+    size_t base;
+    double native;
+    int has_error, num_cells, level;
+
+    if (resolution < 1 || resolution > UCD_PREVIEW_MAX_RESOLUTION) {
+        fprintf(stderr, "%s: resolution %d is invalid\n",
+                __func__, resolution);
+        return EXIT_FAILURE;
+    }
+    /* the first level merges at least two nodes per side */
+    native = _ucd_preview_native(ucd) / 2;
+    if (native < resolution) {
+        resolution = native > 1 ? (int)native : 1;
+    }
+    if (ucd_adjacency_build(&adj, ucd)) {
+        return EXIT_FAILURE;
+    }
+    /* x.inp is previewed in x.lod1.inp, x.lod2.inp, ... */
+    ext = strrchr(filename, '.');
+    base = ext != NULL && strcmp(ext, ".inp") == 0
+        ? (size_t)(ext - filename) : strlen(filename);
+    name = malloc(base + 32);
+    if (name == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_adjacency_free(&adj);
+        return EXIT_FAILURE;
+    }
+
+    has_error = EXIT_SUCCESS;
+    num_cells = ucd->num_cells;
+    for (level = 1; level <= num_levels && !has_error; ++level) {
+        has_error = ucd_preview(&lod, ucd, &adj, resolution);
+        if (has_error) {
+            break;
+        }
+        /* an empty level, or one as large as the last, is no preview */
+        if ((lod.num_cells == 0 && num_cells > 0)
+                || (level > 1 ? lod.num_cells >= num_cells
+                    : lod.num_cells > num_cells)) {
+            ucd_simple_free(&lod);
+            break;
+        }
+        num_cells = lod.num_cells;
+        memcpy(name, filename, base);
+        sprintf(name + base, ".lod%d.inp", level);
+        has_error = ucd_simple_writer(&lod, name, 1);
+        ucd_simple_free(&lod);
+        resolution = resolution > 1 ? resolution / 2 : 1;
+    }
+
+    free(name);
+    ucd_adjacency_free(&adj);
+    return has_error;
+}
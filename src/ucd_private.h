@@ -14,6 +14,65 @@
 #include "config.h"
 #endif
 
+/**
+ * Offsets in bytes of sections in a binary file.
+ * Index 0 and 1 of arrays are for node and cell data respectively.
+ * Offsets of absent data are the same as the next section.
+ */
+typedef struct {
+    long cells;
+    long nlist;
+    long coords;
+    long header[2];
+    long minmax[2];
+    long body[2];
+    long active[2];
+    long end;
+} ucd_binary_layout;
+
+/** Buffers of ucd_write_data_rows() for a section of data. */
+struct ucd_rows_buffer {
+    int num_comp;
+    int* components;
+    int num_buffered;   /* rows in the buffer */
+    int has_minmax;     /* minima and maxima are written before rows */
+    char* buffer;       /* encoded rows, by components */
+};
+
+/** CRC32C of bytes of a file from @c first to @c last. */
+struct ucd_crc_span {
+    long first;
+    long last;
+    unsigned int crc;
+};
+
+/**
+ * Checksums of bytes read or written through a file handle.  Contiguous
+ * bytes are accumulated into the current run, which ends at bounds of
+ * sections, and runs are combined into checksums of sections at the end.
+ */
+struct ucd_crc_log {
+    struct ucd_crc_span run;
+    struct ucd_crc_span* spans;
+    int num_spans;
+    int max_spans;
+    int is_writer;      /* spans may be overwritten */
+    int has_error;      /* spans are lost */
+};
+
+/**
+ * A lookup table from node ID to node index.
+ * IDs spanning up to twice the number of nodes are looked up directly,
+ * and sparse IDs by binary search, so the memory is proportional to the
+ * number of nodes.
+ */
+typedef struct {
+    int min_id;
+    int num_ids;        /* size of the direct table, or zero if sparse */
+    int num_nodes;
+    int* table;         /* indices by ID - min_id, or sorted (ID, index) */
+} ucd_node_index;
+
 /** @cond */
 #ifndef __func__
 #define __func__ __FUNCTION__
@@ -25,6 +84,45 @@
  */
 #define UCD_MAGIC_NUMBER 0x07
 
+/**
+ * The magic number of extended binary file format.
+ * The data encoding is stored in place of the number of model data.
+ */
+#define UCD_MAGIC_NUMBER_EXT 0x08
+
+/**
+ * The magic number of chunked container.
+ * The number of rows per chunk is stored in place of the number of model
+ * data.
+ */
+#define UCD_MAGIC_NUMBER_CHUNK 0x09
+
+/**
+ * A flag of codecs in directories of chunked container for chunks with
+ * NaN.
+ */
+#define UCD_CHUNK_FLAG_NAN 0x100
+
+/**
+ * The magic number of time series of data.
+ */
+#define UCD_MAGIC_NUMBER_SERIES 0x0a
+
+/**
+ * The tag at the end of checksum trailer ("UCDC" in little endian).
+ */
+#define UCD_CHECKSUM_TAG 0x43444355
+
+/**
+ * The maximum number of sections with checksums.
+ */
+#define UCD_CHECKSUM_SECTIONS 6
+
+/**
+ * The number of rows processed at once when data are streamed.
+ */
+#define UCD_BLOCK_ROWS 4096
+
 /**
  * Length of label and unit fields in data section.
  */
@@ -41,3 +139,252 @@ static void ucd_data_dimension(
         *num_data = c->_nc == 1 ? c->num_ndata : c->num_cdata;
     }
 }
+
+
+/**
+ * Make a lookup table from node ID to node index.
+ * It should be freed by _ucd_node_index_free().
+ */
+int _ucd_node_index_build(ucd_node_index* index, const ucd_content* ucd);
+void _ucd_node_index_free(ucd_node_index* index);
+
+/** The index of a node ID, or -1 if not found. */
+int _ucd_node_find(const ucd_node_index* index, int id);
+
+/** Size in bytes of a value in the encoding. */
+int _ucd_encoding_size(int encoding);
+
+/**
+ * Nonzero if the range is finite and its width is a finite float, so
+ * values can be quantized against it.
+ */
+int _ucd_range_is_finite(float minimum, float maximum);
+
+/**
+ * Encode rows of floats.
+ * A value at (i, j) is @c src[i * ld_src + j] and quantized against
+ * @c minima[j] and @c maxima[j].  Encoded values are packed in row order.
+ */
+void _ucd_encode(int encoding, const float* src, int ld_src,
+        int num_rows, int num_cols,
+        const float* minima, const float* maxima, void* dst);
+
+/** Decode rows of floats encoded by _ucd_encode(). */
+void _ucd_decode(int encoding, const void* src,
+        int num_rows, int num_cols,
+        const float* minima, const float* maxima, float* dst, int ld_dst);
+
+/** Copy a row of data between data which may have different layouts. */
+void _ucd_data_copy_row(ucd_data* dst, int dst_row,
+        const ucd_data* src, int src_row);
+
+/** Compute offsets of sections from the numbers in the context. */
+void _ucd_binary_layout(const ucd_context* c, ucd_binary_layout* layout);
+
+/** Minimum and maximum of a column of data. */
+void _ucd_data_column_minmax(const ucd_data* d, int col,
+        float* minimum, float* maximum);
+
+/** The number of chunks of a column of the rows. */
+int _ucd_num_chunks(const ucd_context* c, int num_rows);
+
+/**
+ * Read a directory at the offset and return chunks with offsets of
+ * their values.  Chunks of column @c j are from _ucd_num_chunks() times
+ * @c j.  The end of the section is returned in @p end.  Entries of
+ * unknown codecs, wrong sizes or out of the file are rejected.
+ */
+ucd_chunk* _ucd_chunk_directory(ucd_context* c, long offset,
+        int num_cols, int num_rows, long* end);
+
+/**
+ * The end of the last section of a chunked container, found by walking
+ * directories of sections, or -1 if a directory is broken.
+ */
+long _ucd_chunk_end(ucd_context* c);
+
+/**
+ * Read a chunked section of columns at the current position.
+ * Column @c j is read into @c cols[j] with the leading dimension
+ * @c lds[j].  The section is skipped if @p cols is NULL.
+ */
+int _ucd_chunk_read_body(ucd_context* c, int num_cols, int num_rows,
+        float** cols, const int* lds);
+
+/** Write columns as a chunked section with the codec. */
+int _ucd_chunk_write_body(ucd_context* c, int num_cols, int num_rows,
+        const float** cols, const int* lds, int codec);
+
+/** Read columns of data as a chunked section. */
+int _ucd_chunk_read_data(ucd_context* c, ucd_data* d);
+
+/** Write columns of data as a chunked section. */
+int _ucd_chunk_write_data(ucd_context* c, const ucd_data* d);
+
+/**
+ * Allocate content and read nodes and cells following the header.
+ * Data of the content are NULL.  The content is freed on failure.
+ */
+int _ucd_read_geometry(ucd_context* c, ucd_content* ucd);
+
+/** Free buffers of ucd_write_data_rows(). */
+void _ucd_rows_free(ucd_context* c);
+
+/** Prepare tables of _ucd_crc32c(); call it before threads use them. */
+void _ucd_crc32c_init(void);
+
+/** Update CRC32C @p crc by @p size bytes of @p data. */
+unsigned int _ucd_crc32c(unsigned int crc, const void* data, size_t size);
+
+/**
+ * Offsets of sections with checksums, where section @c i is from
+ * @p bounds[i] to @p bounds[i+1].  @p end is the end of the chunked
+ * container.  It returns the number of sections.
+ */
+int _ucd_checksum_sections(const ucd_context* c, long end, long* bounds);
+
+/**
+ * Find the checksum trailer at the end of a file.  It returns the size of
+ * the file without the trailer, and @p num_sections is zero if none.
+ */
+long _ucd_checksum_find(FILE* fp, int* num_sections);
+
+/** Append or overwrite the trailer of a binary file being written. */
+int _ucd_checksum_write(ucd_context* c);
+
+/**
+ * Start a log of checksums of a binary file with checksums.  The header
+ * of a file being read is read again, since the bounds of sections are
+ * not known before it.
+ */
+void _ucd_checksum_track(ucd_context* c);
+
+/** Pass the log to the owner of the context, or free it. */
+void _ucd_checksum_untrack(ucd_context* c);
+
+/**
+ * Verify checksums of a file being read.  Sections of which all bytes
+ * were read are verified from the log, and the others are read again.
+ */
+int _ucd_checksum_verify(ucd_context* c, const char* filename);
+
+/** fread() of a context, where bytes read are fed to its log. */
+size_t _ucd_checksum_fread(ucd_context* c,
+        void* data, size_t size, size_t count);
+
+/** fwrite() of a context, where bytes written are fed to its log. */
+size_t _ucd_checksum_fwrite(ucd_context* c,
+        const void* data, size_t size, size_t count);
+
+/** Allocate an empty log of checksums. */
+struct ucd_crc_log* _ucd_crc_log_alloc(int is_writer);
+
+/** Feed @p size bytes of @p data at @p offset of a file of @p c. */
+void _ucd_crc_log_feed(struct ucd_crc_log* log, const ucd_context* c,
+        long offset, const void* data, size_t size);
+
+/** Move spans of @p from into @p log, and free @p from. */
+void _ucd_crc_log_merge(struct ucd_crc_log* log, struct ucd_crc_log* from);
+
+/** Free a log of checksums. */
+void _ucd_crc_log_free(struct ucd_crc_log* log);
+
+/**
+ * Local node numbers of a face of a cell type, terminated by -1 unless
+ * the face has 4 nodes.  Faces are those of ucd_adjacency.
+ */
+const int* _ucd_cell_face(int cell_type, int face);
+
+/**
+ * Node indices of a cell by the table of _ucd_node_index_build().
+ * It returns EXIT_FAILURE if the cell refers an unknown node.
+ */
+int _ucd_cell_nodes(const ucd_content* ucd, const ucd_node_index* index,
+        int cell, int* nodes);
+
+/**
+ * Node indices of the @p k th cell of type @p type of buckets by the table
+ * of _ucd_node_index_build().  It returns EXIT_FAILURE if the cell refers
+ * an unknown node.
+ */
+int _ucd_bucket_nodes(const ucd_buckets* b, const ucd_content* ucd,
+        const ucd_node_index* index, int type, int k, int* nodes);
+
+/** Access hints of spilled arrays. */
+#define UCD_ADVICE_SEQUENTIAL 0
+#define UCD_ADVICE_RANDOM 1
+
+/**
+ * Allocate an array within the memory budget of a context, or spill it to
+ * a mapping of a temporary file with an access hint if it exceeds the
+ * budget.  Arrays are allocated from the heap if @p c is NULL.  They should
+ * be freed by _ucd_free().
+ */
+void* _ucd_alloc(ucd_context* c, size_t size, int advice);
+
+/** Allocate an array spilled or not as another array. */
+void* _ucd_alloc_like(const void* like, size_t size);
+
+/** Resize an array allocated by _ucd_alloc(). */
+void* _ucd_realloc(void* p, size_t old_size, size_t size);
+
+/** Nonzero if an array is spilled to a mapping. */
+int _ucd_is_spilled(const void* p);
+
+/** Free an array allocated by _ucd_alloc() or malloc(). */
+void _ucd_free(void* p);
+
+/** Free an array and return its size to the budget of a context. */
+void _ucd_budget_free(ucd_context* c, void* p, size_t size);
+
+/** ucd_simple_alloc() within the memory budget of a context. */
+int _ucd_simple_alloc_ex(ucd_content* ucd, ucd_context* c,
+        int num_nodes, int num_cells, int ld_nlist);
+
+/** ucd_data_alloc() within the memory budget of a context. */
+ucd_data* _ucd_data_alloc_ex(ucd_context* c, int num_rows, int num_data);
+
+/**
+ * The number of rows between calls of the progress callback.
+ */
+#define UCD_PROGRESS_ROWS (16 * UCD_BLOCK_ROWS)
+
+/**
+ * Report bytes and rows processed since the last call to the callback of
+ * the context, or of its owner if it is a copy for a thread.  It returns
+ * nonzero if the operation is cancelled.
+ */
+int _ucd_progress(ucd_context* c, long bytes, long rows);
+
+/** Nonzero if the context or its owner has the callback. */
+int _ucd_has_progress(const ucd_context* c);
+
+/** Reset counters of progress before an operation. */
+void _ucd_progress_reset(ucd_context* c);
+
+/**
+ * Set options, or the defaults if NULL, and reset private members of a
+ * context to open, whatever the context has.
+ */
+void _ucd_context_open(ucd_context* c, const ucd_options* o);
+
+/**
+ * Report progress of rows of text or small writes after @p done rows of
+ * @p total.  It is reported by blocks of rows and at the last row, with
+ * bytes from the position @p pos, which is updated to the current
+ * position of the file.  A row is counted as @p columns rows.
+ */
+int _ucd_progress_rows(ucd_context* c, long* pos, long done, long total,
+        int columns);
+
+/**
+ * Read @p num_rows rows of @p row_size bytes by blocks with progress,
+ * where a row is counted as @p columns rows.  It returns nonzero if
+ * cancelled; errors of the file are left to ferror().
+ */
+int _ucd_progress_fread(ucd_context* c, void* data,
+        size_t row_size, long num_rows, int columns);
+
+/** Write rows by blocks with progress as _ucd_progress_fread(). */
+int _ucd_progress_fwrite(ucd_context* c, const void* data,
+        size_t row_size, long num_rows, int columns);
@@ -0,0 +1,412 @@
+/**
+ * @file ucd_quality.c
+ * @brief Functions relate to geometric quality of cells.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ *
+ * Cells are grouped by ucd_buckets_build() and processed by batches of a
+ * bucket.  Coordinates of a batch are gathered into arrays by local nodes,
+ * so the innermost loops of kernels run over cells of the batch and can
+ * be vectorized by compilers.
+ */
+
+#include <math.h>
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/** The number of cells of a batch. */
+#define UCD_QUALITY_BATCH 256
+
+/** The number of metrics of a cell. */
+#define UCD_QUALITY_METRICS 4
+
+/* edges of cell types */
+static const int _ucd_num_edges[8] = {0, 1, 3, 4, 6, 8, 9, 12};
+
+static const int _ucd_edges[8][12][2] = {
+    {{0, 0}},
+    {{0, 1}},
+    {{0, 1}, {1, 2}, {2, 0}},
+    {{0, 1}, {1, 2}, {2, 3}, {3, 0}},
+    {{0, 1}, {1, 2}, {2, 0}, {0, 3}, {1, 3}, {2, 3}},
+    {{1, 2}, {2, 3}, {3, 4}, {4, 1}, {0, 1}, {0, 2}, {0, 3}, {0, 4}},
+    {{0, 1}, {1, 2}, {2, 0}, {3, 4}, {4, 5}, {5, 3}, {0, 3}, {1, 4}, {2, 5}},
+    {{0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6}, {6, 7}, {7, 4},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}}
+};
+
+/*
+ * Corners of cell types and their neighbors in the positive orientation.
+ * Corners of 2D cells have two neighbors.  The apex of pyr is omitted.
+ */
+static const int _ucd_num_corners[8] = {0, 0, 3, 4, 4, 4, 6, 8};
+
+static const int _ucd_corners[8][8][4] = {
+    {{0, 0, 0, 0}},
+    {{0, 0, 0, 0}},
+    {{0, 1, 2, -1}, {1, 2, 0, -1}, {2, 0, 1, -1}},
+    {{0, 1, 3, -1}, {1, 2, 0, -1}, {2, 3, 1, -1}, {3, 0, 2, -1}},
+    {{0, 1, 2, 3}, {1, 2, 0, 3}, {2, 0, 1, 3}, {3, 0, 2, 1}},
+    {{1, 2, 4, 0}, {2, 3, 1, 0}, {3, 4, 2, 0}, {4, 1, 3, 0}},
+    {{0, 1, 2, 3}, {1, 2, 0, 4}, {2, 0, 1, 5},
+        {3, 5, 4, 0}, {4, 3, 5, 1}, {5, 4, 3, 2}},
+    {{0, 1, 3, 4}, {1, 2, 0, 5}, {2, 3, 1, 6}, {3, 0, 2, 7},
+        {4, 7, 5, 0}, {5, 4, 6, 1}, {6, 5, 7, 2}, {7, 6, 4, 3}}
+};
+
+/* the polygon of a 2D cell for skewness */
+static const int _ucd_polygon[4] = {0, 1, 2, 3};
+
+typedef struct {
+    float x[8][UCD_QUALITY_BATCH];
+    float y[8][UCD_QUALITY_BATCH];
+    float z[8][UCD_QUALITY_BATCH];
+} _ucd_quality_batch;
+
+
+/* measure from simplices of the centroid and faces as ucd_cell_measures() */
+static void _ucd_quality_measure(const _ucd_quality_batch* g,
+        int cell_type, int n, float* measure)
+{
+    float px[UCD_QUALITY_BATCH], py[UCD_QUALITY_BATCH], pz[UCD_QUALITY_BATCH];
+    float ax, ay, az, bx, by, bz, cx, cy, cz;
+    const int* face;
+    int nsize, num_faces, f, j, k, b;
+
+    nsize = ucd_cell_nlist_size(cell_type);
+    for (b = 0; b < n; ++b) {
+        px[b] = py[b] = pz[b] = 0;
+        measure[b] = 0;
+    }
+    for (j = 0; j < nsize; ++j) {
+        for (b = 0; b < n; ++b) {
+            px[b] += g->x[j][b] / nsize;
+            py[b] += g->y[j][b] / nsize;
+            pz[b] += g->z[j][b] / nsize;
+        }
+    }
+
+    num_faces = ucd_cell_num_faces(cell_type);
+    for (f = 0; f < num_faces; ++f) {
+        face = _ucd_cell_face(cell_type, f);
+        k = face[3] >= 0 ? 4 : face[2] >= 0 ? 3 : face[1] >= 0 ? 2 : 1;
+        for (j = 0; j == 0 || j + 2 < k; ++j) {
+            for (b = 0; b < n; ++b) {
+                ax = g->x[face[0]][b] - px[b];
+                ay = g->y[face[0]][b] - py[b];
+                az = g->z[face[0]][b] - pz[b];
+                if (k == 1) {
+                    measure[b] += (float)sqrt(ax * ax + ay * ay + az * az);
+                    continue;
+                }
+                bx = g->x[face[j+1]][b] - px[b];
+                by = g->y[face[j+1]][b] - py[b];
+                bz = g->z[face[j+1]][b] - pz[b];
+                cx = ay * bz - az * by;
+                cy = az * bx - ax * bz;
+                cz = ax * by - ay * bx;
+                if (k == 2) {
+                    measure[b] += (float)sqrt(cx * cx + cy * cy + cz * cz) / 2;
+                    continue;
+                }
+                bx = g->x[face[j+2]][b] - px[b];
+                by = g->y[face[j+2]][b] - py[b];
+                bz = g->z[face[j+2]][b] - pz[b];
+                measure[b] += (float)fabs(cx * bx + cy * by + cz * bz) / 6;
+            }
+        }
+    }
+}
+
+
+/*
+ * The minimum of scaled Jacobians at corners, which are determinants of
+ * unit edge vectors.  Corners of 2D cells are measured against the
+ * normal of the cell.
+ */
+static void _ucd_quality_jacobian(const _ucd_quality_batch* g,
+        int cell_type, int n, float* jacobian)
+{
+    float nx[UCD_QUALITY_BATCH], ny[UCD_QUALITY_BATCH], nz[UCD_QUALITY_BATCH];
+    float e[3][3], cx, cy, cz, len, det;
+    const int* corner;
+    int num_corners, i, j, b;
+
+    num_corners = _ucd_num_corners[cell_type];
+    for (b = 0; b < n; ++b) {
+        jacobian[b] = num_corners > 0 ? 1e30f : 1;
+        nx[b] = ny[b] = nz[b] = 0;
+    }
+
+    /* normals of 2D cells */
+    for (i = 0; i < num_corners && _ucd_corners[cell_type][i][3] < 0; ++i) {
+        corner = _ucd_corners[cell_type][i];
+        for (b = 0; b < n; ++b) {
+            e[0][0] = g->x[corner[1]][b] - g->x[corner[0]][b];
+            e[0][1] = g->y[corner[1]][b] - g->y[corner[0]][b];
+            e[0][2] = g->z[corner[1]][b] - g->z[corner[0]][b];
+            e[1][0] = g->x[corner[2]][b] - g->x[corner[0]][b];
+            e[1][1] = g->y[corner[2]][b] - g->y[corner[0]][b];
+            e[1][2] = g->z[corner[2]][b] - g->z[corner[0]][b];
+            nx[b] += e[0][1] * e[1][2] - e[0][2] * e[1][1];
+            ny[b] += e[0][2] * e[1][0] - e[0][0] * e[1][2];
+            nz[b] += e[0][0] * e[1][1] - e[0][1] * e[1][0];
+        }
+    }
+
+    for (i = 0; i < num_corners; ++i) {
+        corner = _ucd_corners[cell_type][i];
+        for (b = 0; b < n; ++b) {
+            for (j = 0; j < 3; ++j) {
+                if (j == 2 && corner[3] < 0) {
+                    len = (float)sqrt(nx[b] * nx[b] + ny[b] * ny[b]
+                            + nz[b] * nz[b]);
+                    e[2][0] = nx[b];
+                    e[2][1] = ny[b];
+                    e[2][2] = nz[b];
+                } else {
+                    e[j][0] = g->x[corner[j+1]][b] - g->x[corner[0]][b];
+                    e[j][1] = g->y[corner[j+1]][b] - g->y[corner[0]][b];
+                    e[j][2] = g->z[corner[j+1]][b] - g->z[corner[0]][b];
+                    len = (float)sqrt(e[j][0] * e[j][0] + e[j][1] * e[j][1]
+                            + e[j][2] * e[j][2]);
+                }
+                len = len > 0 ? len : 1;
+                e[j][0] /= len;
+                e[j][1] /= len;
+                e[j][2] /= len;
+            }
+            cx = e[0][1] * e[1][2] - e[0][2] * e[1][1];
+            cy = e[0][2] * e[1][0] - e[0][0] * e[1][2];
+            cz = e[0][0] * e[1][1] - e[0][1] * e[1][0];
+            det = cx * e[2][0] + cy * e[2][1] + cz * e[2][2];
+            jacobian[b] = det < jacobian[b] ? det : jacobian[b];
+        }
+    }
+}
+
+
+/* the ratio of the longest edge to the shortest one */
+static void _ucd_quality_aspect(const _ucd_quality_batch* g,
+        int cell_type, int n, float* aspect)
+{
+    float lo[UCD_QUALITY_BATCH], hi[UCD_QUALITY_BATCH];
+    float dx, dy, dz, len;
+    int num_edges, i, b, u, v;
+
+    num_edges = _ucd_num_edges[cell_type];
+    for (b = 0; b < n; ++b) {
+        lo[b] = 1e30f;
+        hi[b] = 0;
+    }
+    for (i = 0; i < num_edges; ++i) {
+        u = _ucd_edges[cell_type][i][0];
+        v = _ucd_edges[cell_type][i][1];
+        for (b = 0; b < n; ++b) {
+            dx = g->x[v][b] - g->x[u][b];
+            dy = g->y[v][b] - g->y[u][b];
+            dz = g->z[v][b] - g->z[u][b];
+            len = dx * dx + dy * dy + dz * dz;
+            lo[b] = len < lo[b] ? len : lo[b];
+            hi[b] = len > hi[b] ? len : hi[b];
+        }
+    }
+    for (b = 0; b < n; ++b) {
+        aspect[b] = num_edges == 0 ? 1
+            : lo[b] > 0 ? (float)sqrt(hi[b] / lo[b]) : 1e30f;
+    }
+}
+
+
+/*
+ * Equiangle skewness, the largest deviation of angles of polygons from
+ * those of the equilateral polygon, normalized from 0 to 1.  Polygons are
+ * faces of 3D cells and 2D cells themselves.
+ */
+static void _ucd_quality_skew(const _ucd_quality_batch* g,
+        int cell_type, int n, float* skew)
+{
+    float lo[UCD_QUALITY_BATCH], hi[UCD_QUALITY_BATCH];
+    float ax, ay, az, bx, by, bz, la, lb, c, angle, equi, s;
+    const int* poly;
+    int num_polys, f, i, k, b, u, v, w;
+
+    for (b = 0; b < n; ++b) {
+        skew[b] = 0;
+    }
+    if (cell_type == 2 || cell_type == 3) {
+        num_polys = 1;
+    } else if (cell_type >= 4 && cell_type <= 7) {
+        num_polys = ucd_cell_num_faces(cell_type);
+    } else {
+        return;
+    }
+
+    for (f = 0; f < num_polys; ++f) {
+        if (num_polys == 1) {
+            poly = _ucd_polygon;
+            k = ucd_cell_nlist_size(cell_type);
+        } else {
+            poly = _ucd_cell_face(cell_type, f);
+            k = poly[3] < 0 ? 3 : 4;
+        }
+        equi = k == 3 ? 1.04719755f : 1.57079633f;
+        for (b = 0; b < n; ++b) {
+            lo[b] = 4;
+            hi[b] = 0;
+        }
+        for (i = 0; i < k; ++i) {
+            u = poly[(i + k - 1) % k];
+            v = poly[i];
+            w = poly[(i + 1) % k];
+            for (b = 0; b < n; ++b) {
+                ax = g->x[u][b] - g->x[v][b];
+                ay = g->y[u][b] - g->y[v][b];
+                az = g->z[u][b] - g->z[v][b];
+                bx = g->x[w][b] - g->x[v][b];
+                by = g->y[w][b] - g->y[v][b];
+                bz = g->z[w][b] - g->z[v][b];
+                la = ax * ax + ay * ay + az * az;
+                lb = bx * bx + by * by + bz * bz;
+                c = la > 0 && lb > 0
+                    ? (ax * bx + ay * by + az * bz) / (float)sqrt(la * lb) : 1;
+                c = c > 1 ? 1 : c < -1 ? -1 : c;
+                angle = (float)acos(c);
+                lo[b] = angle < lo[b] ? angle : lo[b];
+                hi[b] = angle > hi[b] ? angle : hi[b];
+            }
+        }
+        for (b = 0; b < n; ++b) {
+            s = (hi[b] - equi) / (3.14159265f - equi);
+            c = (equi - lo[b]) / equi;
+            s = c > s ? c : s;
+            skew[b] = s > skew[b] ? s : skew[b];
+        }
+    }
+}
+
+
+ucd_data* ucd_cell_quality(const ucd_content* ucd)
+{
+    static const char labels[] = "measure\0jacobian\0aspect\0skew";
+    static const char units[] = "none\0none\0none\0none";
+    ucd_data* d;
+    ucd_node_index index;
+    ucd_buckets buckets;
+    float* bucketed;
+    int* batch;
+    int num_batches, has_error, t, i, k;
+
+    if (ucd_buckets_build(&buckets, ucd)) {
+        return NULL;
+    }
+    _ucd_node_index_build(&index, ucd);
+    batch = malloc((ucd->num_cells / UCD_QUALITY_BATCH + 9) * sizeof(*batch));
+    bucketed = malloc(((size_t)ucd->num_cells * UCD_QUALITY_METRICS + 1)
+            * sizeof(*bucketed));
+    d = ucd_data_alloc(ucd->num_cells, UCD_QUALITY_METRICS);
+    if (index.table == NULL || batch == NULL || bucketed == NULL
+            || d == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_buckets_free(&buckets);
+        _ucd_node_index_free(&index);
+        free(batch);
+        free(bucketed);
+        if (d != NULL) {
+            ucd_data_free(d);
+        }
+        return NULL;
+    }
+
+    /* batches are split at ends of buckets */
+    num_batches = 0;
+    for (t = 0; t < 8; ++t) {
+        for (i = buckets.offset[t]; i < buckets.offset[t + 1];
+                i += UCD_QUALITY_BATCH) {
+            batch[num_batches++] = i;
+        }
+    }
+    batch[num_batches] = ucd->num_cells;
+
+    has_error = EXIT_SUCCESS;
+#ifdef _OPENMP
+#pragma omp parallel reduction(|:has_error)
+#endif
+    {
+        _ucd_quality_batch* g;
+        float metrics[UCD_QUALITY_METRICS][UCD_QUALITY_BATCH];
+        int nodes[8];
+        int cell_type, first, n, b, j, m;
+
+        g = malloc(sizeof(*g));
+        if (g == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            has_error = EXIT_FAILURE;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (k = 0; k < num_batches; ++k) {
+            if (g == NULL) {
+                continue;
+            }
+            n = batch[k + 1] - batch[k];
+            cell_type = ucd->cell_type[buckets.order[batch[k]]];
+            first = batch[k] - buckets.offset[cell_type];
+            for (b = 0; b < n; ++b) {
+                if (_ucd_bucket_nodes(&buckets, ucd, &index,
+                            cell_type, first + b, nodes)) {
+                    has_error = EXIT_FAILURE;
+                    break;
+                }
+                for (j = 0; j < ucd_cell_nlist_size(cell_type); ++j) {
+                    g->x[j][b] = ucd->node_x[nodes[j]];
+                    g->y[j][b] = ucd->node_y[nodes[j]];
+                    g->z[j][b] = ucd->node_z[nodes[j]];
+                }
+            }
+            if (b < n) {
+                continue;
+            }
+
+            _ucd_quality_measure(g, cell_type, n, metrics[0]);
+            _ucd_quality_jacobian(g, cell_type, n, metrics[1]);
+            _ucd_quality_aspect(g, cell_type, n, metrics[2]);
+            _ucd_quality_skew(g, cell_type, n, metrics[3]);
+
+            for (b = 0; b < n; ++b) {
+                for (m = 0; m < UCD_QUALITY_METRICS; ++m) {
+                    bucketed[UCD_QUALITY_METRICS * (batch[k] + b) + m]
+                        = metrics[m][b];
+                }
+            }
+        }
+        free(g);
+    }
+
+    if (!has_error) {
+        ucd_buckets_scatter(&buckets, bucketed, UCD_QUALITY_METRICS,
+                d->data, UCD_QUALITY_METRICS);
+    }
+    ucd_buckets_free(&buckets);
+    _ucd_node_index_free(&index);
+    free(batch);
+    free(bucketed);
+    if (has_error) {
+        ucd_data_free(d);
+        return NULL;
+    }
+
+    d->num_comp = UCD_QUALITY_METRICS;
+    for (k = 0; k < UCD_QUALITY_METRICS; ++k) {
+        d->components[k] = 1;
+    }
+    memcpy(d->labels, labels, sizeof(labels));
+    memcpy(d->units, units, sizeof(units));
+    memcpy(d->row_id, ucd->cell_id, ucd->num_cells * sizeof(*d->row_id));
+    ucd_data_update_minmax(d);
+    return d;
+}
@@ -14,23 +14,25 @@
 
 
 static void _ucd_ignore_lines(ucd_context* c, int count) {
+    int ch;
+
     while (count-- > 0) {
-        while (getc(c->_fp) != '\n');
+        while ((ch = getc(c->_fp)) != '\n' && ch != EOF);
+        if (ch == EOF) {
+            return;
+        }
     }
 }
 
 
-static void _ucd_simple_reader_sub(ucd_context* c, ucd_data* d)
+static int _ucd_simple_reader_sub(ucd_context* c, ucd_data* d)
 {
-    int i, j, k, base_col;
-
-    d->components = malloc(d->num_data * sizeof(*d->components));
-    d->minima = malloc(d->num_data * sizeof(*d->maxima));
-    d->maxima = malloc(d->num_data * sizeof(*d->minima));
-    d->row_id = malloc(d->num_rows * sizeof(*d->row_id));
-    d->data = malloc(d->num_rows * d->num_data * sizeof(*d->data));
+    int i;
 
-    ucd_read_data_header(c, &d->num_comp, d->components, d->labels, d->units);
+    if (ucd_read_data_header(c,
+                &d->num_comp, d->components, d->labels, d->units)) {
+        return EXIT_FAILURE;
+    }
 
     if (c->is_binary) {
         ucd_read_data_minmax(c, d->minima, d->maxima);
@@ -39,139 +41,400 @@ static void _ucd_simple_reader_sub(ucd_context* c, ucd_data* d)
             d->row_id[i] = i + 1;
         }
 
-        base_col = 0;
+        d->layout = c->layout;
+        if (c->chunk_rows > 0) {
+            return _ucd_chunk_read_data(c, d);
+        }
+        /* blocks are read by _ucd_simple_reader_blocks() */
         for (i = 0; i < d->num_comp; ++i) {
-            ucd_read_data_binary(c,
-                    d->components[i], &d->data[base_col], d->num_data);
-            base_col += d->components[i];
+            ucd_read_data_binary(c, d->components[i], NULL, 0);
         }
-        ucd_read_data_active_list(c, NULL);
-    } else {
-        ucd_read_data_ascii(c, d->row_id, d->data);
+        return ucd_read_data_active_list(c, NULL);
+    }
 
-        for (i = 0; i < d->num_data; ++i) {
-            d->minima[i] = +FLT_MAX;
-            d->maxima[i] = -FLT_MAX;
-        }
-        for (i = 0; i < d->num_rows; ++i) {
-            for(j = 0; j < d->num_data; ++j) {
-                if (d->data[d->num_data * i + j] < d->minima[j]) {
-                    d->minima[j] = d->data[d->num_data * i + j];
-                }
-                if (d->data[d->num_data * i + j] > d->maxima[j]) {
-                    d->maxima[j] = d->data[d->num_data * i + j];
-                }
+    if (ucd_read_data_ascii(c, d->row_id, d->data)) {
+        return EXIT_FAILURE;
+    }
+    ucd_data_update_minmax(d);
+    return ucd_data_set_layout(d, c->layout);
+}
+
+
+/*
+ * Component blocks of binary format are read in parallel by threads with
+ * their own cursors.  They are split into blocks of rows for progress.
+ */
+static int _ucd_simple_reader_blocks(ucd_context* c,
+        const char* filename, ucd_content* ucd)
+{
+    int num_tasks, has_error, t;
+
+    num_tasks = (ucd->ndata != NULL ? ucd->ndata->num_comp : 0)
+        + (ucd->cdata != NULL ? ucd->cdata->num_comp : 0);
+    has_error = EXIT_SUCCESS;
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(|:has_error)
+#endif
+    {
+        ucd_cursor cur;
+        ucd_data* d;
+        float* data;
+        int is_cell, comp, ld, first, n;
+
+        has_error = ucd_cursor_open(&cur, c, filename);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (t = 0; t < num_tasks; ++t) {
+            if (has_error) {
+                continue;
+            }
+            is_cell = ucd->ndata == NULL || t >= ucd->ndata->num_comp;
+            d = is_cell ? ucd->cdata : ucd->ndata;
+            comp = is_cell && ucd->ndata != NULL
+                ? t - ucd->ndata->num_comp : t;
+            data = ucd_data_component(d, comp, &ld);
+            if (!_ucd_has_progress(c)) {
+                has_error = ucd_cursor_read_component(&cur, is_cell, comp,
+                        0, d->num_rows, data, ld);
+                continue;
             }
+            for (first = 0; first < d->num_rows && !has_error; first += n) {
+                n = d->num_rows - first < UCD_PROGRESS_ROWS
+                    ? d->num_rows - first : UCD_PROGRESS_ROWS;
+                has_error = ucd_cursor_read_component(&cur, is_cell, comp,
+                        first, n, &data[(long)ld * first], ld)
+                    || _ucd_progress(c, (long)n * d->components[comp]
+                            * _ucd_encoding_size(c->encoding),
+                            (long)n * d->components[comp]);
+            }
+        }
+        if (cur._fp != NULL) {
+            has_error |= ucd_cursor_close(&cur);
         }
     }
+
+    return has_error;
 }
 
 
 int ucd_simple_reader(ucd_content* ucd, const char* filename, int* was_binary)
 {
     ucd_context c;
-    int i, j, k;
+    int has_error;
+
+    has_error = ucd_simple_reader_ex(ucd, filename, NULL, &c);
+
+    if (was_binary != NULL) {
+        *was_binary = c.is_binary;
+    }
+
+    return has_error;
+}
+
+
+int _ucd_read_geometry(ucd_context* c, ucd_content* ucd)
+{
+    int has_error, i, j, k;
     int *int_buffer1, *int_buffer2;
+    size_t size1, size2;
 
-    /* header */
-    ucd_reader_open(&c, filename);
+    if (_ucd_simple_alloc_ex(ucd, c,
+                c->num_nodes, c->num_cells, 8 /* hex */)) {
+        return EXIT_FAILURE;
+    }
 
-    /* nodes and cells */
-    ucd->ld_nlist = 8; /* hex */
-    ucd->node_id = malloc(c.num_nodes * sizeof(*ucd->node_id));
-    ucd->node_x = malloc(c.num_nodes * sizeof(*ucd->node_x));
-    ucd->node_y = malloc(c.num_nodes * sizeof(*ucd->node_y));
-    ucd->node_z = malloc(c.num_nodes * sizeof(*ucd->node_z));
-    ucd->cell_id = malloc(c.num_cells * sizeof(*ucd->cell_id));
-    ucd->cell_mat_id = malloc(c.num_cells * sizeof(*ucd->cell_mat_id));
-    ucd->cell_type = malloc(c.num_cells * sizeof(*ucd->cell_type));
-    ucd->cell_nlist = malloc(ucd->ld_nlist * c.num_cells * sizeof(*ucd->cell_nlist));
-
-    int_buffer1 = malloc(4 * c.num_cells * sizeof(*int_buffer1));
-    if (c.is_binary) {
-        int_buffer2 = malloc(c.num_nlist * sizeof(*int_buffer2));
+    size1 = 4 * (size_t)c->num_cells * sizeof(*int_buffer1);
+    size2 = (size_t)c->num_nlist * sizeof(*int_buffer2);
+    int_buffer1 = _ucd_alloc(c, size1, UCD_ADVICE_SEQUENTIAL);
+    if (c->is_binary) {
+        int_buffer2 = _ucd_alloc(c, size2, UCD_ADVICE_SEQUENTIAL);
     } else {
         int_buffer2 = ucd->cell_nlist;
     }
-    ucd_read_nodes_and_cells(&c,
+    if (int_buffer1 == NULL || int_buffer2 == NULL) {
+        fprintf(stderr, "%s: cannot allocate buffers\n", __func__);
+        _ucd_budget_free(c, int_buffer1, size1);
+        if (c->is_binary) {
+            _ucd_budget_free(c, int_buffer2, size2);
+        }
+        ucd_simple_free(ucd);
+        return EXIT_FAILURE;
+    }
+    has_error = ucd_read_nodes_and_cells(c,
             ucd->node_id, ucd->node_x, ucd->node_y, ucd->node_z,
             int_buffer1, int_buffer2, ucd->ld_nlist);
 
     k = 0;
-    for (i = 0; i < c.num_cells; ++i) {
+    for (i = 0; i < c->num_cells && !has_error; ++i) {
         ucd->cell_id[i] = int_buffer1[4*i];
         ucd->cell_mat_id[i] = int_buffer1[4*i+1];
         ucd->cell_type[i] = int_buffer1[4*i+3];
-        if (c.is_binary) {
+        if (c->is_binary) {
+            /* checksums are verified after all sections are read */
+            if (int_buffer1[4*i+2] < 0 || int_buffer1[4*i+2] > ucd->ld_nlist
+                    || int_buffer1[4*i+2] > c->num_nlist - k) {
+                fprintf(stderr, "%s: node list of cell %d is broken\n",
+                        __func__, ucd->cell_id[i]);
+                has_error = EXIT_FAILURE;
+                break;
+            }
             for (j = 0; j < int_buffer1[4*i+2]; ++j) {
                 ucd->cell_nlist[ucd->ld_nlist * i + j] = int_buffer2[k++];
             }
         }
     }
-    free(int_buffer1);
-    if (c.is_binary) {
-        free(int_buffer2);
+    _ucd_budget_free(c, int_buffer1, size1);
+    if (c->is_binary) {
+        _ucd_budget_free(c, int_buffer2, size2);
+    }
+
+    has_error = has_error || ferror(c->_fp);
+    if (has_error) {
+        ucd_simple_free(ucd);
+    }
+    return has_error;
+}
+
+
+int ucd_simple_reader_ex(ucd_content* ucd, const char* filename,
+        const ucd_options* o, ucd_context* c)
+{
+    ucd_context context;
+
+    if (c == NULL) {
+        c = &context;
+    }
+
+    /* header */
+    if (ucd_reader_open_ex(c, filename, o)) {
+        return EXIT_FAILURE;
+    }
+    _ucd_checksum_track(c);
+
+    /* nodes and cells */
+    if (_ucd_read_geometry(c, ucd)) {
+        ucd_close(c);
+        return EXIT_FAILURE;
     }
 
     /* node data */
-    if (c.num_ndata > 0) {
-        ucd->ndata = malloc(sizeof(*ucd->ndata));
-        ucd->ndata->num_rows = c.num_nodes;
-        ucd->ndata->num_data = c.num_ndata;
-        _ucd_simple_reader_sub(&c, ucd->ndata);
-    } else {
-        ucd->ndata = NULL;
+    if (c->num_ndata > 0) {
+        ucd->ndata = _ucd_data_alloc_ex(c, c->num_nodes, c->num_ndata);
+        if (ucd->ndata == NULL) {
+            ucd_close(c);
+            ucd_simple_free(ucd);
+            return EXIT_FAILURE;
+        }
+        if (_ucd_simple_reader_sub(c, ucd->ndata)) {
+            ucd_close(c);
+            ucd_simple_free(ucd);
+            return EXIT_FAILURE;
+        }
     }
 
     /* cell data */
-    if (c.num_cdata > 0) {
-        ucd->cdata = malloc(sizeof(*ucd->cdata));
-        ucd->cdata->num_rows = c.num_cells;
-        ucd->cdata->num_data = c.num_cdata;
-        _ucd_simple_reader_sub(&c, ucd->cdata);
+    if (c->num_cdata > 0) {
+        ucd->cdata = _ucd_data_alloc_ex(c, c->num_cells, c->num_cdata);
+        if (ucd->cdata == NULL) {
+            ucd_close(c);
+            ucd_simple_free(ucd);
+            return EXIT_FAILURE;
+        }
+        if (_ucd_simple_reader_sub(c, ucd->cdata)) {
+            ucd_close(c);
+            ucd_simple_free(ucd);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (c->is_binary && c->chunk_rows <= 0
+            && _ucd_simple_reader_blocks(c, filename, ucd)) {
+        ucd_close(c);
+        ucd_simple_free(ucd);
+        return EXIT_FAILURE;
+    }
+
+    /* checksums are known from the bytes read */
+    if (_ucd_checksum_verify(c, filename)) {
+        ucd_close(c);
+        ucd_simple_free(ucd);
+        return EXIT_FAILURE;
+    }
+    return ucd_close(c);
+}
+
+
+static int _ucd_probe_sub(ucd_context* c, ucd_data* d)
+{
+    int j;
+
+    if (ucd_read_data_header(c,
+                &d->num_comp, d->components, d->labels, d->units)) {
+        return EXIT_FAILURE;
+    }
+
+    if (c->is_binary) {
+        if (ucd_read_data_minmax(c, d->minima, d->maxima)) {
+            return EXIT_FAILURE;
+        }
+        if (c->chunk_rows > 0) {
+            return _ucd_chunk_read_body(c, d->num_data, d->num_rows,
+                    NULL, NULL);
+        }
+        for (j = 0; j < d->num_comp; ++j) {
+            if (ucd_read_data_binary(c, d->components[j], NULL, 0)) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (ucd_read_data_active_list(c, NULL)) {
+            return EXIT_FAILURE;
+        }
     } else {
-        ucd->cdata = NULL;
+        /* minima and maxima are not stored in ASCII format */
+        for (j = 0; j < d->num_data; ++j) {
+            d->minima[j] = +FLT_MAX;
+            d->maxima[j] = -FLT_MAX;
+        }
+        if (ucd_read_data_ascii_rows(c, d->num_rows, NULL, NULL)) {
+            return EXIT_FAILURE;
+        }
     }
+    return ferror(c->_fp);
+}
+
 
-    ucd->num_nodes = c.num_nodes;
-    ucd->num_cells = c.num_cells;
+int ucd_probe(ucd_content* ucd, const char* filename, ucd_context* c)
+{
+    int has_error;
 
-    ucd_close(&c);
+    if (ucd_reader_open(c, filename)) {
+        return EXIT_FAILURE;
+    }
 
-    if (was_binary != NULL) {
-        *was_binary = c.is_binary;
+    /* counts only */
+    if (ucd_simple_alloc(ucd, 0, 0, 8 /* hex */)) {
+        ucd_close(c);
+        return EXIT_FAILURE;
+    }
+    ucd->num_nodes = c->num_nodes;
+    ucd->num_cells = c->num_cells;
+    has_error = ucd_read_nodes_and_cells(c,
+            NULL, NULL, NULL, NULL, NULL, NULL, 0);
+
+    if (!has_error && c->num_ndata > 0) {
+        ucd->ndata = ucd_data_alloc(0, c->num_ndata);
+        if (ucd->ndata == NULL) {
+            has_error = EXIT_FAILURE;
+        } else {
+            ucd->ndata->num_rows = c->num_nodes;
+            has_error = _ucd_probe_sub(c, ucd->ndata);
+            if (has_error) {
+                ucd_data_free(ucd->ndata);
+                ucd->ndata = NULL;
+            }
+        }
+    }
+    if (!has_error && c->num_cdata > 0) {
+        ucd->cdata = ucd_data_alloc(0, c->num_cdata);
+        if (ucd->cdata == NULL) {
+            has_error = EXIT_FAILURE;
+        } else {
+            ucd->cdata->num_rows = c->num_cells;
+            has_error = _ucd_probe_sub(c, ucd->cdata);
+            if (has_error) {
+                ucd_data_free(ucd->cdata);
+                ucd->cdata = NULL;
+            }
+        }
     }
 
+    has_error = ucd_close(c) || has_error;
+    if (has_error) {
+        fprintf(stderr, "%s: cannot read %s\n", __func__, filename);
+        ucd_simple_free(ucd);
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
 
 
 int ucd_reader_open(ucd_context* c, const char* filename)
 {
+    return ucd_reader_open_ex(c, filename, NULL);
+}
+
+
+int ucd_reader_open_ex(ucd_context* c, const char* filename,
+        const ucd_options* o)
+{
+    ucd_binary_layout layout;
+    int magic_number, num_sections, has_error;
+    long offset, end;
+
+    _ucd_context_open(c, o);
     c->_fp = fopen(filename, "rb");
     if (c->_fp == NULL) {
         fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
         return EXIT_FAILURE;
     }
 
-    if (getc(c->_fp) == UCD_MAGIC_NUMBER) {
+    c->encoding = UCD_ENCODING_FLOAT32;
+    c->chunk_rows = 0;
+    c->checksum = 0;
+
+    magic_number = getc(c->_fp);
+    if (magic_number == UCD_MAGIC_NUMBER
+            || magic_number == UCD_MAGIC_NUMBER_EXT
+            || magic_number == UCD_MAGIC_NUMBER_CHUNK) {
         c->is_binary = 1;
-        fread(&c->num_nodes, sizeof(int), 1, c->_fp);
-        fread(&c->num_cells, sizeof(int), 1, c->_fp);
-        fread(&c->num_ndata, sizeof(int), 1, c->_fp);
-        fread(&c->num_cdata, sizeof(int), 1, c->_fp);
-        fseek(c->_fp, sizeof(int), SEEK_CUR); /* skip mdata */
-        fread(&c->num_nlist, sizeof(int), 1, c->_fp);
-
-#if 0
-        /* TODO check file size */
-        expected_filesize = ucd_binary_filesize(c);
-        if (actual_filesize != expected_filesize) {
+        has_error = fread(&c->num_nodes, sizeof(int), 1, c->_fp) != 1
+            || fread(&c->num_cells, sizeof(int), 1, c->_fp) != 1
+            || fread(&c->num_ndata, sizeof(int), 1, c->_fp) != 1
+            || fread(&c->num_cdata, sizeof(int), 1, c->_fp) != 1;
+        if (magic_number == UCD_MAGIC_NUMBER) {
+            fseek(c->_fp, sizeof(int), SEEK_CUR); /* skip mdata */
+        } else if (magic_number == UCD_MAGIC_NUMBER_CHUNK) {
+            has_error |= fread(&c->chunk_rows, sizeof(int), 1, c->_fp) != 1;
+            if (!has_error && c->chunk_rows <= 0) {
+                fclose(c->_fp);
+                fprintf(stderr, "%s: wrong chunk size %d\n",
+                        __func__, c->chunk_rows);
+                return EXIT_FAILURE;
+            }
+        } else {
+            has_error |= fread(&c->encoding, sizeof(int), 1, c->_fp) != 1;
+            if (!has_error && (c->encoding <= UCD_ENCODING_FLOAT32
+                    || c->encoding > UCD_ENCODING_UINT8)) {
+                fclose(c->_fp);
+                fprintf(stderr, "%s: unknown encoding %d\n",
+                        __func__, c->encoding);
+                return EXIT_FAILURE;
+            }
+        }
+        has_error |= fread(&c->num_nlist, sizeof(int), 1, c->_fp) != 1;
+        if (has_error || c->num_nodes < 0 || c->num_cells < 0
+                || c->num_ndata < 0 || c->num_cdata < 0 || c->num_nlist < 0) {
+            fclose(c->_fp);
+            fprintf(stderr, "%s: wrong header of %s\n", __func__, filename);
+            return EXIT_FAILURE;
+        }
+
+        /* the size of chunked container is known from its directories */
+        offset = ftell(c->_fp);
+        end = _ucd_checksum_find(c->_fp, &num_sections);
+        c->checksum = num_sections > 0;
+        _ucd_binary_layout(c, &layout);
+        if (c->chunk_rows > 0) {
+            layout.end = _ucd_chunk_end(c);
+        }
+        if (end != layout.end) {
             fclose(c->_fp);
             fprintf(stderr, "%s: wrong file size (byte order issue?)\n", __func__);
             return EXIT_FAILURE;
         }
-#endif
+        fseek(c->_fp, offset, SEEK_SET);
     } else {
         fclose(c->_fp);
 
@@ -181,8 +444,12 @@ int ucd_reader_open(ucd_context* c, const char* filename)
             return EXIT_FAILURE;
         }
 
-        fscanf(c->_fp, "%d %d %d %d",
-                &c->num_nodes, &c->num_cells, &c->num_ndata, &c->num_cdata);
+        if (fscanf(c->_fp, "%d %d %d %d", &c->num_nodes, &c->num_cells,
+                    &c->num_ndata, &c->num_cdata) != 4) {
+            fclose(c->_fp);
+            fprintf(stderr, "%s: wrong header of %s\n", __func__, filename);
+            return EXIT_FAILURE;
+        }
         _ucd_ignore_lines(c, 1); /* skip mdata */
 
         c->is_binary = 0;
@@ -198,16 +465,24 @@ int ucd_read_nodes_and_cells(ucd_context* c,
         int* cells, int* nlist, int ld_nlist)
 {
     int i, j;
+    long pos;
     char cell_type[6]; /* 'prism' + null character */
+    float* coords[3];
+    static const int lds[3] = {1, 1, 1};
 
     if (c->is_binary) {
         if (cells != NULL) {
-            fread(cells, sizeof(int), 4 * c->num_cells, c->_fp);
+            if (_ucd_progress_fread(c, cells,
+                        4 * sizeof(int), c->num_cells, 1)) {
+                return EXIT_FAILURE;
+            }
         } else {
             fseek(c->_fp, 4 * c->num_cells * sizeof(int), SEEK_CUR);
         }
         if (nlist != NULL) {
-            fread(nlist, sizeof(int), c->num_nlist, c->_fp);
+            if (_ucd_progress_fread(c, nlist, sizeof(int), c->num_nlist, 0)) {
+                return EXIT_FAILURE;
+            }
         } else {
             fseek(c->_fp, c->num_nlist * sizeof(int), SEEK_CUR);
         }
@@ -216,34 +491,63 @@ int ucd_read_nodes_and_cells(ucd_context* c,
                 node_id[i] = i + 1;
             }
         }
-        if (x != NULL && y != NULL && z != NULL) {
-            fread(x, sizeof(float), c->num_nodes, c->_fp);
-            fread(y, sizeof(float), c->num_nodes, c->_fp);
-            fread(z, sizeof(float), c->num_nodes, c->_fp);
+        if (c->chunk_rows > 0) {
+            coords[0] = x;
+            coords[1] = y;
+            coords[2] = z;
+            if (_ucd_chunk_read_body(c, 3, c->num_nodes,
+                        x != NULL && y != NULL && z != NULL ? coords : NULL,
+                        lds)) {
+                return EXIT_FAILURE;
+            }
+        } else if (x != NULL && y != NULL && z != NULL) {
+            if (_ucd_progress_fread(c, x, sizeof(float), c->num_nodes, 1)
+                    || _ucd_progress_fread(c, y,
+                        sizeof(float), c->num_nodes, 1)
+                    || _ucd_progress_fread(c, z,
+                        sizeof(float), c->num_nodes, 1)) {
+                return EXIT_FAILURE;
+            }
         } else {
             fseek(c->_fp, 3 * c->num_nodes * sizeof(float), SEEK_CUR);
         }
     } else {
+        pos = ftell(c->_fp);
         if (node_id != NULL && x != NULL && y != NULL && z != NULL) {
             for (i = 0; i < c->num_nodes; ++i) {
-                fscanf(c->_fp, "%d %f %f %f", &node_id[i], &x[i], &y[i], &z[i]);
+                if (fscanf(c->_fp, "%d %f %f %f",
+                            &node_id[i], &x[i], &y[i], &z[i]) != 4) {
+                    fprintf(stderr, "%s: node %d is broken\n", __func__, i + 1);
+                    return EXIT_FAILURE;
+                }
                 _ucd_ignore_lines(c, 1);
+                if (_ucd_progress_rows(c, &pos, i + 1, c->num_nodes, 3)) {
+                    return EXIT_FAILURE;
+                }
             }
         } else {
             _ucd_ignore_lines(c, c->num_nodes);
         }
         if (cells != NULL) {
             for (i = 0; i < c->num_cells; ++i) {
-                fscanf(c->_fp, "%d %d %5s",
-                        &cells[4 * i], &cells[4 * i + 1], cell_type);
+                if (fscanf(c->_fp, "%d %d %5s",
+                        &cells[4 * i], &cells[4 * i + 1], cell_type) != 3) {
+                    fprintf(stderr, "%s: cell %d is broken\n", __func__, i + 1);
+                    return EXIT_FAILURE;
+                }
                 cells[4 * i + 3] = ucd_cell_type_number(cell_type);
                 cells[4 * i + 2] = ucd_cell_nlist_size(cells[4 * i + 3]);
-                if (nlist != NULL) {
-                    for (j = 0; j < cells[4 * i + 2]; ++j) {
-                        fscanf(c->_fp, "%d", &nlist[ld_nlist * i + j]);
+                for (j = 0; nlist != NULL && j < cells[4 * i + 2]; ++j) {
+                    if (fscanf(c->_fp, "%d", &nlist[ld_nlist * i + j]) != 1) {
+                        fprintf(stderr, "%s: cell %d is broken\n",
+                                __func__, cells[4 * i]);
+                        return EXIT_FAILURE;
                     }
                 }
                 _ucd_ignore_lines(c, 1);
+                if (_ucd_progress_rows(c, &pos, i + 1, c->num_cells, 1)) {
+                    return EXIT_FAILURE;
+                }
             }
         } else {
             _ucd_ignore_lines(c, c->num_cells);
@@ -256,7 +560,7 @@ int ucd_read_nodes_and_cells(ucd_context* c,
 int ucd_read_data_header(ucd_context* c,
         int* num_comp, int* components, char* labels, char* units)
 {
-    int num_data, i;
+    int num_data, has_error, i;
     char *anchor_l, *anchor_u;
 
     if (c->_nc == 0 && c->num_ndata > 0) {
@@ -269,10 +573,14 @@ int ucd_read_data_header(ucd_context* c,
     }
 
     ucd_data_dimension(c, NULL, &num_data);
+    c->_col = 0;
+    c->_row = 0;
 
     if (c->is_binary) {
+        has_error = 0;
         if (labels != NULL) {
-            fread(labels, sizeof(char), UCD_TEXT_FIELD_SIZE, c->_fp);
+            has_error |= _ucd_checksum_fread(c, labels,
+                    sizeof(char), UCD_TEXT_FIELD_SIZE) != UCD_TEXT_FIELD_SIZE;
             for (i = 0; i < UCD_TEXT_FIELD_SIZE; ++i) {
                 if (labels[i] == '.') {
                     labels[i] = '\0';
@@ -283,7 +591,8 @@ int ucd_read_data_header(ucd_context* c,
         }
 
         if (units != NULL) {
-            fread(units, sizeof(char), UCD_TEXT_FIELD_SIZE, c->_fp);
+            has_error |= _ucd_checksum_fread(c, units,
+                    sizeof(char), UCD_TEXT_FIELD_SIZE) != UCD_TEXT_FIELD_SIZE;
             for (i = 0; i < UCD_TEXT_FIELD_SIZE; ++i) {
                 if (units[i] == '.') {
                     units[i] = '\0';
@@ -293,15 +602,23 @@ int ucd_read_data_header(ucd_context* c,
             fseek(c->_fp, UCD_TEXT_FIELD_SIZE, SEEK_CUR);
         }
 
-        fread(num_comp, sizeof(int), 1, c->_fp);
+        has_error |= _ucd_checksum_fread(c, num_comp, sizeof(int), 1) != 1;
 
         if (components != NULL) {
-            fread(components, sizeof(int), num_data, c->_fp);
+            has_error |= _ucd_checksum_fread(c, components,
+                    sizeof(int), num_data) != (size_t)num_data;
         } else {
             fseek(c->_fp, num_data * sizeof(int), SEEK_CUR);
         }
+        if (has_error) {
+            fprintf(stderr, "%s: header of data is broken\n", __func__);
+            return EXIT_FAILURE;
+        }
     } else {
-        fscanf(c->_fp, "%d", num_comp);
+        if (fscanf(c->_fp, "%d", num_comp) != 1) {
+            fprintf(stderr, "%s: header of data is broken\n", __func__);
+            return EXIT_FAILURE;
+        }
         if (components != NULL) {
             for (i = 0; i < *num_comp; ++i) {
                 fscanf(c->_fp, "%d", &components[i]);
@@ -339,13 +656,34 @@ int ucd_read_data_minmax(ucd_context* c, float* minima, float* maxima)
 
     ucd_data_dimension(c, NULL, &num_data);
 
+    if (c->encoding != UCD_ENCODING_FLOAT32) {
+        /* keep the range to dequantize data */
+        free(c->_minima);
+        free(c->_maxima);
+        c->_minima = malloc(num_data * sizeof(*c->_minima));
+        c->_maxima = malloc(num_data * sizeof(*c->_maxima));
+        if (c->_minima == NULL || c->_maxima == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        _ucd_checksum_fread(c, c->_minima, sizeof(float), num_data);
+        _ucd_checksum_fread(c, c->_maxima, sizeof(float), num_data);
+        if (minima != NULL) {
+            memcpy(minima, c->_minima, num_data * sizeof(*minima));
+        }
+        if (maxima != NULL) {
+            memcpy(maxima, c->_maxima, num_data * sizeof(*maxima));
+        }
+        return ferror(c->_fp);
+    }
+
     if (minima != NULL) {
-        fread(minima, sizeof(float), num_data, c->_fp);
+        _ucd_checksum_fread(c, minima, sizeof(float), num_data);
     } else {
         fseek(c->_fp, num_data * sizeof(float), SEEK_CUR);
     }
     if (maxima != NULL) {
-        fread(maxima, sizeof(float), num_data, c->_fp);
+        _ucd_checksum_fread(c, maxima, sizeof(float), num_data);
     } else {
         fseek(c->_fp, num_data * sizeof(float), SEEK_CUR);
     }
@@ -355,7 +693,19 @@ int ucd_read_data_minmax(ucd_context* c, float* minima, float* maxima)
 
 int ucd_read_data_ascii(ucd_context* c, int* ids, float* data)
 {
-    int num_rows, num_data, i, j;
+    int num_rows;
+
+    ucd_data_dimension(c, &num_rows, NULL);
+
+    return ucd_read_data_ascii_rows(c, num_rows, ids, data);
+}
+
+
+int ucd_read_data_ascii_rows(ucd_context* c,
+        int num_block, int* ids, float* data)
+{
+    int num_rows, num_data, i, j, k;
+    long pos;
 
     if (c->is_binary) {
         fprintf(stderr, "%s: assertion error\n", __func__);
@@ -363,18 +713,33 @@ int ucd_read_data_ascii(ucd_context* c, int* ids, float* data)
     }
 
     ucd_data_dimension(c, &num_rows, &num_data);
+    if (num_block > num_rows - c->_row) {
+        fprintf(stderr, "%s: too many rows\n", __func__);
+        return EXIT_FAILURE;
+    }
 
     if (ids != NULL && data != NULL) {
-        for (i = 0; i < num_rows; ++i) {
-            fscanf(c->_fp, "%d", &ids[i]);
-            for (j = 0; j < num_data; ++j) {
-                fscanf(c->_fp, "%f", &data[i * num_data + j]);
+        pos = ftell(c->_fp);
+        for (i = 0; i < num_block; ++i) {
+            k = fscanf(c->_fp, "%d", &ids[i]);
+            for (j = 0; j < num_data && k == 1; ++j) {
+                k = fscanf(c->_fp, "%f", &data[i * num_data + j]);
+            }
+            if (k != 1) {
+                fprintf(stderr, "%s: row %d is broken\n",
+                        __func__, c->_row + i + 1);
+                return EXIT_FAILURE;
             }
             _ucd_ignore_lines(c, 1);
+            if (_ucd_progress_rows(c, &pos, i + 1, num_block, num_data)) {
+                return EXIT_FAILURE;
+            }
         }
     } else {
-        _ucd_ignore_lines(c, num_rows);
+        _ucd_ignore_lines(c, num_block);
     }
+    c->_row += num_block;
+
     return ferror(c->_fp);
 }
 
@@ -382,29 +747,85 @@ int ucd_read_data_ascii(ucd_context* c, int* ids, float* data)
 int ucd_read_data_binary(ucd_context* c,
         int component_size, float* data, int ld_data)
 {
-    int num_rows, i;
+    int num_rows;
+
+    ucd_data_dimension(c, &num_rows, NULL);
+
+    return ucd_read_data_binary_rows(c,
+            component_size, num_rows, data, ld_data);
+}
+
+
+int ucd_read_data_binary_rows(ucd_context* c,
+        int component_size, int num_block, float* data, int ld_data)
+{
+    int num_rows, esize, i;
+    void* buffer;
 
     if (!c->is_binary) {
         fprintf(stderr, "%s: assertion error\n", __func__);
         return EXIT_FAILURE;
     }
+    if (c->chunk_rows > 0) {
+        fprintf(stderr, "%s: chunked data are read by ucd_read_chunk()\n",
+                __func__);
+        return EXIT_FAILURE;
+    }
 
     ucd_data_dimension(c, &num_rows, NULL);
+    if (num_block > num_rows - c->_row) {
+        fprintf(stderr, "%s: too many rows\n", __func__);
+        return EXIT_FAILURE;
+    }
+    esize = _ucd_encoding_size(c->encoding);
 
-    if (data != NULL) {
-        for (i = 0; i < num_rows; ++i) {
-            fread(&data[ld_data*i], sizeof(float), component_size, c->_fp);
+    if (data == NULL) {
+        if (fseek(c->_fp, (long)component_size * num_block * esize,
+                    SEEK_CUR) != 0) {
+            fprintf(stderr, "%s: cannot skip rows\n", __func__);
+            return EXIT_FAILURE;
+        }
+    } else if (c->encoding == UCD_ENCODING_FLOAT32) {
+        if (ld_data == component_size) {
+            _ucd_checksum_fread(c, data,
+                    sizeof(float), component_size * num_block);
+        } else {
+            for (i = 0; i < num_block; ++i) {
+                _ucd_checksum_fread(c, &data[ld_data*i],
+                        sizeof(float), component_size);
+            }
         }
     } else {
-        fseek(c->_fp, component_size * num_rows * sizeof(float), SEEK_CUR);
+        if (c->_minima == NULL) {
+            fprintf(stderr, "%s: minima and maxima are not read\n", __func__);
+            return EXIT_FAILURE;
+        }
+        buffer = malloc((size_t)num_block * component_size * esize);
+        if (buffer == NULL && num_block > 0) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        _ucd_checksum_fread(c, buffer, esize, num_block * component_size);
+        _ucd_decode(c->encoding, buffer, num_block, component_size,
+                &c->_minima[c->_col], &c->_maxima[c->_col], data, ld_data);
+        free(buffer);
     }
+
+    /* move to the next component at the end of the block */
+    c->_row += num_block;
+    if (c->_row == num_rows) {
+        c->_row = 0;
+        c->_col += component_size;
+    }
+
     return ferror(c->_fp);
 }
 
 
 int ucd_read_data_active_list(ucd_context* c, int* active_list)
 {
-    int num_data;
+    int buffer[64];
+    int num_data, n;
 
     if (!c->is_binary) {
         fprintf(stderr, "%s: assertion error\n", __func__);
@@ -414,7 +835,13 @@ int ucd_read_data_active_list(ucd_context* c, int* active_list)
     ucd_data_dimension(c, NULL, &num_data);
 
     if (active_list != NULL) {
-        fread(active_list, sizeof(int), num_data, c->_fp);
+        _ucd_checksum_fread(c, active_list, sizeof(int), num_data);
+    } else if (c->_crc_log != NULL) {
+        /* the list is read to know the checksum */
+        for (; num_data > 0; num_data -= n) {
+            n = num_data < 64 ? num_data : 64;
+            _ucd_checksum_fread(c, buffer, sizeof(int), n);
+        }
     } else {
         fseek(c->_fp, num_data * sizeof(int), SEEK_CUR);
     }
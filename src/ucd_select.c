@@ -0,0 +1,624 @@
+/**
+ * @file ucd_select.c
+ * @brief Functions relate to selecting cells by predicates.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+
+static int _ucd_predicate_on_nodes(const ucd_predicate* p)
+{
+    return p->target == UCD_PREDICATE_NDATA || p->target == UCD_PREDICATE_X
+        || p->target == UCD_PREDICATE_Y || p->target == UCD_PREDICATE_Z;
+}
+
+
+/* column of data which the predicate refers, or negative */
+static int _ucd_predicate_column(const ucd_predicate* p, const ucd_data* d)
+{
+    int comp, base, i;
+
+    comp = d != NULL ? ucd_data_find_component(d, p->label) : -1;
+    if (comp < 0 || p->column < 0 || p->column >= d->components[comp]) {
+        fprintf(stderr, "%s: %s:%d is not found\n",
+                __func__, p->label, p->column);
+        return -1;
+    }
+
+    base = 0;
+    for (i = 0; i < comp; ++i) {
+        base += d->components[i];
+    }
+    return base + p->column;
+}
+
+
+/* masks are updated without branches so that loops are vectorized */
+static void _ucd_mask_float(char* mask, const float* values, int ld,
+        int n, float lower, float upper)
+{
+    int i;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < n; ++i) {
+        mask[i] &= (values[ld * i] >= lower) & (values[ld * i] <= upper);
+    }
+}
+
+
+static void _ucd_mask_int(char* mask, const int* values,
+        int n, float lower, float upper)
+{
+    int i;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < n; ++i) {
+        mask[i] &= (values[i] >= lower) & (values[i] <= upper);
+    }
+}
+
+
+/* predicates on materials, cell types and coordinates */
+static void _ucd_select_geometry(const ucd_content* ucd,
+        int num_predicates, const ucd_predicate* predicates,
+        char* node_mask, char* cell_mask)
+{
+    const ucd_predicate* p;
+    int i;
+
+    for (i = 0; i < num_predicates; ++i) {
+        p = &predicates[i];
+        switch (p->target) {
+        case UCD_PREDICATE_MAT_ID:
+            _ucd_mask_int(cell_mask, ucd->cell_mat_id, ucd->num_cells,
+                    p->lower, p->upper);
+            break;
+        case UCD_PREDICATE_CELL_TYPE:
+            _ucd_mask_int(cell_mask, ucd->cell_type, ucd->num_cells,
+                    p->lower, p->upper);
+            break;
+        case UCD_PREDICATE_X:
+            _ucd_mask_float(node_mask, ucd->node_x, 1, ucd->num_nodes,
+                    p->lower, p->upper);
+            break;
+        case UCD_PREDICATE_Y:
+            _ucd_mask_float(node_mask, ucd->node_y, 1, ucd->num_nodes,
+                    p->lower, p->upper);
+            break;
+        case UCD_PREDICATE_Z:
+            _ucd_mask_float(node_mask, ucd->node_z, 1, ucd->num_nodes,
+                    p->lower, p->upper);
+            break;
+        }
+    }
+}
+
+
+/* cells are selected by any or all of their nodes */
+static int _ucd_select_by_nodes(const ucd_content* ucd,
+        const char* node_mask, int any_node, char* cell_mask)
+{
+    int nsize, hit, i, j, k;
+    ucd_node_index index;
+
+    _ucd_node_index_build(&index, ucd);
+    if (index.table == NULL) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for private(nsize, hit, j, k)
+#endif
+    for (i = 0; i < ucd->num_cells; ++i) {
+        nsize = ucd_cell_nlist_size(ucd->cell_type[i]);
+        hit = !any_node;
+        for (j = 0; j < nsize; ++j) {
+            k = _ucd_node_find(&index, ucd->cell_nlist[ucd->ld_nlist * i + j]);
+            k = k >= 0 ? node_mask[k] : 0;
+            hit = any_node ? hit | k : hit & k;
+        }
+        cell_mask[i] &= hit;
+    }
+
+    _ucd_node_index_free(&index);
+    return EXIT_SUCCESS;
+}
+
+
+static int _ucd_has_node_predicates(int num_predicates,
+        const ucd_predicate* predicates)
+{
+    int i;
+
+    for (i = 0; i < num_predicates; ++i) {
+        if (_ucd_predicate_on_nodes(&predicates[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+int ucd_select_cells(const ucd_content* ucd,
+        int num_predicates, const ucd_predicate* predicates,
+        int any_node, char* selected)
+{
+    const ucd_predicate* p;
+    const ucd_data* d;
+    const float* values;
+    char* node_mask;
+    int col, ld, i;
+
+    node_mask = malloc(ucd->num_nodes + 1);
+    if (node_mask == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+    memset(node_mask, 1, ucd->num_nodes);
+    memset(selected, 1, ucd->num_cells);
+
+    _ucd_select_geometry(ucd, num_predicates, predicates, node_mask, selected);
+    for (i = 0; i < num_predicates; ++i) {
+        p = &predicates[i];
+        if (p->target != UCD_PREDICATE_NDATA
+                && p->target != UCD_PREDICATE_CDATA) {
+            continue;
+        }
+        d = p->target == UCD_PREDICATE_NDATA ? ucd->ndata : ucd->cdata;
+        col = _ucd_predicate_column(p, d);
+        if (col < 0) {
+            free(node_mask);
+            return EXIT_FAILURE;
+        }
+        values = ucd_data_column(d, col, &ld);
+        _ucd_mask_float(p->target == UCD_PREDICATE_NDATA
+                ? node_mask : selected, values, ld, d->num_rows,
+                p->lower, p->upper);
+    }
+
+    if (_ucd_has_node_predicates(num_predicates, predicates)
+            && _ucd_select_by_nodes(ucd, node_mask, any_node, selected)) {
+        free(node_mask);
+        return EXIT_FAILURE;
+    }
+
+    free(node_mask);
+    return EXIT_SUCCESS;
+}
+
+
+static float* _ucd_block_buffer(const ucd_context* c, const ucd_data* d)
+{
+    float* buffer;
+    int ld, i;
+
+    ld = c->is_binary ? 0 : d->num_data;
+    for (i = 0; c->is_binary && i < d->num_comp; ++i) {
+        ld = d->components[i] > ld ? d->components[i] : ld;
+    }
+    buffer = malloc(UCD_BLOCK_ROWS * ld * sizeof(*buffer) + 1);
+    if (buffer == NULL) {
+        fprintf(stderr, "%s: cannot allocate buffer\n", __func__);
+    }
+    return buffer;
+}
+
+
+/*
+ * Chunks of a column which cannot satisfy the predicate by their minima
+ * and maxima are rejected without decoding, and chunks which may partly
+ * satisfy it are decoded unless all their rows are already rejected.
+ */
+static int _ucd_select_chunks(ucd_context* c, int num_cols, int num_rows,
+        int num_predicates, const ucd_predicate* predicates, const int* cols,
+        char* mask)
+{
+    const ucd_predicate* p;
+    const ucd_chunk* chunk;
+    ucd_chunk* chunks;
+    float* buffer;
+    long end;
+    int num_chunks, has_error, i, k;
+
+    num_chunks = _ucd_num_chunks(c, num_rows);
+    chunks = _ucd_chunk_directory(c, ftell(c->_fp), num_cols, num_rows, &end);
+    buffer = malloc(c->chunk_rows * sizeof(*buffer));
+    if (chunks == NULL || buffer == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(chunks);
+        free(buffer);
+        return EXIT_FAILURE;
+    }
+
+    has_error = EXIT_SUCCESS;
+    for (k = 0; k < num_predicates && !has_error; ++k) {
+        if (cols[k] < 0) {
+            continue;
+        }
+        p = &predicates[k];
+        for (i = 0; i < num_chunks && !has_error; ++i) {
+            chunk = &chunks[num_chunks * cols[k] + i];
+            if (chunk->maximum < p->lower || chunk->minimum > p->upper) {
+                memset(&mask[chunk->first_row], 0, chunk->num_rows);
+            } else if ((chunk->minimum < p->lower
+                        || chunk->maximum > p->upper || chunk->has_nan)
+                    && memchr(&mask[chunk->first_row], 1,
+                        chunk->num_rows) != NULL) {
+                has_error = ucd_read_chunk(c, chunk, buffer, 1);
+                _ucd_mask_float(&mask[chunk->first_row], buffer, 1,
+                        chunk->num_rows, p->lower, p->upper);
+            }
+        }
+    }
+
+    free(chunks);
+    free(buffer);
+    fseek(c->_fp, end, SEEK_SET);
+    return has_error || ferror(c->_fp);
+}
+
+
+/* evaluate predicates on a section of data by blocks of rows */
+static int _ucd_select_stream(ucd_context* c, int target,
+        int num_predicates, const ucd_predicate* predicates, char* mask)
+{
+    ucd_data* d;
+    float* buffer;
+    int* ids;
+    int num_rows, num_data, num_block, has_error, base, size, row, i, k;
+    int needed;
+    int* cols;
+
+    num_data = target == UCD_PREDICATE_NDATA ? c->num_ndata : c->num_cdata;
+    d = ucd_data_alloc(0, num_data);
+    cols = malloc((num_predicates + 1) * sizeof(*cols));
+    ids = malloc(UCD_BLOCK_ROWS * sizeof(*ids));
+    if (d == NULL || cols == NULL || ids == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_data_free(d);
+        free(cols);
+        free(ids);
+        return EXIT_FAILURE;
+    }
+
+    has_error = ucd_read_data_header(c,
+            &d->num_comp, d->components, d->labels, d->units);
+    if (c->is_binary) {
+        has_error = has_error || ucd_read_data_minmax(c, NULL, NULL);
+    }
+    for (k = 0; k < num_predicates && !has_error; ++k) {
+        cols[k] = -1;
+        if (predicates[k].target == target) {
+            cols[k] = _ucd_predicate_column(&predicates[k], d);
+            has_error = cols[k] < 0;
+        }
+    }
+    buffer = has_error ? NULL : _ucd_block_buffer(c, d);
+    if (buffer == NULL) {
+        ucd_data_free(d);
+        free(cols);
+        free(ids);
+        return EXIT_FAILURE;
+    }
+
+    ucd_data_dimension(c, &num_rows, NULL);
+    if (c->chunk_rows > 0) {
+        has_error = _ucd_select_chunks(c, d->num_data, num_rows,
+                num_predicates, predicates, cols, mask);
+    } else if (c->is_binary) {
+        /* components without predicates are skipped */
+        base = 0;
+        for (i = 0; i < d->num_comp && !has_error; ++i) {
+            size = d->components[i];
+            needed = 0;
+            for (k = 0; k < num_predicates; ++k) {
+                needed |= cols[k] >= base && cols[k] < base + size;
+            }
+            for (row = 0; row < num_rows && !has_error; row += num_block) {
+                num_block = num_rows - row < UCD_BLOCK_ROWS
+                    ? num_rows - row : UCD_BLOCK_ROWS;
+                has_error = ucd_read_data_binary_rows(c, size, num_block,
+                        needed ? buffer : NULL, size);
+                for (k = 0; k < num_predicates; ++k) {
+                    if (cols[k] >= base && cols[k] < base + size) {
+                        _ucd_mask_float(&mask[row], &buffer[cols[k] - base],
+                                size, num_block, predicates[k].lower,
+                                predicates[k].upper);
+                    }
+                }
+            }
+            base += size;
+        }
+        has_error = has_error || ucd_read_data_active_list(c, NULL);
+    } else {
+        for (row = 0; row < num_rows && !has_error; row += num_block) {
+            num_block = num_rows - row < UCD_BLOCK_ROWS
+                ? num_rows - row : UCD_BLOCK_ROWS;
+            has_error = ucd_read_data_ascii_rows(c, num_block, ids, buffer);
+            for (k = 0; k < num_predicates; ++k) {
+                if (cols[k] >= 0) {
+                    _ucd_mask_float(&mask[row], &buffer[cols[k]], num_data,
+                            num_block, predicates[k].lower,
+                            predicates[k].upper);
+                }
+            }
+        }
+    }
+
+    ucd_data_free(d);
+    free(buffer);
+    free(cols);
+    free(ids);
+    return has_error;
+}
+
+
+/* copy mapped rows of chunks, where chunks without them are not decoded */
+static int _ucd_copy_chunks(ucd_context* c, ucd_data* e, int is_cell,
+        const int* row_map, int num_rows)
+{
+    const ucd_chunk* chunk;
+    ucd_chunk* chunks;
+    float* buffer;
+    char* used;
+    long end;
+    int num_chunks, has_error, i, j, k;
+
+    num_chunks = _ucd_num_chunks(c, num_rows);
+    chunks = _ucd_chunk_directory(c, ftell(c->_fp),
+            e->num_data, num_rows, &end);
+    buffer = malloc(c->chunk_rows * sizeof(*buffer));
+    used = calloc(num_chunks + 1, 1);
+    if (chunks == NULL || buffer == NULL || used == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(chunks);
+        free(buffer);
+        free(used);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < num_rows; ++i) {
+        k = row_map[i];
+        if (k >= 0) {
+            e->row_id[k] = is_cell ? i + 1 : k + 1;
+            used[i / c->chunk_rows] = 1;
+        }
+    }
+
+    has_error = EXIT_SUCCESS;
+    for (j = 0; j < e->num_data && !has_error; ++j) {
+        for (k = 0; k < num_chunks && !has_error; ++k) {
+            if (!used[k]) {
+                continue;
+            }
+            chunk = &chunks[num_chunks * j + k];
+            has_error = ucd_read_chunk(c, chunk, buffer, 1);
+            for (i = 0; i < chunk->num_rows; ++i) {
+                if (row_map[chunk->first_row + i] >= 0) {
+                    e->data[e->num_data * row_map[chunk->first_row + i] + j]
+                        = buffer[i];
+                }
+            }
+        }
+    }
+
+    free(chunks);
+    free(buffer);
+    free(used);
+    fseek(c->_fp, end, SEEK_SET);
+    return has_error || ferror(c->_fp);
+}
+
+
+/* copy mapped rows of a section of data by blocks of rows */
+static ucd_data* _ucd_copy_stream(ucd_context* c, int is_cell,
+        const int* row_map, int num_out)
+{
+    ucd_data* e;
+    float* buffer;
+    int* ids;
+    int num_rows, num_block, has_error, base, size, row, i, j, k;
+
+    e = ucd_data_alloc(num_out, is_cell ? c->num_cdata : c->num_ndata);
+    ids = malloc(UCD_BLOCK_ROWS * sizeof(*ids));
+    if (e == NULL || ids == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        ucd_data_free(e);
+        free(ids);
+        return NULL;
+    }
+
+    has_error = ucd_read_data_header(c,
+            &e->num_comp, e->components, e->labels, e->units);
+    if (c->is_binary) {
+        has_error = has_error || ucd_read_data_minmax(c, NULL, NULL);
+    }
+    buffer = has_error ? NULL : _ucd_block_buffer(c, e);
+    if (buffer == NULL) {
+        ucd_data_free(e);
+        free(ids);
+        return NULL;
+    }
+    ucd_data_dimension(c, &num_rows, NULL);
+
+    if (c->chunk_rows > 0) {
+        has_error = _ucd_copy_chunks(c, e, is_cell, row_map, num_rows);
+    } else if (c->is_binary) {
+        base = 0;
+        for (i = 0; i < e->num_comp && !has_error; ++i) {
+            size = e->components[i];
+            for (row = 0; row < num_rows && !has_error; row += num_block) {
+                num_block = num_rows - row < UCD_BLOCK_ROWS
+                    ? num_rows - row : UCD_BLOCK_ROWS;
+                has_error = ucd_read_data_binary_rows(c,
+                        size, num_block, buffer, size);
+#ifdef _OPENMP
+#pragma omp parallel for private(j, k)
+#endif
+                for (j = 0; j < num_block; ++j) {
+                    k = row_map[row + j];
+                    if (k >= 0) {
+                        e->row_id[k] = is_cell ? row + j + 1 : k + 1;
+                        memcpy(&e->data[e->num_data * k + base],
+                                &buffer[size * j], size * sizeof(*buffer));
+                    }
+                }
+            }
+            base += size;
+        }
+        has_error = has_error || ucd_read_data_active_list(c, NULL);
+    } else {
+        for (row = 0; row < num_rows && !has_error; row += num_block) {
+            num_block = num_rows - row < UCD_BLOCK_ROWS
+                ? num_rows - row : UCD_BLOCK_ROWS;
+            has_error = ucd_read_data_ascii_rows(c, num_block, ids, buffer);
+#ifdef _OPENMP
+#pragma omp parallel for private(k)
+#endif
+            for (j = 0; j < num_block; ++j) {
+                k = row_map[row + j];
+                if (k >= 0) {
+                    e->row_id[k] = is_cell ? ids[j] : k + 1;
+                    memcpy(&e->data[e->num_data * k],
+                            &buffer[e->num_data * j],
+                            e->num_data * sizeof(*buffer));
+                }
+            }
+        }
+    }
+    ucd_data_update_minmax(e);
+
+    free(buffer);
+    free(ids);
+    if (has_error) {
+        ucd_data_free(e);
+        return NULL;
+    }
+    return e;
+}
+
+
+int ucd_extract_file(ucd_content* sub, const char* filename,
+        int num_predicates, const ucd_predicate* predicates, int any_node)
+{
+    ucd_context c;
+    ucd_content geo;
+    char *node_mask, *cell_mask;
+    ucd_node_index index;
+    int *global_node, *node_map, *cell_map;
+    int has_error, i, k;
+
+    global_node = NULL;
+    if (ucd_reader_open(&c, filename)) {
+        return EXIT_FAILURE;
+    }
+    if (_ucd_read_geometry(&c, &geo)) {
+        ucd_close(&c);
+        return EXIT_FAILURE;
+    }
+
+    /* pass 1: evaluate predicates */
+    node_mask = malloc(geo.num_nodes + 1);
+    cell_mask = malloc(geo.num_cells + 1);
+    if (node_mask == NULL || cell_mask == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(node_mask);
+        free(cell_mask);
+        ucd_simple_free(&geo);
+        ucd_close(&c);
+        return EXIT_FAILURE;
+    }
+    memset(node_mask, 1, geo.num_nodes);
+    memset(cell_mask, 1, geo.num_cells);
+    _ucd_select_geometry(&geo, num_predicates, predicates,
+            node_mask, cell_mask);
+
+    has_error = EXIT_SUCCESS;
+    for (i = 0; i < num_predicates && !has_error; ++i) {
+        if ((predicates[i].target == UCD_PREDICATE_NDATA && c.num_ndata == 0)
+                || (predicates[i].target == UCD_PREDICATE_CDATA
+                    && c.num_cdata == 0)) {
+            fprintf(stderr, "%s: %s has no data for %s\n",
+                    __func__, filename, predicates[i].label);
+            has_error = EXIT_FAILURE;
+        }
+    }
+    if (!has_error && c.num_ndata > 0) {
+        has_error = _ucd_select_stream(&c, UCD_PREDICATE_NDATA,
+                num_predicates, predicates, node_mask);
+    }
+    if (!has_error && c.num_cdata > 0) {
+        has_error = _ucd_select_stream(&c, UCD_PREDICATE_CDATA,
+                num_predicates, predicates, cell_mask);
+    }
+    has_error = ucd_close(&c) || has_error;
+
+    if (!has_error && _ucd_has_node_predicates(num_predicates, predicates)) {
+        has_error = _ucd_select_by_nodes(&geo, node_mask, any_node, cell_mask);
+    }
+    if (!has_error) {
+        has_error = ucd_extract_cells(sub, &geo, cell_mask, &global_node);
+    }
+    free(node_mask);
+    if (has_error) {
+        free(cell_mask);
+        ucd_simple_free(&geo);
+        return EXIT_FAILURE;
+    }
+
+    /* pass 2: copy rows of selected nodes and cells */
+    _ucd_node_index_build(&index, &geo);
+    node_map = malloc((geo.num_nodes + 1) * sizeof(*node_map));
+    cell_map = malloc((geo.num_cells + 1) * sizeof(*cell_map));
+    if (index.table == NULL || node_map == NULL || cell_map == NULL
+            || global_node == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        has_error = EXIT_FAILURE;
+    } else {
+        for (i = 0; i < geo.num_nodes; ++i) {
+            node_map[i] = -1;
+        }
+        for (i = 0; i < sub->num_nodes; ++i) {
+            node_map[_ucd_node_find(&index, global_node[i])] = i;
+        }
+        k = 0;
+        for (i = 0; i < geo.num_cells; ++i) {
+            cell_map[i] = cell_mask[i] ? k++ : -1;
+        }
+        has_error = ucd_reader_open(&c, filename);
+    }
+
+    if (!has_error) {
+        ucd_read_nodes_and_cells(&c, NULL, NULL, NULL, NULL, NULL, NULL, 0);
+        if (c.num_ndata > 0) {
+            sub->ndata = _ucd_copy_stream(&c, 0, node_map, sub->num_nodes);
+            has_error = sub->ndata == NULL;
+        }
+        if (!has_error && c.num_cdata > 0) {
+            sub->cdata = _ucd_copy_stream(&c, 1, cell_map, sub->num_cells);
+            has_error = sub->cdata == NULL;
+        }
+        has_error = ucd_close(&c) || has_error;
+    }
+
+    _ucd_node_index_free(&index);
+    free(node_map);
+    free(cell_map);
+    free(cell_mask);
+    free(global_node);
+    ucd_simple_free(&geo);
+    if (has_error) {
+        ucd_simple_free(sub);
+    }
+    return has_error;
+}
@@ -0,0 +1,600 @@
+/**
+ * @file ucd_series.c
+ * @brief Functions relate to time series of node and cell data.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ *
+ * A series file has a header and steps.  The header is the magic number,
+ * the numbers of nodes, cells, node data and cell data, the keyframe
+ * interval, and for node and cell data (if any) labels and units in text
+ * fields, the number of components, sizes of components and row IDs.
+ * A step is the size in bytes of the rest, a keyframe flag and encoded
+ * columns of node data and cell data.  An encoded column is its size in
+ * bytes followed by the codec stream.
+ *
+ * Bits of values of a column are XORed with the previous step except for
+ * keyframes, split into planes of bytes from the least significant one,
+ * and compressed by run length.  A control byte less than 128 is followed
+ * by (control + 1) literal bytes, and the other is followed by a byte
+ * repeated (control - 125) times.
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/** The shortest run of a byte encoded as a run. */
+#define UCD_SERIES_MIN_RUN 3
+
+/** The longest run and literal. */
+#define UCD_SERIES_MAX_RUN 130
+#define UCD_SERIES_MAX_LITERAL 128
+
+typedef union {
+    float f;
+    unsigned int u;
+} _ucd_series_bits;
+
+
+/* the upper bound of the size of an encoded column */
+static long _ucd_series_bound(int num_rows)
+{
+    return 4L * num_rows + 4L * num_rows / UCD_SERIES_MAX_LITERAL + 16;
+}
+
+
+static long _ucd_series_rle(const unsigned char* src, long n,
+        unsigned char* dst)
+{
+    long i, run, lit, size;
+
+    size = 0;
+    lit = -1;
+    for (i = 0; i < n; i += run) {
+        for (run = 1; i + run < n && run < UCD_SERIES_MAX_RUN
+                && src[i + run] == src[i]; ++run) {
+        }
+        if (run >= UCD_SERIES_MIN_RUN) {
+            dst[size++] = (unsigned char)(run + 125);
+            dst[size++] = src[i];
+            lit = -1;
+        } else {
+            run = 1;
+            if (lit < 0 || dst[lit] == UCD_SERIES_MAX_LITERAL - 1) {
+                lit = size++;
+                dst[lit] = 0;
+            } else {
+                dst[lit]++;
+            }
+            dst[size++] = src[i];
+        }
+    }
+    return size;
+}
+
+
+static int _ucd_series_unrle(const unsigned char* src, long size,
+        unsigned char* dst, long n)
+{
+    long i, k, len;
+
+    k = 0;
+    for (i = 0; i < size; ) {
+        if (src[i] < UCD_SERIES_MAX_LITERAL) {
+            len = src[i] + 1;
+            if (i + 1 + len > size || k + len > n) {
+                return EXIT_FAILURE;
+            }
+            memcpy(&dst[k], &src[i + 1], len);
+            i += 1 + len;
+        } else {
+            len = src[i] - 125;
+            if (i + 1 >= size || k + len > n) {
+                return EXIT_FAILURE;
+            }
+            memset(&dst[k], src[i + 1], len);
+            i += 2;
+        }
+        k += len;
+    }
+    return k == n ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* residuals against the previous bits are shuffled and compressed */
+static long _ucd_series_encode(const unsigned int* bits,
+        const unsigned int* prev, int num_rows,
+        unsigned char* planes, unsigned char* dst)
+{
+    unsigned int r;
+    int i, k;
+
+    for (i = 0; i < num_rows; ++i) {
+        r = prev != NULL ? bits[i] ^ prev[i] : bits[i];
+        for (k = 0; k < 4; ++k) {
+            planes[(long)num_rows * k + i] = (unsigned char)(r >> (8 * k));
+        }
+    }
+    return _ucd_series_rle(planes, 4L * num_rows, dst);
+}
+
+
+static int _ucd_series_decode(const unsigned char* src, long size,
+        int num_rows, int is_key, unsigned char* planes, unsigned int* bits)
+{
+    int i;
+
+    if (_ucd_series_unrle(src, size, planes, 4L * num_rows)) {
+        return EXIT_FAILURE;
+    }
+    if (is_key) {
+        for (i = 0; i < num_rows; ++i) {
+            bits[i] = 0;
+        }
+    }
+    for (i = 0; i < num_rows; ++i) {
+        bits[i] ^= (unsigned int)planes[i]
+            | (unsigned int)planes[(long)num_rows + i] << 8
+            | (unsigned int)planes[2L * num_rows + i] << 16
+            | (unsigned int)planes[3L * num_rows + i] << 24;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static void _ucd_series_init(ucd_series* s)
+{
+    memset(s, 0, sizeof(*s));
+    s->_step = -1;
+}
+
+
+/* rows of column j, which columns of node data come first */
+static int _ucd_series_rows(const ucd_series* s, int j)
+{
+    return j < s->num_ndata ? s->num_nodes : s->num_cells;
+}
+
+
+static long _ucd_series_column(const ucd_series* s, int j)
+{
+    return j < s->num_ndata ? (long)s->num_nodes * j
+        : (long)s->num_nodes * s->num_ndata
+        + (long)s->num_cells * (j - s->num_ndata);
+}
+
+
+static int _ucd_series_alloc(ucd_series* s)
+{
+    s->_bits = malloc(_ucd_series_column(s, s->num_ndata + s->num_cdata)
+            * sizeof(*s->_bits) + 1);
+    if (s->_bits == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static void _ucd_series_write_header(ucd_series* s, const ucd_data* d)
+{
+    fwrite(d->labels, sizeof(char), UCD_TEXT_FIELD_SIZE, s->_fp);
+    fwrite(d->units, sizeof(char), UCD_TEXT_FIELD_SIZE, s->_fp);
+    fwrite(&d->num_comp, sizeof(int), 1, s->_fp);
+    fwrite(d->components, sizeof(int), d->num_data, s->_fp);
+    fwrite(d->row_id, sizeof(int), d->num_rows, s->_fp);
+}
+
+
+int ucd_series_writer_open(ucd_series* s, const char* filename,
+        const ucd_data* ndata, const ucd_data* cdata, int keyframe_interval)
+{
+    char magic_number;
+
+    _ucd_series_init(s);
+    s->num_nodes = ndata != NULL ? ndata->num_rows : 0;
+    s->num_cells = cdata != NULL ? cdata->num_rows : 0;
+    s->num_ndata = ndata != NULL ? ndata->num_data : 0;
+    s->num_cdata = cdata != NULL ? cdata->num_data : 0;
+    s->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+    if (_ucd_series_alloc(s)) {
+        return EXIT_FAILURE;
+    }
+
+    s->_fp = fopen(filename, "wb");
+    if (s->_fp == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+        free(s->_bits);
+        s->_bits = NULL;
+        return EXIT_FAILURE;
+    }
+    s->_is_writer = 1;
+
+    magic_number = UCD_MAGIC_NUMBER_SERIES;
+    fwrite(&magic_number, sizeof(char), 1, s->_fp);
+    fwrite(&s->num_nodes, sizeof(int), 1, s->_fp);
+    fwrite(&s->num_cells, sizeof(int), 1, s->_fp);
+    fwrite(&s->num_ndata, sizeof(int), 1, s->_fp);
+    fwrite(&s->num_cdata, sizeof(int), 1, s->_fp);
+    fwrite(&s->keyframe_interval, sizeof(int), 1, s->_fp);
+    if (ndata != NULL) {
+        _ucd_series_write_header(s, ndata);
+    }
+    if (cdata != NULL) {
+        _ucd_series_write_header(s, cdata);
+    }
+
+    return ferror(s->_fp);
+}
+
+
+int ucd_series_write(ucd_series* s, const ucd_data* ndata,
+        const ucd_data* cdata)
+{
+    unsigned char *buffer, *planes;
+    unsigned int* bits;
+    long* sizes;
+    long bound;
+    int num_cols, is_key, has_error, size, j;
+
+    if ((ndata != NULL ? ndata->num_rows : 0) != s->num_nodes
+            || (cdata != NULL ? cdata->num_rows : 0) != s->num_cells
+            || (ndata != NULL ? ndata->num_data : 0) != s->num_ndata
+            || (cdata != NULL ? cdata->num_data : 0) != s->num_cdata) {
+        fprintf(stderr, "%s: numbers of data are different\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    num_cols = s->num_ndata + s->num_cdata;
+    bound = _ucd_series_bound(s->num_nodes > s->num_cells
+            ? s->num_nodes : s->num_cells);
+    is_key = s->num_steps % s->keyframe_interval == 0;
+    buffer = malloc(num_cols * bound + 1);
+    sizes = malloc((num_cols + 1) * sizeof(*sizes));
+    if (buffer == NULL || sizes == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(buffer);
+        free(sizes);
+        return EXIT_FAILURE;
+    }
+
+    /* columns are encoded independently into their slots */
+    has_error = EXIT_SUCCESS;
+#ifdef _OPENMP
+#pragma omp parallel private(bits, planes) reduction(|:has_error)
+#endif
+    {
+        const ucd_data* d;
+        const float* p;
+        _ucd_series_bits v;
+        int num_rows, ld, i;
+
+        bits = malloc(4L * (s->num_nodes > s->num_cells
+                    ? s->num_nodes : s->num_cells) + 1);
+        planes = malloc(4L * (s->num_nodes > s->num_cells
+                    ? s->num_nodes : s->num_cells) + 1);
+        if (bits == NULL || planes == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            has_error = EXIT_FAILURE;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (j = 0; j < num_cols; ++j) {
+            if (bits == NULL || planes == NULL) {
+                continue;
+            }
+            d = j < s->num_ndata ? ndata : cdata;
+            p = ucd_data_column(d,
+                    j < s->num_ndata ? j : j - s->num_ndata, &ld);
+            num_rows = _ucd_series_rows(s, j);
+            for (i = 0; i < num_rows; ++i) {
+                v.f = p[ld * i];
+                bits[i] = v.u;
+            }
+            sizes[j] = _ucd_series_encode(bits,
+                    is_key ? NULL : &s->_bits[_ucd_series_column(s, j)],
+                    num_rows, planes, buffer + bound * j);
+            memcpy(&s->_bits[_ucd_series_column(s, j)], bits,
+                    num_rows * sizeof(*bits));
+        }
+        free(bits);
+        free(planes);
+    }
+
+    if (!has_error) {
+        size = sizeof(int) + num_cols * sizeof(int);
+        for (j = 0; j < num_cols; ++j) {
+            size += (int)sizes[j];
+        }
+        fwrite(&size, sizeof(int), 1, s->_fp);
+        fwrite(&is_key, sizeof(int), 1, s->_fp);
+        for (j = 0; j < num_cols; ++j) {
+            size = (int)sizes[j];
+            fwrite(&size, sizeof(int), 1, s->_fp);
+            fwrite(buffer + bound * j, 1, sizes[j], s->_fp);
+        }
+        s->num_steps++;
+        s->_step = s->num_steps - 1;
+        has_error = ferror(s->_fp);
+    }
+
+    free(buffer);
+    free(sizes);
+    return has_error;
+}
+
+
+static ucd_data* _ucd_series_read_header(ucd_series* s,
+        int num_rows, int num_data)
+{
+    ucd_data* d;
+
+    d = ucd_data_alloc(num_rows, num_data);
+    if (d == NULL) {
+        return NULL;
+    }
+    if (fread(d->labels, sizeof(char), UCD_TEXT_FIELD_SIZE, s->_fp)
+            != UCD_TEXT_FIELD_SIZE
+            || fread(d->units, sizeof(char), UCD_TEXT_FIELD_SIZE, s->_fp)
+            != UCD_TEXT_FIELD_SIZE
+            || fread(&d->num_comp, sizeof(int), 1, s->_fp) != 1
+            || fread(d->components, sizeof(int), num_data, s->_fp)
+            != (size_t)num_data
+            || fread(d->row_id, sizeof(int), num_rows, s->_fp)
+            != (size_t)num_rows
+            || d->num_comp < 1 || d->num_comp > num_data) {
+        fprintf(stderr, "%s: cannot read header\n", __func__);
+        ucd_data_free(d);
+        return NULL;
+    }
+    d->labels[UCD_TEXT_FIELD_SIZE - 1] = '\0';
+    d->units[UCD_TEXT_FIELD_SIZE - 1] = '\0';
+    return d;
+}
+
+
+int ucd_series_reader_open(ucd_series* s, const char* filename)
+{
+    char magic_number;
+    int header[5], size, has_error;
+    long* offsets;
+    int max_steps;
+
+    _ucd_series_init(s);
+    s->_fp = fopen(filename, "rb");
+    if (s->_fp == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+        return EXIT_FAILURE;
+    }
+    if (fread(&magic_number, sizeof(char), 1, s->_fp) != 1
+            || magic_number != UCD_MAGIC_NUMBER_SERIES
+            || fread(header, sizeof(int), 5, s->_fp) != 5
+            || header[0] < 0 || header[1] < 0 || header[2] < 0
+            || header[3] < 0 || header[4] < 1) {
+        fprintf(stderr, "%s: %s is not a series\n", __func__, filename);
+        fclose(s->_fp);
+        return EXIT_FAILURE;
+    }
+    s->num_nodes = header[0];
+    s->num_cells = header[1];
+    s->num_ndata = header[2];
+    s->num_cdata = header[3];
+    s->keyframe_interval = header[4];
+
+    has_error = _ucd_series_alloc(s);
+    if (!has_error && s->num_ndata > 0) {
+        s->_ndata = _ucd_series_read_header(s, s->num_nodes, s->num_ndata);
+        has_error = s->_ndata == NULL;
+    }
+    if (!has_error && s->num_cdata > 0) {
+        s->_cdata = _ucd_series_read_header(s, s->num_cells, s->num_cdata);
+        has_error = s->_cdata == NULL;
+    }
+
+    /* offsets of steps by their sizes */
+    max_steps = 0;
+    while (!has_error && fread(&size, sizeof(int), 1, s->_fp) == 1) {
+        if (s->num_steps == max_steps) {
+            max_steps = 2 * max_steps + 16;
+            offsets = realloc(s->_offsets, max_steps * sizeof(*offsets));
+            if (offsets == NULL) {
+                fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+                has_error = EXIT_FAILURE;
+                break;
+            }
+            s->_offsets = offsets;
+        }
+        s->_offsets[s->num_steps++] = ftell(s->_fp) - (long)sizeof(int);
+        if (size < 0 || fseek(s->_fp, size, SEEK_CUR)) {
+            fprintf(stderr, "%s: step %d is broken\n", __func__, s->num_steps);
+            has_error = EXIT_FAILURE;
+        }
+    }
+
+    if (has_error) {
+        ucd_series_close(s);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+/* decode a step onto the bits of the previous one */
+static int _ucd_series_read_step(ucd_series* s, int step)
+{
+    unsigned char* buffer;
+    long* offsets;
+    int size, total, is_key, num_cols, has_error, j;
+
+    num_cols = s->num_ndata + s->num_cdata;
+    fseek(s->_fp, s->_offsets[step], SEEK_SET);
+    if (fread(&total, sizeof(int), 1, s->_fp) != 1 || total < (int)sizeof(int)) {
+        fprintf(stderr, "%s: cannot read step %d\n", __func__, step);
+        return EXIT_FAILURE;
+    }
+    buffer = malloc(total + 1);
+    offsets = malloc((num_cols + 1) * sizeof(*offsets));
+    if (buffer == NULL || offsets == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(buffer);
+        free(offsets);
+        return EXIT_FAILURE;
+    }
+    if (fread(buffer, 1, total, s->_fp) != (size_t)total) {
+        fprintf(stderr, "%s: cannot read step %d\n", __func__, step);
+        free(buffer);
+        free(offsets);
+        return EXIT_FAILURE;
+    }
+
+    /* offsets of columns in the buffer */
+    memcpy(&is_key, buffer, sizeof(int));
+    offsets[0] = sizeof(int);
+    has_error = EXIT_SUCCESS;
+    for (j = 0; j < num_cols && !has_error; ++j) {
+        has_error = offsets[j] + (long)sizeof(int) > total;
+        if (!has_error) {
+            memcpy(&size, buffer + offsets[j], sizeof(int));
+            offsets[j + 1] = offsets[j] + sizeof(int) + size;
+            has_error = size < 0 || offsets[j + 1] > total;
+        }
+    }
+    if (has_error) {
+        fprintf(stderr, "%s: step %d is broken\n", __func__, step);
+        free(buffer);
+        free(offsets);
+        s->_step = -1;
+        return EXIT_FAILURE;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(|:has_error)
+#endif
+    {
+        unsigned char* planes;
+
+        planes = malloc(4L * (s->num_nodes > s->num_cells
+                    ? s->num_nodes : s->num_cells) + 1);
+        if (planes == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            has_error = EXIT_FAILURE;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (j = 0; j < num_cols; ++j) {
+            if (planes == NULL) {
+                continue;
+            }
+            has_error |= _ucd_series_decode(
+                    buffer + offsets[j] + sizeof(int),
+                    offsets[j + 1] - offsets[j] - (long)sizeof(int),
+                    _ucd_series_rows(s, j), is_key, planes,
+                    &s->_bits[_ucd_series_column(s, j)]);
+        }
+        free(planes);
+    }
+
+    free(buffer);
+    free(offsets);
+    if (has_error) {
+        fprintf(stderr, "%s: step %d is broken\n", __func__, step);
+        s->_step = -1;
+        return EXIT_FAILURE;
+    }
+    s->_step = step;
+    return EXIT_SUCCESS;
+}
+
+
+static ucd_data* _ucd_series_data(const ucd_series* s,
+        const ucd_data* header, int first_col)
+{
+    ucd_data* d;
+    float* p;
+    _ucd_series_bits v;
+    const unsigned int* bits;
+    int ld, i, j;
+
+    d = ucd_data_alloc(header->num_rows, header->num_data);
+    if (d == NULL) {
+        return NULL;
+    }
+    ucd_data_copy_header(d, header);
+    memcpy(d->row_id, header->row_id, d->num_rows * sizeof(*d->row_id));
+    for (j = 0; j < d->num_data; ++j) {
+        p = ucd_data_column(d, j, &ld);
+        bits = &s->_bits[_ucd_series_column(s, first_col + j)];
+        for (i = 0; i < d->num_rows; ++i) {
+            v.u = bits[i];
+            p[ld * i] = v.f;
+        }
+    }
+    ucd_data_update_minmax(d);
+    return d;
+}
+
+
+int ucd_series_read(ucd_series* s, int step,
+        ucd_data** ndata, ucd_data** cdata)
+{
+    int first, t;
+
+    *ndata = NULL;
+    *cdata = NULL;
+    if (s->_is_writer || step < 0 || step >= s->num_steps) {
+        fprintf(stderr, "%s: step %d is invalid\n", __func__, step);
+        return EXIT_FAILURE;
+    }
+
+    /* from the keyframe unless the previous step is cached */
+    first = step - step % s->keyframe_interval;
+    if (s->_step >= first && s->_step <= step) {
+        first = s->_step + 1;
+    }
+    for (t = first; t <= step; ++t) {
+        if (_ucd_series_read_step(s, t)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (s->_ndata != NULL) {
+        *ndata = _ucd_series_data(s, s->_ndata, 0);
+        if (*ndata == NULL) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (s->_cdata != NULL) {
+        *cdata = _ucd_series_data(s, s->_cdata, s->num_ndata);
+        if (*cdata == NULL) {
+            if (*ndata != NULL) {
+                ucd_data_free(*ndata);
+                *ndata = NULL;
+            }
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+int ucd_series_close(ucd_series* s)
+{
+    int has_error;
+
+    has_error = fclose(s->_fp);
+    if (s->_ndata != NULL) {
+        ucd_data_free(s->_ndata);
+    }
+    if (s->_cdata != NULL) {
+        ucd_data_free(s->_cdata);
+    }
+    free(s->_bits);
+    free(s->_offsets);
+    _ucd_series_init(s);
+
+    return has_error;
+}
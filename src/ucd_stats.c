@@ -0,0 +1,388 @@
+/**
+ * @file ucd_stats.c
+ * @brief Functions relate to streaming statistics of data.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include <float.h>
+#include <math.h>
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+
+int ucd_stats_init(ucd_stats* s, int num_bins, float lower, float upper)
+{
+    memset(s, 0, sizeof(*s));
+
+    if (num_bins < 2) {
+        num_bins = 2;
+    }
+    s->num_bins = num_bins + num_bins % 2;
+    s->lower = lower;
+    s->upper = upper;
+    s->bins = calloc(s->num_bins, sizeof(*s->bins));
+    if (s->bins == NULL) {
+        fprintf(stderr, "%s: cannot allocate histogram\n", __func__);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+void ucd_stats_free(ucd_stats* s)
+{
+    free(s->bins);
+    s->bins = NULL;
+}
+
+
+/* double the range of the histogram until [lo, hi] is covered */
+static void _ucd_stats_widen(ucd_stats* s, float lo, float hi)
+{
+    int half, k;
+    float width;
+
+    half = s->num_bins / 2;
+    while (lo < s->lower || hi > s->upper) {
+        width = s->upper - s->lower;
+        if (lo < s->lower) {
+            for (k = s->num_bins - 1; k >= half; --k) {
+                s->bins[k] = s->bins[2*(k-half)] + s->bins[2*(k-half)+1];
+            }
+            for (k = 0; k < half; ++k) {
+                s->bins[k] = 0;
+            }
+            s->lower -= width;
+        } else {
+            for (k = 0; k < half; ++k) {
+                s->bins[k] = s->bins[2*k] + s->bins[2*k+1];
+            }
+            for (k = half; k < s->num_bins; ++k) {
+                s->bins[k] = 0;
+            }
+            s->upper += width;
+        }
+    }
+}
+
+
+/* NaN fails both comparisons */
+static int _ucd_stats_is_finite(float v)
+{
+    return v >= -FLT_MAX && v <= FLT_MAX;
+}
+
+
+void ucd_stats_add(ucd_stats* s, const float* values, int n, int stride)
+{
+    int num_finite, i, k;
+    float lo, hi, v;
+    double sum, mean, m2, delta, scale, x;
+    long count;
+
+    /* statistics of the block, then combined with the former ones */
+    lo = FLT_MAX;
+    hi = -FLT_MAX;
+    sum = 0;
+    num_finite = 0;
+    for (i = 0; i < n; ++i) {
+        v = values[stride * i];
+        if (!_ucd_stats_is_finite(v)) {
+            continue;
+        }
+        lo = v < lo ? v : lo;
+        hi = v > hi ? v : hi;
+        sum += v;
+        ++num_finite;
+    }
+    if (n > num_finite) {
+        s->num_nonfinite += n - num_finite;
+    }
+    if (num_finite < 1) {
+        return;
+    }
+    mean = sum / num_finite;
+    m2 = 0;
+    for (i = 0; i < n; ++i) {
+        v = values[stride * i];
+        if (_ucd_stats_is_finite(v)) {
+            delta = v - mean;
+            m2 += delta * delta;
+        }
+    }
+
+    count = s->count + num_finite;
+    delta = mean - s->mean;
+    s->mean += delta * num_finite / count;
+    s->m2 += m2 + delta * delta * s->count / count * num_finite;
+    if (s->count == 0) {
+        s->minimum = lo;
+        s->maximum = hi;
+    } else {
+        s->minimum = lo < s->minimum ? lo : s->minimum;
+        s->maximum = hi > s->maximum ? hi : s->maximum;
+    }
+    s->count = count;
+
+    /* histogram */
+    if (!(s->lower < s->upper)) {
+        s->lower = lo;
+        s->upper = hi > lo ? hi : lo + 1;
+    }
+    _ucd_stats_widen(s, lo, hi);
+
+    /* the index is clamped before the conversion, which may overflow */
+    scale = s->num_bins / ((double)s->upper - s->lower);
+    for (i = 0; i < n; ++i) {
+        v = values[stride * i];
+        if (!_ucd_stats_is_finite(v)) {
+            continue;
+        }
+        x = (v - (double)s->lower) * scale;
+        if (!(x > 0)) {
+            x = 0;
+        } else if (x > s->num_bins - 1) {
+            x = s->num_bins - 1;
+        }
+        k = (int)x;
+        s->bins[k]++;
+    }
+}
+
+
+double ucd_stats_variance(const ucd_stats* s)
+{
+    return s->count > 1 ? s->m2 / (s->count - 1) : 0;
+}
+
+
+float ucd_stats_percentile(const ucd_stats* s, double p)
+{
+    double target, cum, width, v;
+    int k;
+
+    if (s->count == 0) {
+        return 0;
+    }
+
+    target = p * s->count;
+    width = ((double)s->upper - s->lower) / s->num_bins;
+    cum = 0;
+    v = s->maximum;
+    for (k = 0; k < s->num_bins; ++k) {
+        if (s->bins[k] > 0 && cum + s->bins[k] >= target) {
+            v = s->lower + (k + (target - cum) / s->bins[k]) * width;
+            break;
+        }
+        cum += s->bins[k];
+    }
+
+    if (v < s->minimum) {
+        return s->minimum;
+    } else if (v > s->maximum) {
+        return s->maximum;
+    }
+    return (float)v;
+}
+
+
+/* chunks of each column are decoded one by one at the current position */
+static int _ucd_stats_read_chunks(ucd_context* c, const ucd_data* d,
+        ucd_stats* stats)
+{
+    ucd_chunk* chunks;
+    float* buffer;
+    long end;
+    int num_chunks, has_error, j, k;
+
+    chunks = _ucd_chunk_directory(c, ftell(c->_fp),
+            d->num_data, d->num_rows, &end);
+    if (chunks == NULL) {
+        return EXIT_FAILURE;
+    }
+    buffer = malloc(c->chunk_rows * sizeof(*buffer));
+    if (buffer == NULL) {
+        fprintf(stderr, "%s: cannot allocate buffer\n", __func__);
+        free(chunks);
+        return EXIT_FAILURE;
+    }
+
+    num_chunks = _ucd_num_chunks(c, d->num_rows);
+    has_error = EXIT_SUCCESS;
+    for (j = 0; j < d->num_data && !has_error; ++j) {
+        for (k = 0; k < num_chunks && !has_error; ++k) {
+            has_error = ucd_read_chunk(c, &chunks[num_chunks * j + k],
+                    buffer, 1);
+            if (!has_error) {
+                ucd_stats_add(&stats[j], buffer,
+                        chunks[num_chunks * j + k].num_rows, 1);
+            }
+        }
+    }
+
+    free(buffer);
+    free(chunks);
+    if (has_error || fseek(c->_fp, end, SEEK_SET)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static int _ucd_stats_read_sub(ucd_context* c, ucd_data* d,
+        int num_bins, ucd_stats* stats)
+{
+    int num_block, ld, base, i, j, row;
+    float* buffer;
+    int* ids;
+
+    if (ucd_read_data_header(c,
+                &d->num_comp, d->components, d->labels, d->units)) {
+        return EXIT_FAILURE;
+    }
+
+    if (c->is_binary) {
+        if (ucd_read_data_minmax(c, d->minima, d->maxima)) {
+            return EXIT_FAILURE;
+        }
+        for (j = 0; j < d->num_data; ++j) {
+            if (ucd_stats_init(&stats[j], num_bins,
+                        d->minima[j], d->maxima[j])) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (c->chunk_rows > 0) {
+            return _ucd_stats_read_chunks(c, d, stats);
+        }
+    } else {
+        for (j = 0; j < d->num_data; ++j) {
+            if (ucd_stats_init(&stats[j], num_bins, 0, 0)) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    ld = c->is_binary ? 0 : d->num_data;
+    for (i = 0; c->is_binary && i < d->num_comp; ++i) {
+        ld = d->components[i] > ld ? d->components[i] : ld;
+    }
+    buffer = malloc(UCD_BLOCK_ROWS * ld * sizeof(*buffer));
+    ids = malloc(UCD_BLOCK_ROWS * sizeof(*ids));
+    if (buffer == NULL || ids == NULL) {
+        fprintf(stderr, "%s: cannot allocate buffer\n", __func__);
+        free(buffer);
+        free(ids);
+        return EXIT_FAILURE;
+    }
+
+    if (c->is_binary) {
+        base = 0;
+        for (i = 0; i < d->num_comp; ++i) {
+            ld = d->components[i];
+            for (row = 0; row < d->num_rows; row += num_block) {
+                num_block = d->num_rows - row < UCD_BLOCK_ROWS
+                    ? d->num_rows - row : UCD_BLOCK_ROWS;
+                ucd_read_data_binary_rows(c, ld, num_block, buffer, ld);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+                for (j = 0; j < ld; ++j) {
+                    ucd_stats_add(&stats[base + j], &buffer[j], num_block, ld);
+                }
+            }
+            base += ld;
+        }
+        ucd_read_data_active_list(c, NULL);
+    } else {
+        for (row = 0; row < d->num_rows; row += num_block) {
+            num_block = d->num_rows - row < UCD_BLOCK_ROWS
+                ? d->num_rows - row : UCD_BLOCK_ROWS;
+            ucd_read_data_ascii_rows(c, num_block, ids, buffer);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+            for (j = 0; j < ld; ++j) {
+                ucd_stats_add(&stats[j], &buffer[j], num_block, ld);
+            }
+        }
+        for (j = 0; j < d->num_data; ++j) {
+            d->minima[j] = stats[j].minimum;
+            d->maxima[j] = stats[j].maximum;
+        }
+    }
+
+    free(buffer);
+    free(ids);
+    return ferror(c->_fp);
+}
+
+
+static void _ucd_stats_free_array(ucd_stats* stats, int n)
+{
+    int i;
+
+    for (i = 0; stats != NULL && i < n; ++i) {
+        ucd_stats_free(&stats[i]);
+    }
+    free(stats);
+}
+
+
+int ucd_stats_read(ucd_content* ucd, const char* filename, int num_bins,
+        ucd_stats** nstats, ucd_stats** cstats)
+{
+    ucd_context c;
+    int has_error;
+
+    *nstats = NULL;
+    *cstats = NULL;
+
+    if (ucd_reader_open(&c, filename)) {
+        return EXIT_FAILURE;
+    }
+    /* counts only */
+    if (ucd_simple_alloc(ucd, 0, 0, 8 /* hex */)) {
+        ucd_close(&c);
+        return EXIT_FAILURE;
+    }
+    ucd->num_nodes = c.num_nodes;
+    ucd->num_cells = c.num_cells;
+    has_error = ucd_read_nodes_and_cells(&c,
+            NULL, NULL, NULL, NULL, NULL, NULL, 0);
+
+    if (!has_error && c.num_ndata > 0) {
+        ucd->ndata = ucd_data_alloc(0, c.num_ndata);
+        *nstats = calloc(c.num_ndata, sizeof(**nstats));
+        if (ucd->ndata == NULL || *nstats == NULL) {
+            has_error = EXIT_FAILURE;
+        } else {
+            ucd->ndata->num_rows = c.num_nodes;
+            has_error = _ucd_stats_read_sub(&c, ucd->ndata, num_bins, *nstats);
+        }
+    }
+    if (!has_error && c.num_cdata > 0) {
+        ucd->cdata = ucd_data_alloc(0, c.num_cdata);
+        *cstats = calloc(c.num_cdata, sizeof(**cstats));
+        if (ucd->cdata == NULL || *cstats == NULL) {
+            has_error = EXIT_FAILURE;
+        } else {
+            ucd->cdata->num_rows = c.num_cells;
+            has_error = _ucd_stats_read_sub(&c, ucd->cdata, num_bins, *cstats);
+        }
+    }
+
+    has_error = ucd_close(&c) || has_error;
+    if (has_error) {
+        fprintf(stderr, "%s: cannot read %s\n", __func__, filename);
+        _ucd_stats_free_array(*nstats, c.num_ndata);
+        _ucd_stats_free_array(*cstats, c.num_cdata);
+        *nstats = NULL;
+        *cstats = NULL;
+        ucd_simple_free(ucd);
+    }
+    return has_error;
+}
@@ -0,0 +1,390 @@
+/**
+ * @file ucd_vtk.c
+ * @brief Functions relate to writing a content in VTK file formats.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include "ucd_private.h"
+
+#ifdef _WIN32
+#pragma warning(disable:4996)
+#endif
+
+/* cell types of VTK for those of UCD */
+static const int _ucd_vtk_cell_type[8] = {1, 3, 5, 9, 10, 14, 13, 12};
+
+/*
+ * Node k of a VTK cell is node _ucd_vtk_node_order[type][k] of the UCD
+ * cell.  Orientations are those of ucd_cell_quality(), where the apex of
+ * pyr is the first and the normal of the first face of prism points into
+ * the cell, while VTK has the apex last and the normal of wedges outward.
+ */
+static const int _ucd_vtk_node_order[8][8] = {
+    {0},
+    {0, 1},
+    {0, 1, 2},
+    {0, 1, 2, 3},
+    {0, 1, 2, 3},
+    {1, 2, 3, 4, 0},
+    {0, 2, 1, 3, 5, 4},
+    {0, 1, 2, 3, 4, 5, 6, 7}
+};
+
+
+static int _ucd_vtk_is_big_endian(void)
+{
+    union {
+        int i;
+        char c[sizeof(int)];
+    } u;
+
+    u.i = 1;
+    return u.c[0] == 0;
+}
+
+
+/* write 4-byte words, byte-swapped through a buffer if necessary */
+static void _ucd_vtk_write_words(FILE* fp, const void* data, long count,
+        int swap)
+{
+    unsigned char buffer[4 * UCD_BLOCK_ROWS];
+    const unsigned char* p;
+    long n, i;
+
+    if (!swap) {
+        fwrite(data, 4, count, fp);
+        return;
+    }
+    p = data;
+    for (; count > 0; count -= n, p += 4 * n) {
+        n = count < UCD_BLOCK_ROWS ? count : UCD_BLOCK_ROWS;
+        for (i = 0; i < n; ++i) {
+            buffer[4*i] = p[4*i+3];
+            buffer[4*i+1] = p[4*i+2];
+            buffer[4*i+2] = p[4*i+1];
+            buffer[4*i+3] = p[4*i];
+        }
+        fwrite(buffer, 4, n, fp);
+    }
+}
+
+
+/* coordinates are interleaved by blocks of nodes */
+static void _ucd_vtk_write_points(FILE* fp, const ucd_content* ucd, int swap)
+{
+    float buffer[3 * UCD_BLOCK_ROWS];
+    int first, n, i;
+
+    for (first = 0; first < ucd->num_nodes; first += n) {
+        n = ucd->num_nodes - first < UCD_BLOCK_ROWS
+            ? ucd->num_nodes - first : UCD_BLOCK_ROWS;
+        for (i = 0; i < n; ++i) {
+            buffer[3*i] = ucd->node_x[first + i];
+            buffer[3*i+1] = ucd->node_y[first + i];
+            buffer[3*i+2] = ucd->node_z[first + i];
+        }
+        _ucd_vtk_write_words(fp, buffer, 3L * n, swap);
+    }
+}
+
+
+/*
+ * Tuples of a component are contiguous in component layout and written
+ * straight from data, otherwise they are gathered by blocks of rows.  A
+ * tuple wider than a block is written row by row.
+ */
+static void _ucd_vtk_write_component(FILE* fp, const ucd_data* d, int comp,
+        int swap)
+{
+    float buffer[UCD_BLOCK_ROWS];
+    const float* data;
+    int size, ld, rows, first, n, i, j;
+
+    size = d->components[comp];
+    data = ucd_data_component(d, comp, &ld);
+    if (ld == size) {
+        _ucd_vtk_write_words(fp, data, (long)d->num_rows * size, swap);
+        return;
+    }
+    if (size > UCD_BLOCK_ROWS) {
+        for (i = 0; i < d->num_rows; ++i) {
+            _ucd_vtk_write_words(fp, &data[(long)ld * i], size, swap);
+        }
+        return;
+    }
+    rows = UCD_BLOCK_ROWS / size;
+    for (first = 0; first < d->num_rows; first += n) {
+        n = d->num_rows - first < rows ? d->num_rows - first : rows;
+        for (i = 0; i < n; ++i) {
+            for (j = 0; j < size; ++j) {
+                buffer[size * i + j] = data[ld * (first + i) + j];
+            }
+        }
+        _ucd_vtk_write_words(fp, buffer, (long)n * size, swap);
+    }
+}
+
+
+/* connectivity of cells in VTK order of nodes */
+static int* _ucd_vtk_connectivity(const ucd_content* ucd, int* offsets)
+{
+    int nodes[8];
+    ucd_node_index index;
+    int* conn;
+    int type, i, k;
+
+    offsets[0] = 0;
+    for (i = 0; i < ucd->num_cells; ++i) {
+        type = ucd->cell_type[i];
+        if (type < 0 || type > 7) {
+            fprintf(stderr, "%s: cell %d has invalid type %d\n",
+                    __func__, ucd->cell_id[i], type);
+            return NULL;
+        }
+        offsets[i + 1] = offsets[i] + ucd_cell_nlist_size(type);
+    }
+
+    _ucd_node_index_build(&index, ucd);
+    conn = malloc(offsets[ucd->num_cells] * sizeof(*conn) + 1);
+    if (index.table == NULL || conn == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        _ucd_node_index_free(&index);
+        free(conn);
+        return NULL;
+    }
+    for (i = 0; i < ucd->num_cells; ++i) {
+        if (_ucd_cell_nodes(ucd, &index, i, nodes)) {
+            _ucd_node_index_free(&index);
+            free(conn);
+            return NULL;
+        }
+        type = ucd->cell_type[i];
+        for (k = 0; k < offsets[i + 1] - offsets[i]; ++k) {
+            conn[offsets[i] + k] = nodes[_ucd_vtk_node_order[type][k]];
+        }
+    }
+
+    _ucd_node_index_free(&index);
+    return conn;
+}
+
+
+/* a label is written as an XML attribute, or as a word in legacy format */
+static void _ucd_vtk_write_name(FILE* fp, const char* label, int is_xml)
+{
+    for (; *label != '\0'; ++label) {
+        if (!is_xml) {
+            putc(*label == ' ' || *label == '\t' ? '_' : *label, fp);
+        } else if (*label == '&') {
+            fputs("&amp;", fp);
+        } else if (*label == '<') {
+            fputs("&lt;", fp);
+        } else if (*label == '>') {
+            fputs("&gt;", fp);
+        } else if (*label == '"') {
+            fputs("&quot;", fp);
+        } else {
+            putc(*label, fp);
+        }
+    }
+}
+
+
+static void _ucd_vtk_xml_arrays(FILE* fp, const ucd_data* d,
+        const char* tag, unsigned long* offset)
+{
+    const char* anchor_l;
+    int i;
+
+    if (d == NULL) {
+        return;
+    }
+    fprintf(fp, "<%s>\n", tag);
+    anchor_l = d->labels;
+    for (i = 0; i < d->num_comp; ++i) {
+        fprintf(fp, "<DataArray type=\"Float32\" Name=\"");
+        _ucd_vtk_write_name(fp, anchor_l, 1);
+        fprintf(fp, "\" NumberOfComponents=\"%d\" format=\"appended\""
+                " offset=\"%lu\"/>\n", d->components[i], *offset);
+        *offset += 8 + 4UL * d->num_rows * d->components[i];
+        anchor_l += strlen(anchor_l) + 1;
+    }
+    fprintf(fp, "</%s>\n", tag);
+}
+
+
+/* sizes of blocks are UInt64 in the byte order of the file */
+static void _ucd_vtk_xml_block(FILE* fp, unsigned long size)
+{
+    unsigned char header[8];
+    int big_endian, i;
+
+    big_endian = _ucd_vtk_is_big_endian();
+    for (i = 0; i < 8; ++i) {
+        header[big_endian ? 7 - i : i] = (unsigned char)(size & 0xff);
+        size >>= 8;
+    }
+    fwrite(header, 1, 8, fp);
+}
+
+
+static int _ucd_vtk_write_xml(FILE* fp, const ucd_content* ucd,
+        const int* conn, const int* offsets)
+{
+    unsigned char types[UCD_BLOCK_ROWS];
+    unsigned long offset;
+    const ucd_data* d;
+    int first, n, nc, i;
+
+    fprintf(fp, "<?xml version=\"1.0\"?>\n");
+    fprintf(fp, "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\""
+            " byte_order=\"%s\" header_type=\"UInt64\">\n",
+            _ucd_vtk_is_big_endian() ? "BigEndian" : "LittleEndian");
+    fprintf(fp, "<UnstructuredGrid>\n");
+    fprintf(fp, "<Piece NumberOfPoints=\"%d\" NumberOfCells=\"%d\">\n",
+            ucd->num_nodes, ucd->num_cells);
+
+    offset = 0;
+    _ucd_vtk_xml_arrays(fp, ucd->ndata, "PointData", &offset);
+    _ucd_vtk_xml_arrays(fp, ucd->cdata, "CellData", &offset);
+    fprintf(fp, "<Points>\n<DataArray type=\"Float32\""
+            " NumberOfComponents=\"3\" format=\"appended\" offset=\"%lu\"/>\n"
+            "</Points>\n", offset);
+    offset += 8 + 12UL * ucd->num_nodes;
+    fprintf(fp, "<Cells>\n<DataArray type=\"Int32\" Name=\"connectivity\""
+            " format=\"appended\" offset=\"%lu\"/>\n", offset);
+    offset += 8 + 4UL * offsets[ucd->num_cells];
+    fprintf(fp, "<DataArray type=\"Int32\" Name=\"offsets\""
+            " format=\"appended\" offset=\"%lu\"/>\n", offset);
+    offset += 8 + 4UL * ucd->num_cells;
+    fprintf(fp, "<DataArray type=\"UInt8\" Name=\"types\""
+            " format=\"appended\" offset=\"%lu\"/>\n</Cells>\n", offset);
+    fprintf(fp, "</Piece>\n</UnstructuredGrid>\n");
+
+    /* blocks in the order of offsets, with sizes in bytes before them */
+    fprintf(fp, "<AppendedData encoding=\"raw\">\n_");
+    for (nc = 0; nc < 2; ++nc) {
+        d = nc == 0 ? ucd->ndata : ucd->cdata;
+        for (i = 0; d != NULL && i < d->num_comp; ++i) {
+            _ucd_vtk_xml_block(fp, 4UL * d->num_rows * d->components[i]);
+            _ucd_vtk_write_component(fp, d, i, 0);
+        }
+    }
+    _ucd_vtk_xml_block(fp, 12UL * ucd->num_nodes);
+    _ucd_vtk_write_points(fp, ucd, 0);
+    _ucd_vtk_xml_block(fp, 4UL * offsets[ucd->num_cells]);
+    fwrite(conn, sizeof(int), offsets[ucd->num_cells], fp);
+    _ucd_vtk_xml_block(fp, 4UL * ucd->num_cells);
+    fwrite(&offsets[1], sizeof(int), ucd->num_cells, fp);
+    _ucd_vtk_xml_block(fp, ucd->num_cells);
+    for (first = 0; first < ucd->num_cells; first += n) {
+        n = ucd->num_cells - first < UCD_BLOCK_ROWS
+            ? ucd->num_cells - first : UCD_BLOCK_ROWS;
+        for (i = 0; i < n; ++i) {
+            types[i] = (unsigned char)
+                _ucd_vtk_cell_type[ucd->cell_type[first + i]];
+        }
+        fwrite(types, 1, n, fp);
+    }
+    fprintf(fp, "\n</AppendedData>\n</VTKFile>\n");
+
+    return ferror(fp);
+}
+
+
+static void _ucd_vtk_legacy_fields(FILE* fp, const ucd_data* d,
+        const char* tag, int swap)
+{
+    const char* anchor_l;
+    int i;
+
+    if (d == NULL) {
+        return;
+    }
+    fprintf(fp, "%s %d\nFIELD FieldData %d\n", tag, d->num_rows, d->num_comp);
+    anchor_l = d->labels;
+    for (i = 0; i < d->num_comp; ++i) {
+        _ucd_vtk_write_name(fp, anchor_l, 0);
+        fprintf(fp, " %d %d float\n", d->components[i], d->num_rows);
+        _ucd_vtk_write_component(fp, d, i, swap);
+        fprintf(fp, "\n");
+        anchor_l += strlen(anchor_l) + 1;
+    }
+}
+
+
+/* binary values of legacy format are big endian */
+static int _ucd_vtk_write_legacy(FILE* fp, const ucd_content* ucd,
+        const int* conn, const int* offsets)
+{
+    int buffer[UCD_BLOCK_ROWS];
+    int swap, first, n, i;
+
+    swap = !_ucd_vtk_is_big_endian();
+    fprintf(fp, "# vtk DataFile Version 3.0\n");
+    fprintf(fp, "converted from UCD\nBINARY\nDATASET UNSTRUCTURED_GRID\n");
+    fprintf(fp, "POINTS %d float\n", ucd->num_nodes);
+    _ucd_vtk_write_points(fp, ucd, swap);
+
+    fprintf(fp, "\nCELLS %d %d\n", ucd->num_cells,
+            ucd->num_cells + offsets[ucd->num_cells]);
+    for (i = 0; i < ucd->num_cells; ++i) {
+        n = offsets[i + 1] - offsets[i];
+        _ucd_vtk_write_words(fp, &n, 1, swap);
+        _ucd_vtk_write_words(fp, &conn[offsets[i]], n, swap);
+    }
+
+    fprintf(fp, "\nCELL_TYPES %d\n", ucd->num_cells);
+    for (first = 0; first < ucd->num_cells; first += n) {
+        n = ucd->num_cells - first < UCD_BLOCK_ROWS
+            ? ucd->num_cells - first : UCD_BLOCK_ROWS;
+        for (i = 0; i < n; ++i) {
+            buffer[i] = _ucd_vtk_cell_type[ucd->cell_type[first + i]];
+        }
+        _ucd_vtk_write_words(fp, buffer, n, swap);
+    }
+    fprintf(fp, "\n");
+
+    _ucd_vtk_legacy_fields(fp, ucd->ndata, "POINT_DATA", swap);
+    _ucd_vtk_legacy_fields(fp, ucd->cdata, "CELL_DATA", swap);
+
+    return ferror(fp);
+}
+
+
+int ucd_vtk_writer(const ucd_content* ucd, const char* filename, int is_xml)
+{
+    FILE* fp;
+    int *offsets, *conn;
+    int has_error;
+
+    offsets = malloc((ucd->num_cells + 1) * sizeof(*offsets));
+    if (offsets == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+    conn = _ucd_vtk_connectivity(ucd, offsets);
+    if (conn == NULL) {
+        free(offsets);
+        return EXIT_FAILURE;
+    }
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+        free(offsets);
+        free(conn);
+        return EXIT_FAILURE;
+    }
+    if (is_xml) {
+        has_error = _ucd_vtk_write_xml(fp, ucd, conn, offsets);
+    } else {
+        has_error = _ucd_vtk_write_legacy(fp, ucd, conn, offsets);
+    }
+    has_error = fclose(fp) || has_error;
+
+    free(offsets);
+    free(conn);
+    return has_error;
+}
@@ -10,132 +10,692 @@
 static const int zero = 0;
 
 
-static void _ucd_simple_writer_sub(ucd_context* c, const ucd_data* d)
+static int _ucd_simple_writer_sub(ucd_context* c, const ucd_data* d)
 {
-    int base_col, i;
+    ucd_data row;
+    int ld, has_error, i;
+    long pos;
+    float* data;
 
     if (d == NULL)
-        return;
+        return EXIT_SUCCESS;
 
-    ucd_write_data_header(c,
+    has_error = ucd_write_data_header(c,
             d->num_comp, d->components, d->labels, d->units);
+    if (has_error) {
+        return has_error;
+    }
     if (c->is_binary) {
         ucd_write_data_minmax(c, d->minima, d->maxima);
-        base_col = 0;
-        for (i = 0; i < d->num_comp; ++i) {
-            ucd_write_data_binary(c,
-                    d->components[i], &d->data[base_col], d->num_data);
-            base_col += d->components[i];
+        if (c->chunk_rows > 0) {
+            return _ucd_chunk_write_data(c, d);
         }
-        ucd_write_data_active_list(c, NULL);
-    } else {
-        ucd_write_data_ascii_n(c, d->row_id, d->data);
+        for (i = 0; i < d->num_comp && !has_error; ++i) {
+            data = ucd_data_component(d, i, &ld);
+            has_error = ucd_write_data_binary(c, d->components[i], data, ld);
+        }
+        return has_error || ucd_write_data_active_list(c, NULL);
+    } else if (d->layout != UCD_LAYOUT_COMPONENT) {
+        return ucd_write_data_ascii_n(c, d->row_id, d->data);
     }
+
+    /* gather each row */
+    row = *d;
+    row.layout = UCD_LAYOUT_ROW;
+    row.data = malloc(d->num_data * sizeof(*row.data));
+    if (row.data == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+    pos = ftell(c->_fp);
+    for (i = 0; i < d->num_rows && !has_error; ++i) {
+        _ucd_data_copy_row(&row, 0, d, i);
+        has_error = ucd_write_data_ascii_1(c, d->row_id[i], row.data)
+            || _ucd_progress_rows(c, &pos, i + 1, d->num_rows, d->num_data);
+    }
+    free(row.data);
+    return has_error;
 }
 
 int ucd_simple_writer(const ucd_content* ucd, const char* filename, int is_binary)
 {
-    ucd_context c;
+    return ucd_simple_writer_ex(ucd, filename, is_binary, NULL);
+}
+
+
+/*
+ * The end of a run of cells from the first one, of which node lists are
+ * contiguous in an array of the leading dimension.
+ */
+static int _ucd_nlist_run(const int* cells, int ld_nlist, int first, int last)
+{
     int i;
+
+    for (i = first; i < last && cells[4*i+2] == ld_nlist; ++i) {
+        continue;
+    }
+    return i > first ? i : first + 1;
+}
+
+
+/* sections of the binary format written by _ucd_simple_writer_parallel() */
+#define UCD_TASK_CELLS  0
+#define UCD_TASK_NLIST  1
+#define UCD_TASK_COORD  2
+#define UCD_TASK_HEADER 3
+#define UCD_TASK_BLOCK  4
+#define UCD_TASK_ACTIVE 5
+
+
+static int _ucd_task_seek(ucd_context* c, long offset)
+{
+    if (fseek(c->_fp, offset, SEEK_SET) != 0) {
+        fprintf(stderr, "%s: cannot seek to %ld\n", __func__, offset);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+static int _ucd_write_task(ucd_context* c, const ucd_content* ucd,
+        const ucd_binary_layout* layout, const int* cells,
+        int kind, int nc, int arg)
+{
+    const ucd_data* d;
+    const float* coords;
+    float *data, *minima, *maxima;
+    int* nlist;
+    int has_error, base, ld, i, j;
+    size_t k;
+
+    d = nc == 0 ? ucd->ndata : ucd->cdata;
+
+    switch (kind) {
+    case UCD_TASK_CELLS:
+        if (_ucd_task_seek(c, layout->cells)
+                || _ucd_progress_fwrite(c, cells,
+                    4 * sizeof(int), c->num_cells, 1)) {
+            return EXIT_FAILURE;
+        }
+        break;
+    case UCD_TASK_NLIST:
+        if (_ucd_task_seek(c, layout->nlist)) {
+            return EXIT_FAILURE;
+        }
+        if ((size_t)c->num_nlist == (size_t)ucd->ld_nlist * c->num_cells) {
+            /* no padding, e.g. cells of a type or grouped by types */
+            if (_ucd_progress_fwrite(c, ucd->cell_nlist,
+                        sizeof(int), c->num_nlist, 0)) {
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+        /* packed to be written at once */
+        nlist = malloc(c->num_nlist * sizeof(*nlist) + 1);
+        if (nlist == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        for (i = 0, k = 0; i < c->num_cells; i = j) {
+            j = _ucd_nlist_run(cells, ucd->ld_nlist, i, c->num_cells);
+            base = j - i > 1 ? (j - i) * ucd->ld_nlist : cells[4*i+2];
+            memcpy(&nlist[k], &ucd->cell_nlist[(size_t)ucd->ld_nlist * i],
+                    base * sizeof(*nlist));
+            k += base;
+        }
+        has_error = _ucd_progress_fwrite(c, nlist,
+                sizeof(int), c->num_nlist, 0);
+        free(nlist);
+        if (has_error) {
+            return EXIT_FAILURE;
+        }
+        break;
+    case UCD_TASK_COORD:
+        coords = arg == 0 ? ucd->node_x : arg == 1 ? ucd->node_y : ucd->node_z;
+        if (_ucd_task_seek(c, layout->coords
+                    + (long)arg * c->num_nodes * sizeof(float))
+                || _ucd_progress_fwrite(c, coords,
+                    sizeof(float), c->num_nodes, 1)) {
+            return EXIT_FAILURE;
+        }
+        break;
+    case UCD_TASK_HEADER:
+        if (_ucd_task_seek(c, layout->header[nc])) {
+            return EXIT_FAILURE;
+        }
+        c->_nc = nc;
+        if (ucd_write_data_header(c,
+                    d->num_comp, d->components, d->labels, d->units)) {
+            return EXIT_FAILURE;
+        }
+        return ucd_write_data_minmax(c, d->minima, d->maxima);
+    case UCD_TASK_BLOCK:
+        base = 0;
+        for (i = 0; i < arg; ++i) {
+            base += d->components[i];
+        }
+        if (_ucd_task_seek(c, layout->body[nc] + (long)d->num_rows * base
+                    * _ucd_encoding_size(c->encoding))) {
+            return EXIT_FAILURE;
+        }
+        c->_nc = nc + 1;
+        c->_col = base;
+        /* minima and maxima of data are borrowed to quantize */
+        minima = c->_minima;
+        maxima = c->_maxima;
+        c->_minima = d->minima;
+        c->_maxima = d->maxima;
+        data = ucd_data_component(d, arg, &ld);
+        has_error = ucd_write_data_binary(c, d->components[arg], data, ld);
+        c->_minima = minima;
+        c->_maxima = maxima;
+        return has_error;
+    case UCD_TASK_ACTIVE:
+        if (_ucd_task_seek(c, layout->active[nc])) {
+            return EXIT_FAILURE;
+        }
+        c->_nc = nc + 1;
+        return ucd_write_data_active_list(c, NULL);
+    }
+
+    return ferror(c->_fp);
+}
+
+
+/* open with options already in the context */
+static int _ucd_writer_open(ucd_context* c, const char* filename)
+{
+    char magic_number;
+
+    if (c->is_binary && (c->encoding < UCD_ENCODING_FLOAT32
+                || c->encoding > UCD_ENCODING_UINT8)) {
+        fprintf(stderr, "%s: encoding %d is invalid\n", __func__, c->encoding);
+        return EXIT_FAILURE;
+    }
+
+    /* sections not written in order are read back to compute checksums */
+    c->_fp = fopen(filename, !c->is_binary ? "w" : c->checksum ? "w+b" : "wb");
+    if (c->_fp == NULL) {
+        fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+        return EXIT_FAILURE;
+    }
+    c->_minima = NULL;
+    c->_maxima = NULL;
+    c->_is_writer = 1;
+    _ucd_checksum_track(c);
+
+    if (c->is_binary) {
+        magic_number = c->chunk_rows > 0 ? UCD_MAGIC_NUMBER_CHUNK
+            : c->encoding == UCD_ENCODING_FLOAT32
+            ? UCD_MAGIC_NUMBER : UCD_MAGIC_NUMBER_EXT;
+        _ucd_checksum_fwrite(c, &magic_number, sizeof(char), 1);
+        _ucd_checksum_fwrite(c, &c->num_nodes, sizeof(int), 1);
+        _ucd_checksum_fwrite(c, &c->num_cells, sizeof(int), 1);
+        _ucd_checksum_fwrite(c, &c->num_ndata, sizeof(int), 1);
+        _ucd_checksum_fwrite(c, &c->num_cdata, sizeof(int), 1);
+        if (c->chunk_rows > 0) {
+            _ucd_checksum_fwrite(c, &c->chunk_rows, sizeof(int), 1);
+        } else if (c->encoding == UCD_ENCODING_FLOAT32) {
+            _ucd_checksum_fwrite(c, &zero, sizeof(int), 1); /* mdata */
+        } else {
+            _ucd_checksum_fwrite(c, &c->encoding, sizeof(int), 1);
+        }
+        _ucd_checksum_fwrite(c, &c->num_nlist, sizeof(int), 1);
+    } else {
+        fprintf(c->_fp, "%d %d %d %d 0\n",
+                c->num_nodes, c->num_cells, c->num_ndata, c->num_cdata);
+    }
+
+    c->_nc = 0;
+
+    return ferror(c->_fp);
+}
+
+
+/*
+ * Offsets of all sections are known from the numbers, so the file is
+ * extended to its size first and sections are written by threads with
+ * their own file handles.
+ */
+static int _ucd_simple_writer_parallel(const ucd_content* ucd,
+        const char* filename, ucd_context* c, const int* cells)
+{
+    ucd_binary_layout layout;
+    int *kinds, *ncs, *args;
+    int num_tasks, checksum, has_error, nc, t;
+    const ucd_data* d;
+    const char last = 0;
+
+    _ucd_binary_layout(c, &layout);
+
+    /* checksums are combined from those of tasks */
+    checksum = c->checksum;
+    c->checksum = 0;
+    if (_ucd_writer_open(c, filename)) {
+        c->checksum = checksum;
+        return EXIT_FAILURE;
+    }
+    has_error = fseek(c->_fp, layout.end - 1, SEEK_SET) != 0
+        || fwrite(&last, sizeof(char), 1, c->_fp) != 1;
+    has_error = ucd_close(c) || has_error;
+    c->checksum = checksum;
+    if (has_error) {
+        fprintf(stderr, "%s: cannot write %s\n", __func__, filename);
+        return EXIT_FAILURE;
+    }
+    _ucd_checksum_track(c);
+
+    num_tasks = 5 + 2 * 2;
+    num_tasks += ucd->ndata != NULL ? ucd->ndata->num_comp : 0;
+    num_tasks += ucd->cdata != NULL ? ucd->cdata->num_comp : 0;
+    kinds = malloc(num_tasks * sizeof(*kinds));
+    ncs = malloc(num_tasks * sizeof(*ncs));
+    args = malloc(num_tasks * sizeof(*args));
+    if (kinds == NULL || ncs == NULL || args == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        free(kinds);
+        free(ncs);
+        free(args);
+        _ucd_crc_log_free(c->_crc_log);
+        c->_crc_log = NULL;
+        return EXIT_FAILURE;
+    }
+
+    num_tasks = 0;
+    for (t = 0; t < 5; ++t) {
+        kinds[num_tasks] = t < 2 ? t : UCD_TASK_COORD;
+        ncs[num_tasks] = 0;
+        args[num_tasks++] = t - 2;
+    }
+    for (nc = 0; nc < 2; ++nc) {
+        d = nc == 0 ? ucd->ndata : ucd->cdata;
+        if (d == NULL) {
+            continue;
+        }
+        kinds[num_tasks] = UCD_TASK_HEADER;
+        ncs[num_tasks++] = nc;
+        for (t = 0; t < d->num_comp; ++t) {
+            kinds[num_tasks] = UCD_TASK_BLOCK;
+            ncs[num_tasks] = nc;
+            args[num_tasks++] = t;
+        }
+        kinds[num_tasks] = UCD_TASK_ACTIVE;
+        ncs[num_tasks++] = nc;
+    }
+
+    has_error = EXIT_SUCCESS;
+#ifdef _OPENMP
+#pragma omp parallel reduction(|:has_error)
+#endif
+    {
+        ucd_context task;
+        int i;
+
+        task = *c;
+        task._owner = c;
+        task._minima = NULL;
+        task._maxima = NULL;
+        task._rows = NULL;
+        task.checksum = 0;
+        task._crc_log = c->_crc_log != NULL ? _ucd_crc_log_alloc(1) : NULL;
+        task._fp = fopen(filename, "r+b");
+        if (task._fp == NULL) {
+            fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+            has_error = EXIT_FAILURE;
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (i = 0; i < num_tasks; ++i) {
+            if (task._fp != NULL) {
+                has_error |= _ucd_write_task(&task, ucd, &layout, cells,
+                        kinds[i], ncs[i], args[i]);
+            }
+        }
+        if (task._fp != NULL) {
+            has_error |= ucd_close(&task);
+        } else {
+            _ucd_crc_log_free(task._crc_log);
+        }
+    }
+
+    free(kinds);
+    free(ncs);
+    free(args);
+
+    if (!c->_cancelled && !has_error && c->checksum) {
+        c->_fp = fopen(filename, "r+b");
+        if (c->_fp == NULL) {
+            fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
+            has_error = EXIT_FAILURE;
+        } else {
+            has_error = ucd_close(c);
+        }
+    }
+    _ucd_crc_log_free(c->_crc_log);
+    c->_crc_log = NULL;
+    if (c->_cancelled) {
+        remove(filename);
+        return EXIT_FAILURE;
+    }
+    return has_error;
+}
+
+
+int ucd_simple_writer_ex(const ucd_content* ucd, const char* filename,
+        int is_binary, const ucd_options* o)
+{
+    ucd_context context;
+    ucd_context* c = &context;
+    int has_error, i;
     int* cells;
 
-    c.is_binary = is_binary;
-    c.num_nodes = ucd->num_nodes;
-    c.num_cells = ucd->num_cells;
-    c.num_ndata = ucd->ndata != NULL ? ucd->ndata->num_data : 0;
-    c.num_cdata = ucd->cdata != NULL ? ucd->cdata->num_data : 0;
-    c.num_nlist = 0;
+    _ucd_context_open(c, o);
+    c->is_binary = is_binary;
+    c->num_nodes = ucd->num_nodes;
+    c->num_cells = ucd->num_cells;
+    c->num_ndata = ucd->ndata != NULL ? ucd->ndata->num_data : 0;
+    c->num_cdata = ucd->cdata != NULL ? ucd->cdata->num_data : 0;
+    c->num_nlist = 0;
 
     cells = malloc(4 * ucd->num_cells * sizeof(*cells));
+    if (cells == NULL && ucd->num_cells > 0) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
     for (i = 0; i < ucd->num_cells; ++i) {
         cells[4*i] = ucd->cell_id[i];
         cells[4*i+1] = ucd->cell_mat_id[i];
         cells[4*i+2] = ucd_cell_nlist_size(ucd->cell_type[i]);
         cells[4*i+3] = ucd->cell_type[i];
-        c.num_nlist += cells[4*i+2];
+        c->num_nlist += cells[4*i+2];
+    }
+    if (c->is_binary && c->chunk_rows <= 0) {
+        i = _ucd_simple_writer_parallel(ucd, filename, c, cells);
+        free(cells);
+        return i;
+    }
+
+    if (_ucd_writer_open(c, filename)) {
+        free(cells);
+        return EXIT_FAILURE;
     }
-    ucd_writer_open(&c, filename);
-    ucd_write_nodes_and_cells(&c,
+    has_error = ucd_write_nodes_and_cells(c,
             ucd->node_id, ucd->node_x, ucd->node_y, ucd->node_z,
             cells, ucd->cell_nlist, ucd->ld_nlist);
     free(cells);
 
-    _ucd_simple_writer_sub(&c, ucd->ndata);
-    _ucd_simple_writer_sub(&c, ucd->cdata);
+    if (!has_error) {
+        has_error = _ucd_simple_writer_sub(c, ucd->ndata);
+    }
+    if (!has_error) {
+        has_error = _ucd_simple_writer_sub(c, ucd->cdata);
+    }
 
-    ucd_close(&c);
+    /* a cancelled file is removed without the trailer */
+    if (c->_cancelled) {
+        c->_is_writer = 0;
+        ucd_close(c);
+        remove(filename);
+        return EXIT_FAILURE;
+    }
+    return ucd_close(c) || has_error;
+}
 
-    return EXIT_SUCCESS;
+
+int ucd_simple_rewriter(const ucd_content* ucd, const char* filename)
+{
+    ucd_context c;
+    int has_error;
+
+    if (ucd_rewriter_open(&c, filename)) {
+        return EXIT_FAILURE;
+    }
+
+    has_error = EXIT_SUCCESS;
+    if (c.num_nodes != ucd->num_nodes || c.num_cells != ucd->num_cells
+            || (c.num_ndata > 0) != (ucd->ndata != NULL)
+            || (c.num_cdata > 0) != (ucd->cdata != NULL)) {
+        fprintf(stderr, "%s: %s has different numbers\n", __func__, filename);
+        has_error = EXIT_FAILURE;
+    }
+    if (!has_error && ucd->ndata != NULL) {
+        has_error = ucd_rewrite_data(&c, ucd->ndata, 0, -1);
+    }
+    if (!has_error && ucd->cdata != NULL) {
+        has_error = ucd_rewrite_data(&c, ucd->cdata, 1, -1);
+    }
+
+    return ucd_close(&c) || has_error;
 }
 
 
-int ucd_writer_open(ucd_context* c, const char* filename)
+int ucd_rewriter_open(ucd_context* c, const char* filename)
 {
-    const char magic_number = UCD_MAGIC_NUMBER;
+    if (ucd_reader_open(c, filename)) {
+        return EXIT_FAILURE;
+    }
+    if (!c->is_binary || c->chunk_rows > 0) {
+        fprintf(stderr, "%s: %s is not classic binary\n", __func__, filename);
+        ucd_close(c);
+        return EXIT_FAILURE;
+    }
 
-    c->_fp = fopen(filename, c->is_binary ? "wb" : "w");
+    /* the checksum trailer, if any, is updated in ucd_close() */
+    c->_fp = freopen(filename, "r+b", c->_fp);
     if (c->_fp == NULL) {
         fprintf(stderr, "%s: cannot open %s\n", __func__, filename);
         return EXIT_FAILURE;
     }
+    c->_is_writer = 1;
+    _ucd_checksum_track(c);
+    return EXIT_SUCCESS;
+}
 
-    if (c->is_binary) {
-        fwrite(&magic_number, sizeof(char), 1, c->_fp);
-        fwrite(&c->num_nodes, sizeof(int), 1, c->_fp);
-        fwrite(&c->num_cells, sizeof(int), 1, c->_fp);
-        fwrite(&c->num_ndata, sizeof(int), 1, c->_fp);
-        fwrite(&c->num_cdata, sizeof(int), 1, c->_fp);
-        fwrite(&zero, sizeof(int), 1, c->_fp); /* mdata */
-        fwrite(&c->num_nlist, sizeof(int), 1, c->_fp);
-    } else {
-        fprintf(c->_fp, "%d %d %d %d 0\n",
-                c->num_nodes, c->num_cells, c->num_ndata, c->num_cdata);
+
+int ucd_rewrite_data(ucd_context* c, const ucd_data* d, int is_cell, int comp)
+{
+    ucd_binary_layout layout;
+    int num_rows, num_data, num_comp, first, last, col, ld, i;
+    int* components;
+    float* data;
+
+    c->_nc = is_cell ? 2 : 1;
+    ucd_data_dimension(c, &num_rows, &num_data);
+    if (d->num_rows != num_rows || d->num_data != num_data || num_data == 0) {
+        fprintf(stderr, "%s: numbers of data are different\n", __func__);
+        return EXIT_FAILURE;
+    }
+    if (comp >= d->num_comp) {
+        fprintf(stderr, "%s: component %d is invalid\n", __func__, comp);
+        return EXIT_FAILURE;
     }
 
-    c->_nc = 0;
+    /* sizes of components should be the same as the file */
+    _ucd_binary_layout(c, &layout);
+    components = malloc(num_data * sizeof(*components));
+    if (components == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+    fseek(c->_fp, layout.header[is_cell] + 2 * UCD_TEXT_FIELD_SIZE, SEEK_SET);
+    fread(&num_comp, sizeof(int), 1, c->_fp);
+    fread(components, sizeof(int), num_data, c->_fp);
+    if (ferror(c->_fp) || num_comp != d->num_comp
+            || memcmp(components, d->components,
+                num_comp * sizeof(*components)) != 0) {
+        fprintf(stderr, "%s: components are different\n", __func__);
+        free(components);
+        return EXIT_FAILURE;
+    }
+    free(components);
+
+    /* minima and maxima of the file updated by the columns to write */
+    free(c->_minima);
+    free(c->_maxima);
+    c->_minima = malloc(num_data * sizeof(*c->_minima));
+    c->_maxima = malloc(num_data * sizeof(*c->_maxima));
+    if (c->_minima == NULL || c->_maxima == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        return EXIT_FAILURE;
+    }
+    fseek(c->_fp, layout.minmax[is_cell], SEEK_SET);
+    fread(c->_minima, sizeof(float), num_data, c->_fp);
+    fread(c->_maxima, sizeof(float), num_data, c->_fp);
+
+    first = comp < 0 ? 0 : comp;
+    last = comp < 0 ? d->num_comp : comp + 1;
+    col = 0;
+    for (i = 0; i < first; ++i) {
+        col += d->components[i];
+    }
+    c->_col = col;
+    for (i = first; i < last; ++i) {
+        col += d->components[i];
+    }
+    for (i = c->_col; i < col; ++i) {
+        _ucd_data_column_minmax(d, i, &c->_minima[i], &c->_maxima[i]);
+    }
+
+    fseek(c->_fp, layout.minmax[is_cell], SEEK_SET);
+    _ucd_checksum_fwrite(c, c->_minima, sizeof(float), num_data);
+    _ucd_checksum_fwrite(c, c->_maxima, sizeof(float), num_data);
+
+    /* component blocks are contiguous in the body */
+    fseek(c->_fp, layout.body[is_cell]
+            + (long)num_rows * c->_col * _ucd_encoding_size(c->encoding),
+            SEEK_SET);
+    for (i = first; i < last; ++i) {
+        data = ucd_data_component(d, i, &ld);
+        if (ucd_write_data_binary(c, d->components[i], data, ld)) {
+            return EXIT_FAILURE;
+        }
+    }
 
     return ferror(c->_fp);
 }
 
 
+int ucd_writer_open(ucd_context* c, const char* filename)
+{
+    return ucd_writer_open_ex(c, filename, NULL);
+}
+
+
+int ucd_writer_open_ex(ucd_context* c, const char* filename,
+        const ucd_options* o)
+{
+    _ucd_context_open(c, o);
+    return _ucd_writer_open(c, filename);
+}
+
+
 int ucd_write_nodes_and_cells(
         ucd_context* c,
         const int* nodes, const float* x, const float* y, const float* z,
         const int* cells, const int* nlist, int ld_nlist)
 {
     int i, j;
+    long pos;
+    const float* coords[3];
+    static const int lds[3] = {1, 1, 1};
 
     if (c->is_binary) {
-        fwrite(cells, sizeof(int), 4 * c->num_cells, c->_fp);
-        for (i = 0; i < c->num_cells; ++i) {
-            fwrite(&nlist[ld_nlist*i], sizeof(int), cells[4*i+2], c->_fp);
+        if (_ucd_progress_fwrite(c, cells, 4 * sizeof(int), c->num_cells, 1)) {
+            return EXIT_FAILURE;
+        }
+        pos = ftell(c->_fp);
+        for (i = 0; i < c->num_cells; i = j) {
+            /* runs end at blocks of progress */
+            j = i - i % UCD_PROGRESS_ROWS + UCD_PROGRESS_ROWS;
+            j = _ucd_nlist_run(cells, ld_nlist, i,
+                    j < c->num_cells ? j : c->num_cells);
+            _ucd_checksum_fwrite(c, &nlist[ld_nlist*i], sizeof(int),
+                    j - i > 1 ? (j - i) * ld_nlist : cells[4*i+2]);
+            if (_ucd_progress_rows(c, &pos, j, c->num_cells, 0)) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (c->chunk_rows > 0) {
+            coords[0] = x;
+            coords[1] = y;
+            coords[2] = z;
+            if (_ucd_chunk_write_body(c, 3, c->num_nodes, coords, lds,
+                        UCD_ENCODING_FLOAT32)) {
+                return EXIT_FAILURE;
+            }
+        } else if (_ucd_progress_fwrite(c, x, sizeof(float), c->num_nodes, 1)
+                || _ucd_progress_fwrite(c, y, sizeof(float), c->num_nodes, 1)
+                || _ucd_progress_fwrite(c, z,
+                    sizeof(float), c->num_nodes, 1)) {
+            return EXIT_FAILURE;
         }
-        fwrite(x, sizeof(float), c->num_nodes, c->_fp);
-        fwrite(y, sizeof(float), c->num_nodes, c->_fp);
-        fwrite(z, sizeof(float), c->num_nodes, c->_fp);
     } else {
+        pos = ftell(c->_fp);
         if (nodes != NULL) {
             for (i = 0; i < c->num_nodes; ++i) {
                 fprintf(c->_fp, "%d %e %e %e\n", nodes[i], x[i], y[i], z[i]);
+                if (_ucd_progress_rows(c, &pos, i + 1, c->num_nodes, 3)) {
+                    return EXIT_FAILURE;
+                }
             }
         } else {
             for (i = 0; i < c->num_nodes; ++i) {
                 fprintf(c->_fp, "%d %e %e %e\n", i, x[i], y[i], z[i]);
+                if (_ucd_progress_rows(c, &pos, i + 1, c->num_nodes, 3)) {
+                    return EXIT_FAILURE;
+                }
             }
         }
         for (i = 0; i < c->num_cells; ++i) {
             fprintf(c->_fp, "%d %d %s",
-                    cells[4*i], cells[4*i+1], ucd_cell_type_string(cells[4*i+2]));
-            for (j = 0; j < cells[4*i+3]; ++j) {
+                    cells[4*i], cells[4*i+1], ucd_cell_type_string(cells[4*i+3]));
+            for (j = 0; j < cells[4*i+2]; ++j) {
                 fprintf(c->_fp, " %d", nlist[ld_nlist*i+j]);
             }
             fprintf(c->_fp, "\n");
+            if (_ucd_progress_rows(c, &pos, i + 1, c->num_cells, 1)) {
+                return EXIT_FAILURE;
+            }
         }
     }
     return ferror(c->_fp);
 }
 
 
+void _ucd_rows_free(ucd_context* c)
+{
+    if (c->_rows != NULL) {
+        free(c->_rows->components);
+        free(c->_rows->buffer);
+        free(c->_rows);
+        c->_rows = NULL;
+    }
+}
+
+
+/* sizes of components are kept for ucd_write_data_rows() */
+static int _ucd_rows_alloc(ucd_context* c,
+        int num_comp, const int* components)
+{
+    _ucd_rows_free(c);
+
+    c->_rows = calloc(1, sizeof(*c->_rows));
+    if (c->_rows != NULL) {
+        c->_rows->components = malloc((num_comp + 1) * sizeof(int));
+    }
+    if (c->_rows == NULL || c->_rows->components == NULL) {
+        fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+        _ucd_rows_free(c);
+        return EXIT_FAILURE;
+    }
+    c->_rows->num_comp = num_comp;
+    memcpy(c->_rows->components, components, num_comp * sizeof(int));
+
+    return EXIT_SUCCESS;
+}
+
+
 int ucd_write_data_header(ucd_context* c,
         int num_comp, const int* components, const char* labels, const char* units)
 {
@@ -153,6 +713,8 @@ int ucd_write_data_header(ucd_context* c,
     }
 
     ucd_data_dimension(c, NULL, &num_data);
+    c->_col = 0;
+    c->_row = 0;
 
     if (c->is_binary) {
         memset(buffer, '0', sizeof(buffer));
@@ -164,7 +726,7 @@ int ucd_write_data_header(ucd_context* c,
                 buffer[i] = labels[i];
             }
         }
-        fwrite(buffer, sizeof(char), sizeof(buffer), c->_fp);
+        _ucd_checksum_fwrite(c, buffer, sizeof(char), sizeof(buffer));
 
         memset(buffer, '0', sizeof(buffer));
         for (i = 0, comp_count = 0; i < sizeof(buffer) - 1 && comp_count < num_comp; ++i) {
@@ -175,12 +737,17 @@ int ucd_write_data_header(ucd_context* c,
                 buffer[i] = units[i];
             }
         }
-        fwrite(buffer, sizeof(char), sizeof(buffer), c->_fp);
+        _ucd_checksum_fwrite(c, buffer, sizeof(char), sizeof(buffer));
 
-        fwrite(&num_comp, sizeof(int), 1, c->_fp);
-        fwrite(components, sizeof(int), num_comp, c->_fp);
+        _ucd_checksum_fwrite(c, &num_comp, sizeof(int), 1);
+        _ucd_checksum_fwrite(c, components, sizeof(int), num_comp);
         for (i = num_comp; i < num_data; ++i) {
-            fwrite(&zero, sizeof(int), 1, c->_fp);
+            _ucd_checksum_fwrite(c, &zero, sizeof(int), 1);
+        }
+
+        if (c->chunk_rows <= 0
+                && _ucd_rows_alloc(c, num_comp, components)) {
+            return EXIT_FAILURE;
         }
     } else {
         fprintf(c->_fp, "%d", num_comp);
@@ -212,8 +779,22 @@ int ucd_write_data_minmax(ucd_context* c, const float* minima, const float* maxi
 
     ucd_data_dimension(c, NULL, &num_data);
 
-    fwrite(minima, sizeof(float), num_data, c->_fp);
-    fwrite(maxima, sizeof(float), num_data, c->_fp);
+    _ucd_checksum_fwrite(c, minima, sizeof(float), num_data);
+    _ucd_checksum_fwrite(c, maxima, sizeof(float), num_data);
+
+    if (c->encoding != UCD_ENCODING_FLOAT32) {
+        /* keep the range to quantize data */
+        free(c->_minima);
+        free(c->_maxima);
+        c->_minima = malloc(num_data * sizeof(*c->_minima));
+        c->_maxima = malloc(num_data * sizeof(*c->_maxima));
+        if (c->_minima == NULL || c->_maxima == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        memcpy(c->_minima, minima, num_data * sizeof(*minima));
+        memcpy(c->_maxima, maxima, num_data * sizeof(*maxima));
+    }
 
     return ferror(c->_fp);
 }
@@ -243,6 +824,7 @@ int ucd_write_data_ascii_1(ucd_context* c, int id, const float* data)
 int ucd_write_data_ascii_n(ucd_context* c, const int* ids, const float* data)
 {
     int num_rows, num_data, i, j;
+    long pos;
 
     if (c->is_binary) {
         fprintf(stderr, "%s: assertion error\n", __func__);
@@ -251,38 +833,273 @@ int ucd_write_data_ascii_n(ucd_context* c, const int* ids, const float* data)
 
     ucd_data_dimension(c, &num_rows, &num_data);
 
+    pos = ftell(c->_fp);
     for (i = 0; i < num_rows; ++i) {
         fprintf(c->_fp, "%d", ids[i]);
         for (j = 0; j < num_data; ++j) {
             fprintf(c->_fp, " %e", data[num_data * i + j]);
         }
         fprintf(c->_fp, "\n");
+        if (_ucd_progress_rows(c, &pos, i + 1, num_rows, num_data)) {
+            return EXIT_FAILURE;
+        }
     }
 
     return ferror(c->_fp);
 }
 
 
+/* the width of a quantized range must be a finite float to decode it */
+static int _ucd_check_range(const ucd_context* c, int col, int num_cols)
+{
+    int j;
+
+    if (c->encoding != UCD_ENCODING_UINT16
+            && c->encoding != UCD_ENCODING_UINT8) {
+        return EXIT_SUCCESS;
+    }
+    for (j = col; j < col + num_cols; ++j) {
+        if (!_ucd_range_is_finite(c->_minima[j], c->_maxima[j])) {
+            fprintf(stderr, "%s: range of column %d is not finite\n",
+                    __func__, j);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
 int ucd_write_data_binary(ucd_context* c,
         int component_size, const float* data, int ld_data)
 {
-    int num_rows, i;
+    int num_rows, esize, i;
+    long pos;
+    void* buffer;
 
     if (!c->is_binary) {
         fprintf(stderr, "%s: assertion error\n", __func__);
         return EXIT_FAILURE;
     }
+    if (c->chunk_rows > 0) {
+        fprintf(stderr, "%s: chunked data are written by "
+                "ucd_simple_writer_ex()\n", __func__);
+        return EXIT_FAILURE;
+    }
+    if (c->_rows != NULL && c->_rows->buffer != NULL) {
+        fprintf(stderr, "%s: data are written by rows\n", __func__);
+        return EXIT_FAILURE;
+    }
 
     ucd_data_dimension(c, &num_rows, NULL);
 
-    for (i = 0; i < num_rows; ++i) {
-        fwrite(&data[ld_data*i], sizeof(float), component_size, c->_fp);
+    if (c->encoding == UCD_ENCODING_FLOAT32) {
+        if (ld_data == component_size) {
+            if (_ucd_progress_fwrite(c, data, component_size * sizeof(float),
+                        num_rows, component_size)) {
+                return EXIT_FAILURE;
+            }
+        } else {
+            pos = ftell(c->_fp);
+            for (i = 0; i < num_rows; ++i) {
+                if (_ucd_checksum_fwrite(c, &data[ld_data*i],
+                            sizeof(float), component_size)
+                        != (size_t)component_size) {
+                    fprintf(stderr, "%s: cannot write\n", __func__);
+                    return EXIT_FAILURE;
+                }
+                if (_ucd_progress_rows(c, &pos,
+                            i + 1, num_rows, component_size)) {
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    } else {
+        if (c->_minima == NULL) {
+            fprintf(stderr, "%s: minima and maxima are not written\n",
+                    __func__);
+            return EXIT_FAILURE;
+        }
+        if (_ucd_check_range(c, c->_col, component_size)) {
+            return EXIT_FAILURE;
+        }
+        esize = _ucd_encoding_size(c->encoding);
+        buffer = malloc(num_rows * component_size * esize);
+        if (buffer == NULL && num_rows > 0) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        _ucd_encode(c->encoding, data, ld_data, num_rows, component_size,
+                &c->_minima[c->_col], &c->_maxima[c->_col], buffer);
+        i = _ucd_progress_fwrite(c, buffer, (size_t)esize * component_size,
+                num_rows, component_size);
+        free(buffer);
+        if (i) {
+            return EXIT_FAILURE;
+        }
     }
+    c->_col += component_size;
 
     return ferror(c->_fp);
 }
 
 
+/* buffered rows are written to blocks of components */
+static int _ucd_rows_flush(ucd_context* c)
+{
+    struct ucd_rows_buffer* r;
+    ucd_binary_layout layout;
+    int num_rows, esize, first, base, i;
+    const char* p;
+
+    r = c->_rows;
+    _ucd_binary_layout(c, &layout);
+    ucd_data_dimension(c, &num_rows, NULL);
+    esize = _ucd_encoding_size(c->encoding);
+    first = c->_row - r->num_buffered;
+
+    base = 0;
+    p = r->buffer;
+    for (i = 0; i < r->num_comp; ++i) {
+        fseek(c->_fp, layout.body[c->_nc - 1]
+                + ((long)num_rows * base + (long)first * r->components[i])
+                * esize, SEEK_SET);
+        _ucd_checksum_fwrite(c, p, esize, r->num_buffered * r->components[i]);
+        p += (long)UCD_BLOCK_ROWS * r->components[i] * esize;
+        base += r->components[i];
+    }
+    r->num_buffered = 0;
+
+    return ferror(c->_fp);
+}
+
+
+int ucd_write_data_rows(ucd_context* c,
+        int num_block, const float* data, int ld_data)
+{
+    struct ucd_rows_buffer* r;
+    ucd_binary_layout layout;
+    int num_rows, num_data, esize, base, n, i, j;
+    char* p;
+    float v;
+
+    r = c->_rows;
+    if (!c->is_binary || r == NULL) {
+        fprintf(stderr, "%s: rows are written to classic binary only\n",
+                __func__);
+        return EXIT_FAILURE;
+    }
+
+    ucd_data_dimension(c, &num_rows, &num_data);
+    if (num_block < 0 || num_block > num_rows - c->_row) {
+        fprintf(stderr, "%s: too many rows\n", __func__);
+        return EXIT_FAILURE;
+    }
+    esize = _ucd_encoding_size(c->encoding);
+
+    if (r->buffer == NULL) {
+        /* minima and maxima are written later unless they were written */
+        _ucd_binary_layout(c, &layout);
+        r->has_minmax = ftell(c->_fp) != layout.minmax[c->_nc - 1];
+        if (!r->has_minmax && c->encoding != UCD_ENCODING_FLOAT32) {
+            fprintf(stderr, "%s: minima and maxima are not written\n",
+                    __func__);
+            return EXIT_FAILURE;
+        }
+        if (!r->has_minmax) {
+            free(c->_minima);
+            free(c->_maxima);
+            c->_minima = malloc((num_data + 1) * sizeof(*c->_minima));
+            c->_maxima = malloc((num_data + 1) * sizeof(*c->_maxima));
+        }
+        r->buffer = malloc((long)UCD_BLOCK_ROWS * num_data * esize + 1);
+        if (r->buffer == NULL) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        /* float rows are written as they are after the range is written */
+        if ((!r->has_minmax || c->encoding != UCD_ENCODING_FLOAT32)
+                && (c->_minima == NULL || c->_maxima == NULL)) {
+            fprintf(stderr, "%s: cannot allocate memory\n", __func__);
+            return EXIT_FAILURE;
+        }
+        if (r->has_minmax && _ucd_check_range(c, 0, num_data)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    while (num_block > 0) {
+        n = UCD_BLOCK_ROWS - r->num_buffered;
+        n = num_block < n ? num_block : n;
+
+        if (!r->has_minmax) {
+            for (j = 0; j < num_data; ++j) {
+                for (i = 0; i < n; ++i) {
+                    v = data[ld_data * i + j];
+                    if (c->_row + i == 0 || v < c->_minima[j]) {
+                        c->_minima[j] = v;
+                    }
+                    if (c->_row + i == 0 || v > c->_maxima[j]) {
+                        c->_maxima[j] = v;
+                    }
+                }
+            }
+        }
+
+        base = 0;
+        p = r->buffer;
+        for (i = 0; i < r->num_comp; ++i) {
+            _ucd_encode(c->encoding, &data[base], ld_data,
+                    n, r->components[i],
+                    c->_minima != NULL ? &c->_minima[base] : NULL,
+                    c->_maxima != NULL ? &c->_maxima[base] : NULL,
+                    p + (long)r->num_buffered * r->components[i] * esize);
+            p += (long)UCD_BLOCK_ROWS * r->components[i] * esize;
+            base += r->components[i];
+        }
+
+        r->num_buffered += n;
+        c->_row += n;
+        data += (long)ld_data * n;
+        num_block -= n;
+        if (r->num_buffered == UCD_BLOCK_ROWS && _ucd_rows_flush(c)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return ferror(c->_fp);
+}
+
+
+/* the rest of rows, minima and maxima are written before the active list */
+static int _ucd_rows_finish(ucd_context* c)
+{
+    ucd_binary_layout layout;
+    int num_rows, num_data;
+
+    ucd_data_dimension(c, &num_rows, &num_data);
+    if (c->_row != num_rows) {
+        fprintf(stderr, "%s: %d of %d rows are written\n",
+                __func__, c->_row, num_rows);
+        return EXIT_FAILURE;
+    }
+    if (_ucd_rows_flush(c)) {
+        return EXIT_FAILURE;
+    }
+
+    _ucd_binary_layout(c, &layout);
+    if (!c->_rows->has_minmax) {
+        fseek(c->_fp, layout.minmax[c->_nc - 1], SEEK_SET);
+        _ucd_checksum_fwrite(c, c->_minima, sizeof(float), num_data);
+        _ucd_checksum_fwrite(c, c->_maxima, sizeof(float), num_data);
+    }
+    fseek(c->_fp, layout.active[c->_nc - 1], SEEK_SET);
+
+    free(c->_rows->buffer);
+    c->_rows->buffer = NULL;
+    return ferror(c->_fp);
+}
+
+
 int ucd_write_data_active_list(ucd_context* c, const int* active_list)
 {
     int num_data, i;
@@ -291,14 +1108,18 @@ int ucd_write_data_active_list(ucd_context* c, const int* active_list)
         fprintf(stderr, "%s: assertion error\n", __func__);
         return EXIT_FAILURE;
     }
+    if (c->_rows != NULL && c->_rows->buffer != NULL
+            && _ucd_rows_finish(c)) {
+        return EXIT_FAILURE;
+    }
 
     ucd_data_dimension(c, NULL, &num_data);
 
     if (active_list != NULL) {
-        fwrite(&active_list, sizeof(int), num_data, c->_fp);
+        _ucd_checksum_fwrite(c, active_list, sizeof(int), num_data);
     } else {
         for (i = 0; i < num_data; ++i) {
-            fwrite(&zero, sizeof(int), 1, c->_fp);
+            _ucd_checksum_fwrite(c, &zero, sizeof(int), 1);
         }
     }
 
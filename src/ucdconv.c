@@ -5,6 +5,8 @@
  * @date 2014
  */
 
+#include <float.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,6 +18,613 @@
  * a -> a : ascii to ascii (to shrink size)
  */
 
+static void print_data_summary(const char* name, const ucd_data* d)
+{
+    const char *anchor_l, *anchor_u;
+    int i;
+
+    if (d == NULL) {
+        printf("Number of %s data: (none)\n", name);
+        return;
+    }
+
+    printf("Number of %s data: %d\n", name, d->num_data);
+    printf("  Number of components: %d\n", d->num_comp);
+    anchor_l = d->labels;
+    anchor_u = d->units;
+    for (i = 0; i < d->num_comp; ++i) {
+        printf("  Comp. %d: %s (%s) [%d]\n",
+                i, anchor_l, anchor_u, d->components[i]);
+        anchor_l += strlen(anchor_l) + 1;
+        anchor_u += strlen(anchor_u) + 1;
+    }
+}
+
+
+static int encoding_number(const char* str)
+{
+    if (strcmp(str, "float") == 0) {
+        return UCD_ENCODING_FLOAT32;
+    } else if (strcmp(str, "half") == 0) {
+        return UCD_ENCODING_FLOAT16;
+    } else if (strcmp(str, "q16") == 0) {
+        return UCD_ENCODING_UINT16;
+    } else if (strcmp(str, "q8") == 0) {
+        return UCD_ENCODING_UINT8;
+    }
+    fprintf(stderr, "encoding %s is invalid.\n", str);
+    return -1;
+}
+
+
+static int derive(ucd_content* ucd, const char* option, const char* label)
+{
+    ucd_data* d;
+    int comp;
+
+    d = ucd->ndata;
+    comp = d != NULL ? ucd_data_find_component(d, label) : -1;
+    if (comp < 0) {
+        d = ucd->cdata;
+        comp = d != NULL ? ucd_data_find_component(d, label) : -1;
+    }
+    if (comp < 0) {
+        fprintf(stderr, "component %s is not found.\n", label);
+        return EXIT_FAILURE;
+    }
+
+    switch (option[1]) {
+    case 'm':
+        return ucd_derive_magnitude(d, comp, NULL);
+    case 'v':
+        return ucd_derive_mises(d, comp, NULL);
+    default:
+        return ucd_derive_principal(d, comp, NULL);
+    }
+}
+
+
+static int compare_id(const void* a, const void* b)
+{
+    int ka = *(const int*)a;
+    int kb = *(const int*)b;
+    return (ka > kb) - (ka < kb);
+}
+
+
+/*
+ * Pairs of node ID and the number of parts which share the node, sorted
+ * by IDs.  Parts of a node are those of its cells.
+ */
+static int* node_parts(const ucd_content* ucd, const ucd_adjacency* adj,
+        const int* cell_part)
+{
+    int* pairs;
+    int num_parts, i, j, k;
+
+    pairs = malloc(2 * ucd->num_nodes * sizeof(*pairs) + 1);
+    if (pairs == NULL) {
+        fprintf(stderr, "cannot allocate memory.\n");
+        return NULL;
+    }
+    for (i = 0; i < ucd->num_nodes; ++i) {
+        num_parts = 0;
+        for (j = adj->node_offset[i]; j < adj->node_offset[i+1]; ++j) {
+            for (k = adj->node_offset[i]; k < j; ++k) {
+                if (cell_part[adj->node_cells[k]]
+                        == cell_part[adj->node_cells[j]]) {
+                    break;
+                }
+            }
+            num_parts += k == j;
+        }
+        pairs[2*i] = ucd->node_id[i];
+        pairs[2*i+1] = num_parts;
+    }
+    qsort(pairs, ucd->num_nodes, 2 * sizeof(*pairs), compare_id);
+    return pairs;
+}
+
+
+/*
+ * Write lines of "local_id global_id parts" of nodes of a part, where
+ * nodes shared with other parts have more than one part.
+ */
+static int write_node_map(const char* filename, const int* global_node,
+        int num_nodes, const int* pairs, int num_pairs)
+{
+    FILE* fp;
+    const int* pair;
+    int i;
+
+    fp = fopen(filename, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot open %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < num_nodes; ++i) {
+        pair = bsearch(&global_node[i], pairs, num_pairs,
+                2 * sizeof(*pairs), compare_id);
+        fprintf(fp, "%d %d %d\n", i + 1, global_node[i],
+                pair != NULL ? pair[1] : 1);
+    }
+    i = ferror(fp);
+    return fclose(fp) || i;
+}
+
+
+/*
+ * partition N input.inp output : split into output.0.inp ... output.N-1.inp
+ * with maps of nodes to global IDs in output.0.nodes ...
+ */
+static int command_partition(int argc, char** argv)
+{
+    ucd_content ucd, sub;
+    ucd_adjacency adj;
+    int is_binary_input, has_error, num_parts, num_faces, i, j, k;
+    int *cell_part, *pairs, *global_node;
+    char* selected;
+    char output_file[FILENAME_MAX];
+
+    if (argc != 4 || (num_parts = atoi(argv[1])) < 1) {
+        fprintf(stderr, "usage exec partition N input.inp output\n");
+        return EXIT_FAILURE;
+    }
+
+    has_error = ucd_simple_reader(&ucd, argv[2], &is_binary_input);
+    if (has_error) {
+        return has_error;
+    }
+
+    cell_part = malloc(ucd.num_cells * sizeof(*cell_part) + 1);
+    selected = malloc(ucd.num_cells * sizeof(*selected) + 1);
+    has_error = cell_part == NULL || selected == NULL
+        || ucd_partition(&ucd, num_parts, cell_part)
+        || ucd_adjacency_build(&adj, &ucd);
+    if (has_error) {
+        free(cell_part);
+        free(selected);
+        ucd_simple_free(&ucd);
+        return EXIT_FAILURE;
+    }
+    pairs = node_parts(&ucd, &adj, cell_part);
+    has_error = pairs == NULL;
+
+    for (i = 0; i < num_parts && !has_error; ++i) {
+        /* faces shared with other parts */
+        num_faces = 0;
+        for (j = 0; j < ucd.num_cells; ++j) {
+            selected[j] = (char)(cell_part[j] == i);
+            for (k = adj.cell_offset[j];
+                    selected[j] && k < adj.cell_offset[j+1]; ++k) {
+                if (adj.cell_cells[k] >= 0
+                        && cell_part[adj.cell_cells[k]] != i) {
+                    ++num_faces;
+                }
+            }
+        }
+        has_error = ucd_extract_cells(&sub, &ucd, selected, &global_node);
+        if (has_error) {
+            break;
+        }
+        sprintf(output_file, "%.*s.%d.inp", FILENAME_MAX - 16, argv[3], i);
+        printf("Part %d: %d nodes, %d cells, %d interface faces -> %s\n",
+                i, sub.num_nodes, sub.num_cells, num_faces, output_file);
+        has_error = ucd_simple_writer(&sub, output_file, is_binary_input);
+        if (!has_error) {
+            sprintf(output_file, "%.*s.%d.nodes",
+                    FILENAME_MAX - 24, argv[3], i);
+            has_error = write_node_map(output_file, global_node,
+                    sub.num_nodes, pairs, ucd.num_nodes);
+        }
+        free(global_node);
+        ucd_simple_free(&sub);
+    }
+
+    free(pairs);
+    ucd_adjacency_free(&adj);
+    free(cell_part);
+    free(selected);
+    ucd_simple_free(&ucd);
+
+    return has_error;
+}
+
+
+/*
+ * merge [-t tolerance] output.inp input.inp ... : merge parts into one
+ */
+static int command_merge(int argc, char** argv)
+{
+    ucd_content ucd, part;
+    ucd_merger m;
+    float tolerance;
+    int is_binary_input, is_binary_output, has_error, i;
+    char* output_file;
+
+    tolerance = 0;
+    i = 1;
+    if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+        tolerance = (float)atof(argv[2]);
+        i = 3;
+    }
+    if (argc - i < 2) {
+        fprintf(stderr, "usage exec merge [-t tolerance] output.inp input.inp ...\n");
+        return EXIT_FAILURE;
+    }
+    output_file = argv[i];
+
+    /* parts are read one by one to keep memory bounded */
+    has_error = ucd_merger_open(&m, &ucd, tolerance);
+    is_binary_output = 0;
+    for (++i; i < argc && !has_error; ++i) {
+        has_error = ucd_simple_reader(&part, argv[i], &is_binary_input);
+        if (has_error) {
+            break;
+        }
+        is_binary_output = is_binary_input;
+        has_error = ucd_merger_add(&m, &part);
+        ucd_simple_free(&part);
+    }
+    ucd_merger_close(&m);
+
+    if (!has_error) {
+        printf("Merged: %d nodes, %d cells -> %s\n",
+                ucd.num_nodes, ucd.num_cells, output_file);
+        has_error = ucd_simple_writer(&ucd, output_file, is_binary_output);
+    }
+    ucd_simple_free(&ucd);
+
+    return has_error;
+}
+
+
+/*
+ * series [-i interval] output.ucds input.inp ... : pack data of steps
+ */
+static int command_series(int argc, char** argv)
+{
+    ucd_content ucd;
+    ucd_series s;
+    int interval, is_binary, is_open, has_error, i;
+    char* output_file;
+
+    interval = 16;
+    i = 1;
+    if (argc > 2 && strcmp(argv[1], "-i") == 0) {
+        interval = atoi(argv[2]);
+        i = 3;
+    }
+    if (argc - i < 2) {
+        fprintf(stderr, "usage exec series [-i interval] output.ucds input.inp ...\n");
+        return EXIT_FAILURE;
+    }
+    output_file = argv[i];
+
+    /* steps are read one by one to keep memory bounded */
+    has_error = EXIT_SUCCESS;
+    is_open = 0;
+    for (++i; i < argc && !has_error; ++i) {
+        has_error = ucd_simple_reader(&ucd, argv[i], &is_binary);
+        if (has_error) {
+            break;
+        }
+        if (!is_open) {
+            has_error = ucd_series_writer_open(&s, output_file,
+                    ucd.ndata, ucd.cdata, interval);
+            is_open = !has_error;
+        }
+        if (!has_error) {
+            has_error = ucd_series_write(&s, ucd.ndata, ucd.cdata);
+        }
+        ucd_simple_free(&ucd);
+    }
+    if (is_open) {
+        printf("Packed: %d steps -> %s\n", s.num_steps, output_file);
+        has_error |= ucd_series_close(&s);
+    }
+
+    return has_error;
+}
+
+
+/*
+ * step N series.ucds mesh.inp output.inp : restore data of a step
+ */
+static int command_step(int argc, char** argv)
+{
+    ucd_lazy mesh;
+    ucd_series s;
+    ucd_data *ndata, *cdata;
+    int has_error;
+
+    if (argc != 5) {
+        fprintf(stderr, "usage exec step N series.ucds mesh.inp output.inp\n");
+        return EXIT_FAILURE;
+    }
+    if (ucd_series_reader_open(&s, argv[2])) {
+        return EXIT_FAILURE;
+    }
+    has_error = ucd_series_read(&s, atoi(argv[1]), &ndata, &cdata);
+    ucd_series_close(&s);
+    if (has_error) {
+        return EXIT_FAILURE;
+    }
+
+    /* data of the mesh are not read */
+    if (ucd_lazy_open(&mesh, argv[3])) {
+        ucd_data_free(ndata);
+        ucd_data_free(cdata);
+        return EXIT_FAILURE;
+    }
+    has_error = ucd_lazy_nodes(&mesh) || ucd_lazy_cells(&mesh);
+    if (!has_error && ((ndata != NULL && ndata->num_rows != mesh.ucd.num_nodes)
+            || (cdata != NULL && cdata->num_rows != mesh.ucd.num_cells))) {
+        fprintf(stderr, "%s does not match the series\n", argv[3]);
+        has_error = EXIT_FAILURE;
+    }
+
+    ucd_data_free(mesh.ucd.ndata);
+    ucd_data_free(mesh.ucd.cdata);
+    mesh.ucd.ndata = ndata;
+    mesh.ucd.cdata = cdata;
+    if (!has_error) {
+        has_error = ucd_simple_writer(&mesh.ucd, argv[4],
+                mesh.context.is_binary);
+    }
+    ucd_lazy_close(&mesh);
+
+    return has_error;
+}
+
+
+static void print_stats(const char* name, const ucd_data* d,
+        const ucd_stats* stats)
+{
+    const char* anchor_l;
+    int i, j, k;
+
+    if (d == NULL) {
+        return;
+    }
+
+    printf("%s data:\n", name);
+    printf("  %-24s %12s %12s %12s %12s %12s %12s %12s\n", "label",
+            "min", "max", "mean", "stddev", "p5", "p50", "p95");
+    anchor_l = d->labels;
+    k = 0;
+    for (i = 0; i < d->num_comp; ++i) {
+        for (j = 0; j < d->components[i]; ++j, ++k) {
+            printf("  %-20.20s[%2d] %12g %12g %12g %12g %12g %12g %12g\n",
+                    anchor_l, j, stats[k].minimum, stats[k].maximum,
+                    stats[k].mean, sqrt(ucd_stats_variance(&stats[k])),
+                    ucd_stats_percentile(&stats[k], 0.05),
+                    ucd_stats_percentile(&stats[k], 0.5),
+                    ucd_stats_percentile(&stats[k], 0.95));
+            if (stats[k].num_nonfinite > 0) {
+                printf("  %-24s %ld NaN or infinite values are excluded\n",
+                        "", stats[k].num_nonfinite);
+            }
+        }
+        anchor_l += strlen(anchor_l) + 1;
+    }
+}
+
+
+static int command_stats(int argc, char** argv)
+{
+    ucd_content ucd;
+    ucd_stats *nstats, *cstats;
+    int num_bins, has_error, i;
+
+    num_bins = 1024;
+    i = 1;
+    if (argc > 2 && strcmp(argv[1], "-b") == 0) {
+        num_bins = atoi(argv[2]);
+        i = 3;
+    }
+    if (argc - i != 1) {
+        fprintf(stderr, "usage exec stats [-b bins] input.inp\n");
+        return EXIT_FAILURE;
+    }
+
+    has_error = ucd_stats_read(&ucd, argv[i], num_bins, &nstats, &cstats);
+    if (has_error) {
+        return EXIT_FAILURE;
+    }
+
+    printf("Number of nodes: %d\n", ucd.num_nodes);
+    printf("Number of cells: %d\n", ucd.num_cells);
+    print_stats("Node", ucd.ndata, nstats);
+    print_stats("Cell", ucd.cdata, cstats);
+
+    for (i = 0; nstats != NULL && i < ucd.ndata->num_data; ++i) {
+        ucd_stats_free(&nstats[i]);
+    }
+    for (i = 0; cstats != NULL && i < ucd.cdata->num_data; ++i) {
+        ucd_stats_free(&cstats[i]);
+    }
+    free(nstats);
+    free(cstats);
+    ucd_simple_free(&ucd);
+
+    return EXIT_SUCCESS;
+}
+
+
+static float parse_bound(const char* str, float unbounded)
+{
+    return strcmp(str, "-") == 0 ? unbounded : (float)atof(str);
+}
+
+
+static int command_extract(int argc, char** argv)
+{
+    ucd_content sub;
+    ucd_predicate* predicates;
+    char* separator;
+    int num_predicates, any_node, keep_format, has_error, i;
+    ucd_predicate* p;
+
+    predicates = malloc(argc * sizeof(*predicates));
+    if (predicates == NULL) {
+        return EXIT_FAILURE;
+    }
+    num_predicates = 0;
+    any_node = 1;
+    keep_format = 0;
+    has_error = 0;
+    for (i = 1; i < argc - 2 && !has_error; ++i) {
+        p = &predicates[num_predicates];
+        p->label = NULL;
+        p->column = 0;
+        p->lower = -FLT_MAX;
+        p->upper = FLT_MAX;
+        if (strcmp(argv[i], "-a") == 0) {
+            any_node = 0;
+        } else if (strcmp(argv[i], "-k") == 0) {
+            keep_format = 1;
+        } else if ((strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "-c") == 0)
+                && i + 3 < argc - 2) {
+            p->target = argv[i][1] == 'n'
+                ? UCD_PREDICATE_NDATA : UCD_PREDICATE_CDATA;
+            p->label = argv[i + 1];
+            separator = strrchr(argv[i + 1], ':');
+            if (separator != NULL) {
+                *separator = '\0';
+                p->column = atoi(separator + 1);
+            }
+            p->lower = parse_bound(argv[i + 2], -FLT_MAX);
+            p->upper = parse_bound(argv[i + 3], FLT_MAX);
+            ++num_predicates;
+            i += 3;
+        } else if ((strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "-x") == 0
+                    || strcmp(argv[i], "-y") == 0 || strcmp(argv[i], "-z") == 0)
+                && i + 2 < argc - 2) {
+            p->target = argv[i][1] == 'm' ? UCD_PREDICATE_MAT_ID
+                : argv[i][1] == 'x' ? UCD_PREDICATE_X
+                : argv[i][1] == 'y' ? UCD_PREDICATE_Y : UCD_PREDICATE_Z;
+            p->lower = parse_bound(argv[i + 1], -FLT_MAX);
+            p->upper = parse_bound(argv[i + 2], FLT_MAX);
+            ++num_predicates;
+            i += 2;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc - 2) {
+            p->target = UCD_PREDICATE_CELL_TYPE;
+            p->lower = p->upper = (float)ucd_cell_type_number(argv[++i]);
+            has_error = p->lower < 0;
+            ++num_predicates;
+        } else {
+            has_error = 1;
+        }
+    }
+    if (argc < 3 || has_error) {
+        fprintf(stderr, "usage exec extract [options] input.inp output.inp\n");
+        fprintf(stderr, "options (cells satisfying all are extracted):\n");
+        fprintf(stderr, "  -n label[:col] lower upper  node data in range\n");
+        fprintf(stderr, "  -c label[:col] lower upper  cell data in range\n");
+        fprintf(stderr, "  -m lower upper              material ID in range\n");
+        fprintf(stderr, "  -t type                     cell type (e.g. hex)\n");
+        fprintf(stderr, "  -x|-y|-z lower upper        coordinate in range\n");
+        fprintf(stderr, "  -a                          all nodes of a cell should satisfy\n");
+        fprintf(stderr, "  -k                          write in ASCII format\n");
+        fprintf(stderr, "  a bound '-' is unbounded.\n");
+        free(predicates);
+        return EXIT_FAILURE;
+    }
+
+    has_error = ucd_extract_file(&sub, argv[argc-2],
+            num_predicates, predicates, any_node);
+    free(predicates);
+    if (has_error) {
+        return EXIT_FAILURE;
+    }
+
+    printf("Extracted: %d nodes, %d cells -> %s\n",
+            sub.num_nodes, sub.num_cells, argv[argc-1]);
+    has_error = ucd_simple_writer(&sub, argv[argc-1], !keep_format);
+    ucd_simple_free(&sub);
+
+    return has_error;
+}
+
+
+/*
+ * Average data onto the other entity and append them to its data.
+ * Cell data are moved to nodes if weighting is one of UCD_AVERAGE_*,
+ * and node data are moved to cells if negative.
+ */
+static int move_data(ucd_content* ucd, ucd_data** dst, ucd_data** src,
+        int weighting)
+{
+    ucd_data* d;
+    int has_error;
+
+    d = weighting < 0 ? ucd_node_to_cell(ucd, *src)
+        : ucd_cell_to_node(ucd, NULL, *src, weighting);
+    if (d == NULL) {
+        return EXIT_FAILURE;
+    }
+    has_error = EXIT_SUCCESS;
+    if (*dst == NULL) {
+        *dst = d;
+    } else {
+        has_error = ucd_data_append(*dst, d);
+        ucd_data_free(d);
+    }
+    ucd_data_free(*src);
+    *src = NULL;
+
+    return has_error;
+}
+
+
+static int append_quality(ucd_content* ucd)
+{
+    ucd_data* d;
+    int has_error;
+
+    d = ucd_cell_quality(ucd);
+    if (d == NULL) {
+        return EXIT_FAILURE;
+    }
+    if (ucd->cdata == NULL) {
+        ucd->cdata = d;
+        return EXIT_SUCCESS;
+    }
+    has_error = ucd_data_append(ucd->cdata, d);
+    ucd_data_free(d);
+
+    return has_error;
+}
+
+
+static int print_progress(void* arg, long bytes, long rows)
+{
+    fprintf(stderr, "\r%s %ld KB, %ld rows", (const char*)arg,
+            bytes / 1024, rows);
+    return 0;
+}
+
+
+/* 1 for VTK XML, 0 for legacy VTK, and -1 for UCD by the extension */
+static int vtk_format(const char* filename)
+{
+    const char* ext;
+
+    ext = strrchr(filename, '.');
+    if (ext == NULL) {
+        return -1;
+    }
+    if (strcmp(ext, ".vtu") == 0) {
+        return 1;
+    }
+    if (strcmp(ext, ".vtk") == 0) {
+        return 0;
+    }
+    return -1;
+}
+
+
 /**
  * An example application to convert UCD file formats.
  * @param argc
@@ -24,74 +633,217 @@
  */
 int main(int argc, char** argv) {
     ucd_content ucd;
-    int is_binary_input, keep_format, has_error, i;
+    ucd_context input;
+    ucd_options o, input_options;
+    int is_binary_input, keep_format, rewrite, has_error, i;
+    int num_derives;
+    int* derives;
+    int to_node, to_cell, average, quality, num_levels;
     char* input_file;
     char* output_file;
-    char *anchor_l, *anchor_u;
+
+    if (argc > 1 && strcmp(argv[1], "partition") == 0) {
+        return command_partition(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "merge") == 0) {
+        return command_merge(argc - 1, argv + 1);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "extract") == 0) {
+        return command_extract(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+        return command_stats(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "series") == 0) {
+        return command_series(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "step") == 0) {
+        return command_step(argc - 1, argv + 1);
+    }
 
     if (argc < 3) {
         fprintf(stderr, "usage exec [options] input.inp output.inp\n");
+        fprintf(stderr, "      exec partition N input.inp output\n");
+        fprintf(stderr, "      exec merge [-t tolerance] output.inp input.inp ...\n");
+        fprintf(stderr, "      exec stats [-b bins] input.inp\n");
+        fprintf(stderr, "      exec extract [options] input.inp output.inp\n");
+        fprintf(stderr, "      exec series [-i interval] output.ucds input.inp ...\n");
+        fprintf(stderr, "      exec step N series.ucds mesh.inp output.inp\n");
+        fprintf(stderr, "output in VTK formats if it ends with .vtu or .vtk\n");
+        fprintf(stderr, "options:\n");
+        fprintf(stderr, "  -k           keep ASCII format\n");
+        fprintf(stderr, "  -e encoding  write binary data in float, half, q16 or q8\n");
+        fprintf(stderr, "  -c rows      write binary in chunked container with zone maps\n");
+        fprintf(stderr, "  -u           update data of an existing binary output in place\n");
+        fprintf(stderr, "  -s           append checksums of sections to binary output\n");
+        fprintf(stderr, "  -m label     append magnitude of a component\n");
+        fprintf(stderr, "  -v label     append von Mises stress of a tensor component\n");
+        fprintf(stderr, "  -p label     append principal values of a tensor component\n");
+        fprintf(stderr, "  -N weight    move cell data to nodes averaged by count or measure\n");
+        fprintf(stderr, "  -C           move node data to cells averaged over nodes\n");
+        fprintf(stderr, "  -Q           append quality metrics of cells to cell data\n");
+        fprintf(stderr, "  -M megabytes spill input arrays beyond the budget to temporary files\n");
+        fprintf(stderr, "  -P           print progress of reading and writing\n");
+        fprintf(stderr, "  -L levels    write coarse previews to output.lod1.inp, ...\n");
         return EXIT_FAILURE;
     }
 
+    ucd_options_init(&o);
+    ucd_options_init(&input_options);
     keep_format = 0;
+    rewrite = 0;
+    to_node = 0;
+    to_cell = 0;
+    quality = 0;
+    num_levels = 0;
+    average = UCD_AVERAGE_COUNT;
+    /* options of derived components, which are applied after reading */
+    derives = malloc(argc * sizeof(*derives));
+    if (derives == NULL) {
+        fprintf(stderr, "cannot allocate memory\n");
+        return EXIT_FAILURE;
+    }
+    num_derives = 0;
+    has_error = EXIT_SUCCESS;
+    for (i = 1; i < argc - 2 && !has_error; ++i) {
+        if (strcmp(argv[i], "-k") == 0) {
+            keep_format = 1;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            rewrite = 1;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            o.checksum = 1;
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc - 2) {
+            o.chunk_rows = atoi(argv[++i]);
+            if (o.chunk_rows <= 0) {
+                fprintf(stderr, "chunk size %s is invalid.\n", argv[i]);
+                has_error = EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc - 2) {
+            o.encoding = encoding_number(argv[++i]);
+            if (o.encoding < 0) {
+                has_error = EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc - 2) {
+            ++i;
+            if (strcmp(argv[i], "count") == 0) {
+                average = UCD_AVERAGE_COUNT;
+            } else if (strcmp(argv[i], "measure") == 0) {
+                average = UCD_AVERAGE_MEASURE;
+            } else {
+                fprintf(stderr, "weight %s is invalid.\n", argv[i]);
+                has_error = EXIT_FAILURE;
+            }
+            to_node = 1;
+        } else if (strcmp(argv[i], "-C") == 0) {
+            to_cell = 1;
+        } else if (strcmp(argv[i], "-Q") == 0) {
+            quality = 1;
+        } else if (strcmp(argv[i], "-P") == 0) {
+            input_options.progress = print_progress;
+            input_options.progress_arg = "read";
+            o.progress = print_progress;
+            o.progress_arg = "written";
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc - 2) {
+            if (atof(argv[++i]) <= 0) {
+                fprintf(stderr, "memory budget %s is invalid.\n", argv[i]);
+                has_error = EXIT_FAILURE;
+            }
+            input_options.memory_budget = (size_t)(atof(argv[i]) * 1024 * 1024);
+        } else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc - 2) {
+            num_levels = atoi(argv[++i]);
+            if (num_levels <= 0) {
+                fprintf(stderr, "number of levels %s is invalid.\n", argv[i]);
+                has_error = EXIT_FAILURE;
+            }
+        } else if ((strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "-v") == 0
+                    || strcmp(argv[i], "-p") == 0) && i + 1 < argc - 2) {
+            derives[num_derives++] = i++;
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            has_error = EXIT_FAILURE;
+        }
+    }
+    if (!has_error && o.checksum && keep_format) {
+        fprintf(stderr, "checksums are appended to binary output only.\n");
+        has_error = EXIT_FAILURE;
+    }
+    if (has_error) {
+        free(derives);
+        return has_error;
+    }
     input_file = argv[argc-2];
     output_file = argv[argc-1];
 
-    /* header */
-    has_error = ucd_simple_reader(&ucd, input_file, &is_binary_input);
+    /* data are kept as binary blocks to be copied straight */
+    input_options.layout = UCD_LAYOUT_COMPONENT;
+    has_error = ucd_simple_reader_ex(&ucd, input_file, &input_options,
+            &input);
+    if (input_options.progress != NULL) {
+        fprintf(stderr, "\n");
+    }
     if (has_error) {
+        free(derives);
+        return has_error;
+    }
+    is_binary_input = input.is_binary;
+
+    /* derived components */
+    for (i = 0; i < num_derives && !has_error; ++i) {
+        has_error = derive(&ucd, argv[derives[i]], argv[derives[i] + 1]);
+    }
+    free(derives);
+    if (!has_error && to_node && ucd.cdata != NULL) {
+        has_error = move_data(&ucd, &ucd.ndata, &ucd.cdata, average);
+    }
+    if (!has_error && to_cell && ucd.ndata != NULL) {
+        has_error = move_data(&ucd, &ucd.cdata, &ucd.ndata, -1);
+    }
+    if (!has_error && quality) {
+        has_error = append_quality(&ucd);
+    }
+    if (has_error) {
+        ucd_simple_free(&ucd);
         return has_error;
     }
 
     printf("Number of nodes: %d\n", ucd.num_nodes);
     printf("Number of cells: %d\n", ucd.num_cells);
-    if (ucd.ndata != NULL) {
-        printf("Number of node data: %d\n", ucd.ndata->num_data);
-        printf("  Number of components: %d\n", ucd.ndata->num_comp);
-        anchor_l = ucd.ndata->labels;
-        anchor_u = ucd.ndata->units;
-        for (i = 0; i < ucd.ndata->num_comp; ++i) {
-            printf("  Comp. %d: %s (%s) [%d]\n",
-                    i, anchor_l, anchor_u, ucd.ndata->components[i]);
-            anchor_l += strlen(anchor_l) + 1;
-            anchor_u += strlen(anchor_u) + 1;
-        }
-    } else {
-        printf("Number of node data: (none)\n");
-    }
-    if (ucd.cdata != NULL) {
-        printf("Number of cell data: %d\n", ucd.cdata->num_data);
-        printf("  Number of components: %d\n", ucd.cdata->num_comp);
-        anchor_l = ucd.cdata->labels;
-        anchor_u = ucd.cdata->units;
-        for (i = 0; i < ucd.cdata->num_comp; ++i) {
-            printf("  Comp. %d: %s (%s) [%d]\n",
-                    i, anchor_l, anchor_u, ucd.cdata->components[i]);
-            anchor_l += strlen(anchor_l) + 1;
-            anchor_u += strlen(anchor_u) + 1;
-        }
-    } else {
-        printf("Number of cell data: (none)\n");
-    }
+    print_data_summary("node", ucd.ndata);
+    print_data_summary("cell", ucd.cdata);
 
-    if (is_binary_input) {
+    if (vtk_format(output_file) >= 0) {
+        has_error = ucd_vtk_writer(&ucd, output_file, vtk_format(output_file));
+    } else if (rewrite) {
+        has_error = ucd_simple_rewriter(&ucd, output_file);
+    } else if (o.encoding != UCD_ENCODING_FLOAT32 || o.chunk_rows > 0) {
+        has_error = ucd_simple_writer_ex(&ucd, output_file, 1, &o);
+    } else if (is_binary_input) {
         if (keep_format) {
             fprintf(stderr, "input file is binary format.\n");
             return EXIT_FAILURE;
+        } else if (o.checksum) {
+            fprintf(stderr, "checksums are appended to binary output only.\n");
+            has_error = EXIT_FAILURE;
         } else {
-            has_error = ucd_simple_writer(&ucd, output_file, 0);
+            has_error = ucd_simple_writer_ex(&ucd, output_file, 0, &o);
             /* return ucd_write_ascii(&ucd_, stdout); */
         }
     } else {
         if (keep_format) {
-            has_error = ucd_simple_writer(&ucd, output_file, 0);
+            has_error = ucd_simple_writer_ex(&ucd, output_file, 0, &o);
             /* return ucd_write_ascii(&ucd_, stdout); */
         } else {
-            has_error = ucd_simple_writer(&ucd, output_file, 1);
+            has_error = ucd_simple_writer_ex(&ucd, output_file, 1, &o);
             /* return ucd_write_binary(&ucd_, stdout); */
         }
     }
+    if (o.progress != NULL) {
+        fprintf(stderr, "\n");
+    }
+    if (!has_error && num_levels > 0) {
+        has_error = ucd_preview_writer(&ucd, output_file, num_levels, 128);
+    }
 
     ucd_simple_free(&ucd);
 
@@ -0,0 +1,160 @@
+/**
+ * @file ucdinfo.c
+ * @brief An example application to list numbers and data of UCD files.
+ * @author Shinsuke Ogawa
+ * @date 2014
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ucd.h"
+
+/* files probed at once; results are printed in order of files */
+#define BATCH_FILES 256
+
+static const char* encoding_string(const ucd_context* c)
+{
+    static const char* names[] = {"float", "half", "q16", "q8"};
+
+    if (!c->is_binary) {
+        return "ascii";
+    }
+    if (c->chunk_rows > 0) {
+        return "chunked";
+    }
+    return c->encoding >= 0 && c->encoding <= UCD_ENCODING_UINT8
+        ? names[c->encoding] : "unknown";
+}
+
+
+static void print_data(const char* name, const ucd_data* d)
+{
+    const char *anchor_l, *anchor_u;
+    int i, j, k;
+
+    if (d == NULL) {
+        return;
+    }
+
+    anchor_l = d->labels;
+    anchor_u = d->units;
+    k = 0;
+    for (i = 0; i < d->num_comp; ++i) {
+        printf("  %s %s (%s) [%d]", name, anchor_l, anchor_u,
+                d->components[i]);
+        for (j = 0; j < d->components[i]; ++j, ++k) {
+            if (d->minima[k] <= d->maxima[k]) {
+                printf(" %g:%g", d->minima[k], d->maxima[k]);
+            }
+        }
+        printf("\n");
+        anchor_l += strlen(anchor_l) + 1;
+        anchor_u += strlen(anchor_u) + 1;
+    }
+}
+
+
+static int probe_files(char** files, int num_files)
+{
+    ucd_content* ucds;
+    ucd_context* contexts;
+    int* errors;
+    int has_error, i;
+
+    ucds = malloc(num_files * sizeof(*ucds));
+    contexts = malloc(num_files * sizeof(*contexts));
+    errors = malloc(num_files * sizeof(*errors));
+    if (ucds == NULL || contexts == NULL || errors == NULL) {
+        fprintf(stderr, "cannot allocate memory\n");
+        free(ucds);
+        free(contexts);
+        free(errors);
+        return EXIT_FAILURE;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (i = 0; i < num_files; ++i) {
+        errors[i] = ucd_probe(&ucds[i], files[i], &contexts[i]);
+    }
+
+    has_error = EXIT_SUCCESS;
+    for (i = 0; i < num_files; ++i) {
+        if (errors[i]) {
+            has_error = EXIT_FAILURE;
+            continue;
+        }
+        printf("%s: %s%s, %d nodes, %d cells\n", files[i],
+                encoding_string(&contexts[i]),
+                contexts[i].checksum ? " with checksums" : "",
+                ucds[i].num_nodes, ucds[i].num_cells);
+        print_data("node", ucds[i].ndata);
+        print_data("cell", ucds[i].cdata);
+        ucd_simple_free(&ucds[i]);
+    }
+
+    free(ucds);
+    free(contexts);
+    free(errors);
+    return has_error;
+}
+
+
+/*
+ * Files are given by arguments, or by lines of the standard input if no
+ * arguments.
+ */
+int main(int argc, char** argv)
+{
+    char line[4096];
+    char* files[BATCH_FILES];
+    int num_files, has_error, i;
+
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0
+                || strcmp(argv[1], "--help") == 0)) {
+        fprintf(stderr, "usage exec [input.inp ...]\n");
+        fprintf(stderr, "  files are read from the standard input if none\n");
+        return EXIT_FAILURE;
+    }
+
+    has_error = EXIT_SUCCESS;
+    if (argc > 1) {
+        for (i = 1; i < argc; i += BATCH_FILES) {
+            num_files = argc - i < BATCH_FILES ? argc - i : BATCH_FILES;
+            has_error |= probe_files(&argv[i], num_files);
+        }
+        return has_error;
+    }
+
+    num_files = 0;
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+        files[num_files] = malloc(strlen(line) + 1);
+        if (files[num_files] == NULL) {
+            fprintf(stderr, "cannot allocate memory\n");
+            has_error = EXIT_FAILURE;
+            break;
+        }
+        strcpy(files[num_files++], line);
+        if (num_files == BATCH_FILES) {
+            has_error |= probe_files(files, num_files);
+            for (i = 0; i < num_files; ++i) {
+                free(files[i]);
+            }
+            num_files = 0;
+        }
+    }
+    if (num_files > 0) {
+        has_error |= probe_files(files, num_files);
+    }
+    for (i = 0; i < num_files; ++i) {
+        free(files[i]);
+    }
+
+    return has_error;
+}
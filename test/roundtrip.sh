@@ -0,0 +1,103 @@
+#!/bin/sh
+#
+# Round trip of test/sample.inp through each encoding and container of the
+# binary format, and reading of broken binary files.
+#
+# It is run by 'make check' from the top build directory.
+
+srcdir=${srcdir:-.}
+ucdconv=${UCDCONV:-./src/ucdconv}
+sample=$srcdir/test/sample.inp
+tmp=roundtrip.tmp
+failures=0
+
+fail()
+{
+    echo "FAIL: $*"
+    failures=`expr $failures + 1`
+}
+
+# compare two ASCII files field by field within a tolerance relative to
+# the magnitude of the first one
+compare()
+{
+    awk -v tol="$3" '
+        NR == FNR { line[FNR] = $0; next }
+        {
+            n = split(line[FNR], a)
+            if (n != NF) { exit 1 }
+            for (i = 1; i <= n; ++i) {
+                if (a[i] == $i) { continue }
+                if (a[i] !~ /^[-+0-9.eE]+$/) { exit 1 }
+                d = a[i] - $i
+                m = a[i] < 0 ? -a[i] : a[i]
+                if ((d < 0 ? -d : d) > tol * (m > 1 ? m : 1)) { exit 1 }
+            }
+        }
+        END { if (FNR != length(line)) { exit 1 } }' "$1" "$2"
+}
+
+# a broken file should be rejected, but not crash
+reject()
+{
+    $ucdconv "$1" $tmp/broken.txt > /dev/null 2>&1
+    status=$?
+    if test $status -eq 0; then
+        fail "$2 is read"
+    elif test $status -gt 128; then
+        fail "$2 crashes with status $status"
+    fi
+}
+
+rm -rf $tmp
+mkdir $tmp || exit 1
+
+$ucdconv "$sample" $tmp/float.inp > /dev/null \
+    && $ucdconv $tmp/float.inp $tmp/float.txt > /dev/null \
+    && cmp -s "$sample" $tmp/float.txt \
+    || fail "float"
+
+# name, tolerance of data and options
+while read name tol options; do
+    if $ucdconv $options "$sample" $tmp/$name.inp > /dev/null \
+            && $ucdconv $tmp/$name.inp $tmp/$name.txt > /dev/null; then
+        compare "$sample" $tmp/$name.txt $tol || fail "$name differs"
+    else
+        fail "$name"
+    fi
+done <<EOF
+half 1e-3 -e half
+q16 1e-4 -e q16
+q8 1e-2 -e q8
+checksum 0 -s
+chunked 0 -c 2
+chunked-q8 1e-2 -c 2 -e q8
+chunked-checksum 0 -c 2 -s
+EOF
+
+# a flipped byte in the last node data is caught by the checksum, which
+# is appended after the data
+if test -f $tmp/checksum.inp; then
+    offset=`wc -c < $tmp/float.inp`
+    offset=`expr $offset - 1`
+    cp $tmp/checksum.inp $tmp/flipped.inp
+    printf '\377' | dd of=$tmp/flipped.inp bs=1 seek=$offset conv=notrunc \
+        2> /dev/null
+    reject $tmp/flipped.inp "checksum with a flipped byte"
+fi
+
+# every truncation of a chunked file
+if test -f $tmp/chunked.inp; then
+    size=`wc -c < $tmp/chunked.inp`
+    length=0
+    while test $length -lt $size; do
+        head -c $length $tmp/chunked.inp > $tmp/truncated.inp
+        reject $tmp/truncated.inp "chunked file truncated to $length bytes"
+        length=`expr $length + 1`
+    done
+fi
+
+if test $failures -eq 0; then
+    rm -rf $tmp
+fi
+test $failures -eq 0